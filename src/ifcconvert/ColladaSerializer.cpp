@@ -219,7 +219,7 @@ void ColladaSerializer::ColladaExporter::startDocument(const std::string& unit_n
 	asset.add();
 }
 
-void ColladaSerializer::ColladaExporter::write(const std::string& guid, const std::string& name, const std::string& type, int obj_id, const std::vector<double>& matrix, const std::vector<double>& vertices, const std::vector<double>& normals, const std::vector<int>& indices, const std::vector<int>& material_ids, const std::vector<IfcGeom::Material>& _materials) {
+void ColladaSerializer::ColladaExporter::write(const std::string& guid, const std::string& name, const std::string& type, int obj_id, const std::vector<double>& matrix, const std::vector<double>& vertices, const std::vector<double>& normals, const std::vector<int>& indices, const std::vector<int>& material_ids, const std::vector<IfcGeom::Material>& _materials, const std::string& geometry_name) {
 	std::vector<std::string> material_references;
 	for (std::vector<IfcGeom::Material>::const_iterator it = _materials.begin(); it != _materials.end(); ++it) {
 		const IfcGeom::Material& material = *it;
@@ -228,7 +228,14 @@ void ColladaSerializer::ColladaExporter::write(const std::string& guid, const st
 		}
 		material_references.push_back(collada_id(material.name()));
 	}
-	deferreds.push_back(DeferredObject(guid, name, type, obj_id, matrix, vertices, normals, indices, material_ids, _materials, material_references));
+	if (!geometry_name.empty() && !instanced_geometries.insert(geometry_name).second) {
+		// The geometry is written for the first instance only
+		const std::vector<double> no_floats;
+		const std::vector<int> no_ints;
+		deferreds.push_back(DeferredObject(guid, name, type, obj_id, matrix, no_floats, no_floats, no_ints, no_ints, _materials, material_references, geometry_name));
+	} else {
+		deferreds.push_back(DeferredObject(guid, name, type, obj_id, matrix, vertices, normals, indices, material_ids, _materials, material_references, geometry_name));
+	}
 }
 
 const std::string ColladaSerializer::ColladaExporter::DeferredObject::Name() const {
@@ -241,18 +248,22 @@ const std::string ColladaSerializer::ColladaExporter::DeferredObject::Name() con
 	return collada_id(ss.str());
 }
 
+const std::string ColladaSerializer::ColladaExporter::DeferredObject::GeometryName() const {
+	return geometry_name.empty() ? Name() : collada_id(geometry_name);
+}
+
 void ColladaSerializer::ColladaExporter::endDocument() {
 	// In fact due the XML based nature of Collada and its dependency on library nodes,
 	// only at this point all objects are written to the stream.
 	materials.write();
+	// Instances other than the first have no indices and are skipped here
 	for (std::vector<DeferredObject>::const_iterator it = deferreds.begin(); it != deferreds.end(); ++it) {
-		const std::string object_name = it->Name();
-		geometries.write(object_name, it->type, it->vertices, it->normals, it->indices, it->material_ids, it->materials);
+		geometries.write(it->GeometryName(), it->type, it->vertices, it->normals, it->indices, it->material_ids, it->materials);
 	}
 	geometries.close();
 	for (std::vector<DeferredObject>::const_iterator it = deferreds.begin(); it != deferreds.end(); ++it) {
 		const std::string object_name = it->Name();
-		scene.add(object_name + "-instance", object_name, object_name, it->material_references, it->matrix);
+		scene.add(object_name + "-instance", object_name, it->GeometryName(), it->material_references, it->matrix);
 	}
 	scene.write();
 	stream.endDocument();
@@ -268,7 +279,13 @@ void ColladaSerializer::writeHeader() {
 
 void ColladaSerializer::write(const IfcGeom::TriangulationElement<double>* o) {
 	const IfcGeom::Representation::Triangulation<double>& mesh = o->geometry();
-	exporter.write(o->guid(), o->name(), o->type(), o->id(), o->transformation().matrix().data(), mesh.verts(), mesh.normals(), mesh.faces(), mesh.material_ids(), mesh.materials());
+	std::string geometry_name;
+	if (o->is_instance()) {
+		std::stringstream ss;
+		ss << "IfcRepresentationMap_" << mesh.id();
+		geometry_name = ss.str();
+	}
+	exporter.write(o->guid(), o->name(), o->type(), o->id(), o->transformation().matrix().data(), mesh.verts(), mesh.normals(), mesh.faces(), mesh.material_ids(), mesh.materials(), geometry_name);
 }
 
 void ColladaSerializer::finalize() {
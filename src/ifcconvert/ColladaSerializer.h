@@ -22,6 +22,8 @@
 #ifndef COLLADASERIALIZER_H
 #define COLLADASERIALIZER_H
 
+#include <set>
+
 #include <COLLADASWStreamWriter.h>
 #include <COLLADASWPrimitves.h>
 #include <COLLADASWLibraryGeometries.h>
@@ -96,6 +98,8 @@ private:
 		public:
 			std::string guid, name, type;
 			int obj_id;
+			// The name of the shared geometry of an instance, empty otherwise
+			std::string geometry_name;
 			std::vector<double> matrix;
 			std::vector<double> vertices;
 			std::vector<double> normals;
@@ -105,11 +109,12 @@ private:
 			std::vector<std::string> material_references;
 			DeferredObject(const std::string& guid, const std::string& name, const std::string& type, int obj_id, const std::vector<double>& matrix, const std::vector<double>& vertices,
 				const std::vector<double>& normals, const std::vector<int>& indices, const std::vector<int>& material_ids, 
-				const std::vector<IfcGeom::Material>& materials, const std::vector<std::string>& material_references)
+				const std::vector<IfcGeom::Material>& materials, const std::vector<std::string>& material_references, const std::string& geometry_name)
 				: guid(guid)
 				, name(name)
 				, type(type)
 				, obj_id(obj_id)
+				, geometry_name(geometry_name)
 				, matrix(matrix)
 				, vertices(vertices)
 				, normals(normals)
@@ -119,12 +124,15 @@ private:
 				, material_references(material_references)
 			{}
 			const std::string Name() const;
+			const std::string GeometryName() const;
 		};
 		COLLADABU::NativeString filename;
 		COLLADASW::StreamWriter stream;
 		ColladaGeometries geometries;
 		ColladaScene scene;
 		ColladaMaterials materials;
+		// The shared geometries of which the vertices have been deferred
+		std::set<std::string> instanced_geometries;
 	public:
 		ColladaExporter(const std::string& scene_name, const std::string& fn)
 			: filename(fn.c_str())
@@ -136,7 +144,9 @@ private:
 		std::vector<DeferredObject> deferreds;
 		virtual ~ColladaExporter() {}
 		void startDocument(const std::string& unit_name, float unit_magnitude);
-		void write(const std::string& guid, const std::string& name, const std::string& type, int obj_id, const std::vector<double>& matrix, const std::vector<double>& vertices, const std::vector<double>& normals, const std::vector<int>& indices, const std::vector<int>& material_ids, const std::vector<IfcGeom::Material>& materials);
+		// Instances of the same geometry_name are written as nodes that refer
+		// to a single geometry. An empty geometry_name denotes a unique geometry.
+		void write(const std::string& guid, const std::string& name, const std::string& type, int obj_id, const std::vector<double>& matrix, const std::vector<double>& vertices, const std::vector<double>& normals, const std::vector<int>& indices, const std::vector<int>& material_ids, const std::vector<IfcGeom::Material>& materials, const std::string& geometry_name = "");
 		void endDocument();
 	};
 	ColladaExporter exporter;
@@ -153,6 +163,7 @@ public:
 	void write(const IfcGeom::BRepElement<double>* o) {}
 	void finalize();
 	bool isTesselated() const { return true; }
+	bool supportsInstancing() const { return true; }
 	void setUnitNameAndMagnitude(const std::string& name, float magnitude) {
 		unit_name = name;
 		unit_magnitude = magnitude;
@@ -28,6 +28,10 @@ public:
 	virtual ~GeometrySerializer() {} 
 
 	virtual bool isTesselated() const = 0;
+	// Whether elements that share the geometry of an IfcRepresentationMap
+	// are written as references to a single geometry, see the setting
+	// IfcGeom::IteratorSettings::INSTANCE_MAPPED_ITEMS
+	virtual bool supportsInstancing() const { return false; }
 	virtual void write(const IfcGeom::TriangulationElement<double>* o) = 0;
 	virtual void write(const IfcGeom::BRepElement<double>* o) = 0;
 	virtual void setUnitNameAndMagnitude(const std::string& name, float magnitude) = 0;
@@ -87,6 +87,9 @@ int main(int argc, char** argv) {
 		("output-file", boost::program_options::value<std::string>(), "output geometry file");
 
 	std::vector<std::string> entity_vector;
+	int num_threads;
+	int cache_budget;
+	std::string validation_policy;
 	boost::program_options::options_description geom_options;
 	geom_options.add_options()
 		("weld-vertices",
@@ -120,6 +123,47 @@ int main(int argc, char** argv) {
 		("disable-opening-subtractions", 
 			"Specifies whether to disable the boolean subtraction of "
 			"IfcOpeningElement Representations from their RelatingElements.")
+		("threads,j", boost::program_options::value<int>(&num_threads)->default_value(1),
+			"Specifies the number of threads used to create geometry. A value of "
+			"zero uses the number of hardware threads available.")
+		("cache-budget", boost::program_options::value<int>(&cache_budget)->default_value(0),
+			"Specifies the approximate amount of memory in megabytes that is used "
+			"to cache converted shapes. The least recently used shapes are evicted "
+			"when this is exceeded. A value of zero means no limit.")
+		("preserve-order",
+			"Specifies whether elements are written in the same order as when "
+			"a single thread is used, rather than in the order in which they "
+			"are finished.")
+		("instance-mapped-items",
+			"Specifies whether elements that are represented by an IfcMappedItem "
+			"are written as instances of a single geometry per IfcRepresentationMap "
+			"rather than as separate copies. Only supported for Collada files.")
+		("parallel-triangulation",
+			"Specifies whether the faces of a single shape are triangulated by "
+			"multiple threads. Useful for models with few but very large shapes.")
+		("direct-extrusion-meshes",
+			"Specifies whether extrusions of rectangles and polyline profiles "
+			"are triangulated directly, without creating their shapes first. "
+			"Only applies to elements without openings.")
+		("direct-face-set-meshes",
+			"Specifies whether the planar faces of faceted breps and surface models "
+			"that are bounded by polyloops are triangulated directly, without "
+			"sewing them into shells first. Only applies to elements without openings.")
+		("validation-policy", boost::program_options::value<std::string>(&validation_policy)->default_value("full"),
+			"Specifies how the results of boolean operations and shell sewing are "
+			"validated: 'full' checks every result, 'cheap' only checks results "
+			"that fail inexpensive sanity checks and 'none' accepts every result "
+			"that is produced.")
+		("volume-diagnostics",
+			"Specifies whether the volumes of the operands of subtractions are "
+			"computed to warn about empty operands and subtractions without "
+			"effect. This is costly and therefore otherwise only done to explain "
+			"failed subtractions. Only has effect with --verbose.")
+		("prismatic-openings",
+			"Specifies whether openings that cut through extruded walls and slabs "
+			"are subtracted from the profile of the extrusion rather than by "
+			"boolean operations. Only applies to openings that lie strictly "
+			"within the profile.")
 		("include", 
 			"Specifies that the entities listed after --entities are to be included")
 		("exclude", 
@@ -158,6 +202,10 @@ int main(int argc, char** argv) {
 		std::cerr << "[Error] --include and --ignore can not be specified together" << std::endl;
 		printUsage(generic_options, geom_options);
 		return 1;
+	} else if (validation_policy != "full" && validation_policy != "cheap" && validation_policy != "none") {
+		std::cerr << "[Error] --validation-policy should be one of 'full', 'cheap' or 'none'" << std::endl;
+		printUsage(generic_options, geom_options);
+		return 1;
 	}
 
 	const bool verbose = vmap.count("verbose") != 0;
@@ -168,6 +216,13 @@ int main(int argc, char** argv) {
 	const bool merge_boolean_operands = vmap.count("merge-boolean-operands") != 0;
 	const bool force_ccw_face_orientation = vmap.count("force-ccw-face-orientation") != 0;
 	const bool disable_opening_subtractions = vmap.count("disable-opening-subtractions") != 0;
+	const bool preserve_order = vmap.count("preserve-order") != 0;
+	const bool instance_mapped_items = vmap.count("instance-mapped-items") != 0;
+	const bool parallel_triangulation = vmap.count("parallel-triangulation") != 0;
+	const bool direct_extrusion_meshes = vmap.count("direct-extrusion-meshes") != 0;
+	const bool direct_face_set_meshes = vmap.count("direct-face-set-meshes") != 0;
+	const bool volume_diagnostics = vmap.count("volume-diagnostics") != 0;
+	const bool prismatic_openings = vmap.count("prismatic-openings") != 0;
 	const bool include_entities = vmap.count("include") != 0;
 
 	// Gets the set ifc types to be ignored from the command line. 
@@ -233,6 +288,20 @@ int main(int argc, char** argv) {
 	settings.set(IfcGeom::IteratorSettings::FASTER_BOOLEANS,              merge_boolean_operands);
 	settings.set(IfcGeom::IteratorSettings::FORCE_CCW_FACE_ORIENTATION,   force_ccw_face_orientation);
 	settings.set(IfcGeom::IteratorSettings::DISABLE_OPENING_SUBTRACTIONS, disable_opening_subtractions);
+	settings.set(IfcGeom::IteratorSettings::PRESERVE_ORDER,               preserve_order);
+	settings.set(IfcGeom::IteratorSettings::INSTANCE_MAPPED_ITEMS,        instance_mapped_items);
+	settings.set(IfcGeom::IteratorSettings::PARALLEL_TRIANGULATION,       parallel_triangulation);
+	settings.set(IfcGeom::IteratorSettings::DIRECT_EXTRUSION_MESHES,      direct_extrusion_meshes);
+	settings.set(IfcGeom::IteratorSettings::DIRECT_FACE_SET_MESHES,       direct_face_set_meshes);
+	settings.set(IfcGeom::IteratorSettings::VOLUME_DIAGNOSTICS,           volume_diagnostics);
+	settings.set(IfcGeom::IteratorSettings::PRISMATIC_OPENINGS,           prismatic_openings);
+	settings.num_threads() = num_threads;
+	settings.shape_cache_budget() = cache_budget;
+	settings.validation_policy() = validation_policy == "none"
+		? IfcGeom::IteratorSettings::VALIDATION_NONE
+		: validation_policy == "cheap"
+		? IfcGeom::IteratorSettings::VALIDATION_CHEAP
+		: IfcGeom::IteratorSettings::VALIDATION_FULL;
 
 	GeometrySerializer* serializer;
 	if (output_extension == ".obj") {
@@ -267,6 +336,11 @@ int main(int argc, char** argv) {
 		settings.disable_triangulation() = true;
 	}
 
+	if (instance_mapped_items && !serializer->supportsInstancing()) {
+		Logger::Message(Logger::LOG_NOTICE, "Instance mapped items setting ignored when writing WaveFront OBJ, STEP or IGES files");
+		settings.set(IfcGeom::IteratorSettings::INSTANCE_MAPPED_ITEMS, false);
+	}
+
 	IfcGeom::Iterator<double> context_iterator(settings, input_filename);
 
 	try {
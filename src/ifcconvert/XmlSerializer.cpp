@@ -29,7 +29,10 @@ boost::optional<std::string> format_attribute(const Argument* argument, IfcUtil:
 			break; }
 		case IfcUtil::Argument_STRING:
 		case IfcUtil::Argument_ENUMERATION: {
-			value = static_cast<std::string>(*argument);
+			// Interned values are copied from the string pool of the file
+			// instead of being decoded again
+			std::string decoded;
+			value = IfcParse::stringValue(argument, decoded);
 			break; }
 		case IfcUtil::Argument_INT: {
 			const int v = *argument;
@@ -38,6 +38,12 @@
 #include <gp_Pln.hxx>
 #include <TColgp_SequenceOfPnt.hxx>
 
+#include <list>
+#include <map>
+
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
 #include "../ifcparse/IfcParse.h"
 #include "../ifcparse/IfcUtil.h"
 
@@ -51,17 +57,180 @@ if ( it != cache.T.end() ) { e = it->second; return true; }
 
 namespace IfcGeom {
 
+/// A cache of shapes by instance id with an optional memory budget. When the
+/// approximate size of the cached shapes exceeds the budget, the least
+/// recently used shapes are evicted. Pinned shapes, such as the items of
+/// mapped representations, are never evicted and therefore do not count
+/// towards the budget, their size is reported separately.
+///
+/// Shapes of which the topology is still referenced elsewhere are skipped
+/// as well, as evicting these would not free any memory. This includes
+/// references held by other cached shapes: an item that is a sub-shape of
+/// a cached compound is only evicted after the compound has been evicted.
+class ShapeCache {
+public:
+	ShapeCache();
+
+	bool find(int id, TopoDS_Shape& shape);
+	void insert(int id, const TopoDS_Shape& shape, bool pinned = false);
+	void clear();
+
+	/// The budget in bytes, zero means unlimited, which is the default
+	size_t budget() const { return _budget; }
+	void budget(size_t bytes);
+
+	/// The approximate number of bytes occupied by the cached shapes that
+	/// are not pinned, which is bounded by the budget
+	size_t size_in_bytes() const { return _size; }
+	/// The approximate number of bytes occupied by the pinned shapes
+	size_t pinned_size_in_bytes() const { return _pinned_size; }
+	size_t size() const { return entries.size(); }
+
+	unsigned long hits() const { return _hits; }
+	unsigned long misses() const { return _misses; }
+	unsigned long evictions() const { return _evictions; }
+private:
+	struct entry {
+		TopoDS_Shape shape;
+		size_t bytes;
+		bool pinned;
+		std::list<int>::iterator position;
+	};
+	std::map<int, entry> entries;
+	// Unpinned entries, most recently used at the front
+	std::list<int> recently_used;
+	size_t _budget, _size, _pinned_size;
+	unsigned long _hits, _misses, _evictions;
+
+	void evict();
+	static size_t estimate_size(const TopoDS_Shape& shape);
+
+	ShapeCache(const ShapeCache&);
+	ShapeCache& operator=(const ShapeCache&);
+};
+
 class Cache {
 public:
 #include "IfcRegisterCreateCache.h"
 	std::map<int, SurfaceStyle> Style;
-	std::map<int, TopoDS_Shape> Shape;
+	ShapeCache Shape;
+	// The faces and wires of profiles are stored along with the shapes, so
+	// that they are bounded by the same budget, see Kernel::find_profile().
+	// Parameterized profiles are also found by their attribute values, which
+	// map to the id of the first instance converted with these values.
+	// Beyond MAX_PARAMETERIZED_PROFILES keys, no new keys are remembered.
+	static const size_t MAX_PARAMETERIZED_PROFILES = 4096;
+	std::map<std::string, int> ParameterizedProfile;
+	unsigned long profile_hits, profile_misses;
+	Cache() : profile_hits(0), profile_misses(0) {}
+};
+
+/// A cache of shapes, object placements and surface styles that can be
+/// shared by several Kernel instances, also when these are used from
+/// different threads. Entries are distributed over a number of shards by
+/// instance id, each guarded by its own mutex. Cached values depend on the
+/// settings of the kernel that created them, so a cache should only be
+/// shared by kernels that process the same file with the same settings.
+class SharedCache {
+public:
+	static const unsigned int num_shards = 16;
+
+	/// The cache stores a copy of the shapes inserted, so that the topology
+	/// is not shared with the kernel that created it. The shapes returned
+	/// share their topology with the cache and with other threads, they are
+	/// therefore read-only: operations that modify the faces of a shape, such
+	/// as meshing and healing, need to be applied to a copy. Failed
+	/// conversions are stored as null shapes, find_shape() then returns true
+	/// with a null shape.
+	bool find_shape(int id, TopoDS_Shape& shape);
+	void insert_shape(int id, const TopoDS_Shape& shape, bool pinned = false);
+
+	/// Divides the budget in bytes for shapes over the shards, see ShapeCache
+	void shape_budget(size_t bytes);
+	unsigned long shape_hits();
+	unsigned long shape_misses();
+	unsigned long shape_evictions();
+	size_t shape_pinned_size_in_bytes();
+
+	bool find_placement(int id, gp_Trsf& trsf);
+	void insert_placement(int id, const gp_Trsf& trsf);
+
+	/// The styles returned remain valid until the cache is cleared or freed.
+	/// Elements keep a copy of their styles, see Material.
+	const SurfaceStyle* find_style(int id);
+	const SurfaceStyle* insert_style(int id, const SurfaceStyle& style);
+
+	/// Removes all entries. Not to be called while any kernel using this
+	/// cache is creating geometry.
+	void clear();
+
+	SharedCache() {}
+private:
+	SharedCache(const SharedCache&);
+	SharedCache& operator=(const SharedCache&);
+
+	template <typename T>
+	struct shard {
+		boost::mutex mutex;
+		std::map<int, T> values;
+	};
+	struct shape_shard {
+		boost::mutex mutex;
+		ShapeCache values;
+	};
+
+	shape_shard shapes[num_shards];
+	shard<gp_Trsf> placements[num_shards];
+	shard<SurfaceStyle> styles[num_shards];
 };
 
 class Kernel {
 private:
 	Cache cache;
+	SharedCache* shared_cache;
+	// Shapes converted while this is non-zero are part of a mapped
+	// representation and are pinned in the shape cache
+	int mapped_item_depth;
+	// Whether extrusions of polygonal profiles are to be converted to a
+	// PolygonalExtrusion rather than to a shape, see convert_polygonal_extrusion()
+	bool direct_extrusion_meshes;
+	// Whether faceted breps and surface models are to be converted to
+	// PolygonalFaceSets, see convert_polygonal_face_sets()
+	bool direct_face_set_meshes;
+
+	double deflection_tolerance;
+	double wire_creation_tolerance;
+	double minimal_face_area;
+	double point_equality_tolerance;
+	double max_faces_to_sew;
+	double ifc_length_unit;
+	double ifc_planeangle_unit;
+	double force_ccw_face_orientation;
+	double modelling_precision;
+	double boolean_fuzziness;
+	double parallel_booleans;
+	double validation_policy;
+	double volume_diagnostics;
+	double prismatic_openings;
 public:
+	Kernel();
+
+	/// Uses the cache, in addition to the private cache of this kernel, to
+	/// look up and store shapes, placements and styles. The cache is not
+	/// owned by the kernel and needs to outlive it.
+	void set_shared_cache(SharedCache* c) { shared_cache = c; }
+	SharedCache* get_shared_cache() const { return shared_cache; }
+
+	/// The private cache of converted shapes, which can be used to set a
+	/// memory budget and to obtain the hit, miss and eviction counts. Not
+	/// used for shapes when a shared cache is set.
+	ShapeCache& shape_cache() { return cache.Shape; }
+
+	/// The number of profiles found in, respectively added to, the cache of
+	/// converted profile faces and wires
+	unsigned long profile_cache_hits() const { return cache.profile_hits; }
+	unsigned long profile_cache_misses() const { return cache.profile_misses; }
+
 	// Tolerances and settings for various geometrical operations:
 	enum GeomValue {
 		// Specifies the deflection of the mesher
@@ -94,7 +263,30 @@ public:
 		// The precision used in boolean operations, setting this value too low results
 		// in artefacts and potentially modelling failures
 		// Default: 0.00001 (obtained from IfcGeometricRepresentationContext if available)
-		GV_PRECISION
+		GV_PRECISION,
+		// The fuzzy value of the boolean operations that subtract multiple openings
+		// at once, requires Open Cascade 6.9 or later
+		// Default: -1.0 (= not set, no fuzzy value is used)
+		GV_BOOLEAN_FUZZINESS,
+		// To run the boolean operations that subtract multiple openings at once in
+		// parallel, set this value greater than zero. Requires Open Cascade 6.9 or later
+		// Default: -1.0
+		GV_PARALLEL_BOOLEANS,
+		// How thoroughly the results of boolean operations and sewing are validated,
+		// one of the values of IteratorSettings::ValidationPolicy
+		// Default: 0.0 (= IteratorSettings::VALIDATION_FULL)
+		GV_VALIDATION_POLICY,
+		// Whether the volumes of the operands and results of subtractions are
+		// computed to log empty operands and subtractions without effect. To
+		// have these computed, set this value greater than zero. Otherwise
+		// volumes are only computed to explain failed subtractions.
+		// Default: -1.0
+		GV_VOLUME_DIAGNOSTICS,
+		// Whether openings that cut through an extruded shape are subtracted
+		// from its profile, see IteratorSettings::PRISMATIC_OPENINGS. To
+		// enable this, set this value greater than zero.
+		// Default: -1.0
+		GV_PRISMATIC_OPENINGS
 	};
 
 	bool convert_wire_to_face(const TopoDS_Wire& wire, TopoDS_Face& face);
@@ -106,8 +298,55 @@ public:
 	bool convert_wire(const IfcUtil::IfcBaseClass* L, TopoDS_Wire& result);
 	bool convert_curve(const IfcUtil::IfcBaseClass* L, Handle(Geom_Curve)& result);
 	bool convert_face(const IfcUtil::IfcBaseClass* L, TopoDS_Shape& result);
+	// Bypass the profile cache
+	bool convert_wire_uncached(const IfcUtil::IfcBaseClass* L, TopoDS_Wire& result);
+	bool convert_face_uncached(const IfcUtil::IfcBaseClass* L, TopoDS_Shape& result);
+	// Profile faces are keyed by instance id and their wires by the negated
+	// id, in the shared cache if set. Copies are stored and returned, so that
+	// the solids created from a profile do not share it.
+	bool find_profile(int key, TopoDS_Shape& result);
+	void insert_profile(int key, const TopoDS_Shape& profile);
 	bool convert_openings(const IfcSchema::IfcProduct* entity, const IfcSchema::IfcRelVoidsElement::list::ptr& openings, const IfcRepresentationShapeItems& entity_shapes, const gp_Trsf& entity_trsf, IfcRepresentationShapeItems& cut_shapes);
 	bool convert_openings_fast(const IfcSchema::IfcProduct* entity, const IfcSchema::IfcRelVoidsElement::list::ptr& openings, const IfcRepresentationShapeItems& entity_shapes, const gp_Trsf& entity_trsf, IfcRepresentationShapeItems& cut_shapes);
+	// Converts the opening shapes and locates them, as solids, in the
+	// coordinate system of the entity
+	void convert_opening_shapes(const IfcSchema::IfcProduct* entity, const IfcSchema::IfcRelVoidsElement::list::ptr& openings, const gp_Trsf& entity_trsf, std::vector<TopoDS_Shape>& opening_shapes);
+	bool convert_openings(const IfcSchema::IfcProduct* entity, const std::vector<TopoDS_Shape>& opening_shapes, const IfcRepresentationShapeItems& entity_shapes, IfcRepresentationShapeItems& cut_shapes);
+	// Returns false if any opening could not be subtracted, see
+	// subtract_openings()
+	bool convert_openings_fast(const IfcSchema::IfcProduct* entity, const std::vector<TopoDS_Shape>& opening_shapes, const IfcRepresentationShapeItems& entity_shapes, IfcRepresentationShapeItems& cut_shapes);
+	// A single boolean operation with multiple tools
+	bool boolean_cut(const TopoDS_Shape& shape, std::vector<TopoDS_Shape>::const_iterator begin, std::vector<TopoDS_Shape>::const_iterator end, TopoDS_Shape& result);
+	// Adds the openings that cut through the prismatic shape as holes to
+	// its profile, which is extruded anew. The indices of the subtracted
+	// openings are removed, false is returned if there are none.
+	bool subtract_prismatic_openings(const TopoDS_Shape& shape, const std::vector<TopoDS_Shape>& opening_shapes, std::vector<int>& openings, TopoDS_Shape& result);
+	// Bisects a batch that fails, so that only the openings that fail on
+	// their own are skipped. Returns false if any opening was skipped.
+	bool subtract_openings(const IfcSchema::IfcProduct* entity, const TopoDS_Shape& shape, std::vector<TopoDS_Shape>::const_iterator begin, std::vector<TopoDS_Shape>::const_iterator end, TopoDS_Shape& result);
+	// Heals and checks the result according to GV_VALIDATION_POLICY. The
+	// result is expected to lie within the bounding box of bounds, if any.
+	bool is_valid_result(TopoDS_Shape& result, const TopoDS_Shape& bounds, bool heal, const IfcUtil::IfcBaseClass* entity = 0);
+	// Empty, out of bounds, or solids with unshared edges
+	bool is_suspicious_result(const TopoDS_Shape& result, const TopoDS_Shape& bounds);
+	// Only extrusions of rectangles and of profiles bounded by polylines
+	bool convert_polygonal_extrusion(const IfcSchema::IfcExtrudedAreaSolid* l, PolygonalExtrusion& extrusion);
+	bool convert_polygonal_loop(const IfcSchema::IfcCurve* l, std::vector<gp_XYZ>& loop);
+	// Faceted breps and surface models of which all faces are planar and
+	// bounded by IfcPolyLoops, otherwise no items are added
+	bool convert_polygonal_face_sets(const IfcSchema::IfcRepresentationItem* l, IfcRepresentationShapeItems& shapes);
+	bool convert_polygonal_face_set(const IfcSchema::IfcConnectedFaceSet* l, PolygonalFaceSet& face_set);
+	// The loops of a degenerate face are left empty
+	bool convert_polygonal_face(const IfcSchema::IfcFace* l, PolygonalFace& face);
+	// Merges the vertices on a grid and orients the faces along their shared
+	// edges, in linear time unlike BRepOffsetAPI_Sewing. Disconnected faces
+	// result in a compound of shells.
+	bool sew_polygonal_faces(const IfcSchema::IfcConnectedFaceSet* l, TopoDS_Shape& shape);
+	// Also finds the placements resolved by kernels sharing the cache
+	bool find_placement(const IfcSchema::IfcObjectPlacement* l, gp_Trsf& trsf);
+	// Resolves the placement tree level by level, dividing every level
+	// over the kernels, which run on a thread each and should share a cache
+	static void resolve_placements(IfcSchema::IfcLocalPlacement::list::ptr placements, const std::vector<Kernel*>& kernels);
 	IfcSchema::IfcSurfaceStyleShading* get_surface_style(IfcSchema::IfcRepresentationItem* item);
 	bool create_solid_from_compound(const TopoDS_Shape& compound, TopoDS_Shape& solid);
 	bool is_compound(const TopoDS_Shape& shape);
@@ -118,6 +357,10 @@ public:
 	const TopoDS_Shape& ensure_fit_for_subtraction(const TopoDS_Shape& shape, TopoDS_Shape& solid);
 	bool profile_helper(int numVerts, double* verts, int numFillets, int* filletIndices, double* filletRadii, gp_Trsf2d trsf, TopoDS_Shape& face); 
 	double shape_volume(const TopoDS_Shape& s);
+	// Whether GV_VOLUME_DIAGNOSTICS is set and warnings are logged
+	bool volume_diagnostics_enabled();
+	// Warns if the shape has no faces or, when requested, no volume
+	void report_empty_shape(const TopoDS_Shape& s, bool compute_volume, const std::string& message, IfcAbstractEntity* entity);
 	double face_area(const TopoDS_Face& f);
 	void apply_tolerance(TopoDS_Shape& s, double t);
 	void setValue(GeomValue var, double value);
@@ -129,9 +372,24 @@ public:
 
 	IfcSchema::IfcObjectDefinition* get_decomposing_entity(IfcSchema::IfcProduct*);
 
+	// Returns the openings to be subtracted from the product, including the
+	// openings of the element of which an IfcBuildingElementPart is a part
+	IfcSchema::IfcRelVoidsElement::list::ptr find_openings(IfcSchema::IfcProduct*);
+
+	// The transformation of the MappingTarget combined with the MappingOrigin
+	bool convert_mapping(const IfcSchema::IfcMappedItem* mapped_item, gp_GTrsf& trsf);
+
 	template <typename P>
 	IfcGeom::BRepElement<P>* create_brep_for_representation_and_product(const IteratorSettings&, IfcSchema::IfcRepresentation*, IfcSchema::IfcProduct*);
 
+	// Creates the element for a representation that consists of a single
+	// IfcMappedItem in the coordinate system of the IfcRepresentationMap, with
+	// the mapping applied to the placement of the element. Returns zero when
+	// the representation can not be instanced, i.e. when it consists of other
+	// items, when the mapping is non-uniform or when openings are subtracted.
+	template <typename P>
+	IfcGeom::BRepElement<P>* create_brep_for_mapped_item(const IteratorSettings&, IfcSchema::IfcRepresentation*, IfcSchema::IfcProduct*);
+
 	const SurfaceStyle* get_style(const IfcSchema::IfcRepresentationItem* representation_item);
 	
 	template <typename T> std::pair<IfcSchema::IfcSurfaceStyle*, T*> get_surface_style(const IfcSchema::IfcRepresentationItem* representation_item) {
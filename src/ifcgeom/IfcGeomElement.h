@@ -73,6 +73,7 @@ namespace IfcGeom {
 		std::string _type;
 		std::string _guid;
 		Transformation<P> _transformation;
+		bool _is_instance;
 	public:
 		int id() const { return _id; }
 		int parent_id() const { return _parent_id; }
@@ -80,8 +81,12 @@ namespace IfcGeom {
 		const std::string& type() const { return _type; }
 		const std::string& guid() const { return _guid; }
 		const Transformation<P>& transformation() const { return _transformation; }
-		Element(const ElementSettings& settings, int id, int parent_id, const std::string& name, const std::string& type, const std::string& guid, const gp_Trsf& trsf)
-			: _id(id), _parent_id(parent_id), _name(name), _type(type), _guid(guid), _transformation(settings, trsf)
+		// Whether the element is an occurrence of an IfcRepresentationMap, in
+		// which case the geometry is shared with the other occurrences and the
+		// id of the geometry is the id of the IfcRepresentationMap
+		bool is_instance() const { return _is_instance; }
+		Element(const ElementSettings& settings, int id, int parent_id, const std::string& name, const std::string& type, const std::string& guid, const gp_Trsf& trsf, bool is_instance = false)
+			: _id(id), _parent_id(parent_id), _name(name), _type(type), _guid(guid), _transformation(settings, trsf), _is_instance(is_instance)
 		{}
 		virtual ~Element() {}
 	};
@@ -92,8 +97,8 @@ namespace IfcGeom {
 		Representation::BRep* _geometry;
 	public:
 		const Representation::BRep& geometry() const { return *_geometry; }
-		BRepElement(int id, int parent_id, const std::string& name, const std::string& type, const std::string& guid, const gp_Trsf& trsf, Representation::BRep* geometry)
-			: Element<P>(geometry->settings(),id,parent_id,name,type,guid,trsf)
+		BRepElement(int id, int parent_id, const std::string& name, const std::string& type, const std::string& guid, const gp_Trsf& trsf, Representation::BRep* geometry, bool is_instance = false)
+			: Element<P>(geometry->settings(),id,parent_id,name,type,guid,trsf,is_instance)
 			, _geometry(geometry)
 		{}
 		virtual ~BRepElement() {
@@ -104,19 +109,27 @@ namespace IfcGeom {
 		BRepElement& operator=(const BRepElement& other);		
 	};
 
+	// The triangulation and serialization are reference counted, so that
+	// instances of the same IfcRepresentationMap can share them.
 	template <typename P>
 	class TriangulationElement : public Element<P> {
+	public:
+		typedef Representation::Triangulation<P> geometry_type;
+		typedef SHARED_PTR<geometry_type> geometry_ptr;
 	private:
-		Representation::Triangulation<P>* _geometry;
+		geometry_ptr _geometry;
 	public:
 		const Representation::Triangulation<P>& geometry() const { return *_geometry; }
+		const geometry_ptr& geometry_pointer() const { return _geometry; }
 		TriangulationElement(const BRepElement<P>& shape_model)
 			: Element<P>(shape_model)
 			, _geometry(new Representation::Triangulation<P>(shape_model.geometry()))
 		{}
-		virtual ~TriangulationElement() {
-			delete _geometry;
-		}
+		TriangulationElement(const BRepElement<P>& shape_model, const geometry_ptr& geometry)
+			: Element<P>(shape_model)
+			, _geometry(geometry)
+		{}
+		virtual ~TriangulationElement() {}
 	private:
 		TriangulationElement(const TriangulationElement& other);
 		TriangulationElement& operator=(const TriangulationElement& other);
@@ -124,17 +137,23 @@ namespace IfcGeom {
 
 	template <typename P>
 	class SerializedElement : public Element<P> {
+	public:
+		typedef Representation::Serialization geometry_type;
+		typedef SHARED_PTR<geometry_type> geometry_ptr;
 	private:
-		Representation::Serialization* _geometry;
+		geometry_ptr _geometry;
 	public:
 		const Representation::Serialization& geometry() const { return *_geometry; }
+		const geometry_ptr& geometry_pointer() const { return _geometry; }
 		SerializedElement(const BRepElement<P>& shape_model)
 			: Element<P>(shape_model)
 			, _geometry(new Representation::Serialization(shape_model.geometry()))
 		{}
-		virtual ~SerializedElement() {
-			delete _geometry;
-		}
+		SerializedElement(const BRepElement<P>& shape_model, const geometry_ptr& geometry)
+			: Element<P>(shape_model)
+			, _geometry(geometry)
+		{}
+		virtual ~SerializedElement() {}
 	private:
 		SerializedElement(const SerializedElement& other);
 		SerializedElement& operator=(const SerializedElement& other);
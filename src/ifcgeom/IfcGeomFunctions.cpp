@@ -84,9 +84,26 @@
 #include <BRepGProp.hxx>
 
 #include <BRepBuilderAPI_GTransform.hxx>
+#include <BRepBuilderAPI_Copy.hxx>
 
 #include <BRepCheck_Analyzer.hxx>
 
+#include <Standard_Version.hxx>
+#include <TopTools_ListOfShape.hxx>
+#include <TopoDS_Compound.hxx>
+#include <TopoDS_Iterator.hxx>
+#include <BRepAdaptor_Surface.hxx>
+#include <BRepClass_FaceClassifier.hxx>
+#include <BRepExtrema_DistShapeShape.hxx>
+#include <ShapeFix_Face.hxx>
+
+#include <Bnd_Box.hxx>
+#include <Bnd_HArray1OfBox.hxx>
+#include <Bnd_BoundSortBox.hxx>
+#include <BRepBndLib.hxx>
+#include <TColStd_ListOfInteger.hxx>
+#include <TColStd_ListIteratorOfListOfInteger.hxx>
+
 #include <BRepGProp_Face.hxx>
 
 #include <BRepMesh_IncrementalMesh.hxx>
@@ -145,8 +162,117 @@ const TopoDS_Shape& IfcGeom::Kernel::ensure_fit_for_subtraction(const TopoDS_Sha
 	return solid;
 }
 
-bool IfcGeom::Kernel::convert_openings(const IfcSchema::IfcProduct* entity, const IfcSchema::IfcRelVoidsElement::list::ptr& openings, 
-							   const IfcGeom::IfcRepresentationShapeItems& entity_shapes, const gp_Trsf& entity_trsf, IfcGeom::IfcRepresentationShapeItems& cut_shapes) {
+namespace {
+
+	// A spatial index of the bounding boxes of the opening shapes, so that
+	// only openings that possibly intersect a shape of the host element are
+	// passed to the boolean operations.
+	class OpeningBoxes {
+	private:
+		Bnd_BoundSortBox index;
+		double tolerance;
+		bool empty;
+	public:
+		OpeningBoxes(const std::vector<TopoDS_Shape>& shapes, double tolerance)
+			: tolerance(tolerance)
+			, empty(true)
+		{
+			if (shapes.empty()) return;
+			Handle(Bnd_HArray1OfBox) boxes = new Bnd_HArray1OfBox(1, (int) shapes.size());
+			Bnd_Box enclosing;
+			for (size_t i = 0; i < shapes.size(); ++i) {
+				Bnd_Box box;
+				// Not using an existing triangulation, which lies within
+				// curved surfaces, so that the boxes are conservative
+				BRepBndLib::Add(shapes[i], box, false);
+				box.Enlarge(tolerance);
+				boxes->SetValue((int) i + 1, box);
+				enclosing.Add(box);
+			}
+			if (enclosing.IsVoid()) return;
+			index.Initialize(enclosing, boxes);
+			empty = false;
+		}
+		// Returns the indices, in ascending order, of the openings with a
+		// bounding box that intersects the one of the shape
+		void intersecting(const TopoDS_Shape& shape, std::vector<int>& indices) {
+			indices.clear();
+			if (empty) return;
+			Bnd_Box box;
+			BRepBndLib::Add(shape, box, false);
+			if (box.IsVoid()) return;
+			box.Enlarge(tolerance);
+			const TColStd_ListOfInteger& ls = index.Compare(box);
+			for (TColStd_ListIteratorOfListOfInteger it(ls); it.More(); it.Next()) {
+				indices.push_back(it.Value() - 1);
+			}
+			std::sort(indices.begin(), indices.end());
+		}
+	};
+
+	// The outward normal of a planar face of a solid
+	gp_Dir planar_face_normal(const TopoDS_Face& face, const gp_Pln& pln) {
+		gp_Dir normal = pln.Position().Direct() ? pln.Axis().Direction() : pln.Axis().Direction().Reversed();
+		if (face.Orientation() == TopAbs_REVERSED) normal.Reverse();
+		return normal;
+	}
+
+	// The description of a solid as a right prism along a direction: the
+	// faces are either caps perpendicular to the direction, or lateral faces
+	// that contain the direction.
+	struct prism_t {
+		TopoDS_Face bottom;
+		double bottom_offset, top_offset;
+	};
+
+	bool analyse_prism(const TopoDS_Shape& shape, const gp_Dir& dir, prism_t& prism) {
+		const double angular_tolerance = 1.e-6;
+		if (shape.ShapeType() != TopAbs_SOLID) return false;
+		int num_shells = 0;
+		for (TopExp_Explorer exp(shape, TopAbs_SHELL); exp.More(); exp.Next()) {
+			++ num_shells;
+		}
+		if (num_shells != 1) return false;
+
+		bool has_bottom = false, has_top = false;
+		for (TopExp_Explorer exp(shape, TopAbs_FACE); exp.More(); exp.Next()) {
+			const TopoDS_Face& face = TopoDS::Face(exp.Current());
+			BRepAdaptor_Surface surface(face, false);
+			if (surface.GetType() == GeomAbs_Plane) {
+				const gp_Pln pln = surface.Plane();
+				const double cos_angle = planar_face_normal(face, pln).Dot(dir);
+				if (fabs(cos_angle) < angular_tolerance) {
+					continue;
+				} else if (cos_angle < -1. + angular_tolerance && !has_bottom) {
+					prism.bottom = face;
+					prism.bottom_offset = pln.Location().XYZ().Dot(dir.XYZ());
+					has_bottom = true;
+				} else if (cos_angle > 1. - angular_tolerance && !has_top) {
+					prism.top_offset = pln.Location().XYZ().Dot(dir.XYZ());
+					has_top = true;
+				} else {
+					return false;
+				}
+			} else if (surface.GetType() == GeomAbs_Cylinder) {
+				if (!surface.Cylinder().Axis().Direction().IsParallel(dir, angular_tolerance)) return false;
+			} else {
+				return false;
+			}
+		}
+		return has_bottom && has_top && prism.top_offset > prism.bottom_offset;
+	}
+
+	void report_skipped_subtractions(const IfcSchema::IfcProduct* entity, size_t skipped, size_t total) {
+		if (skipped == 0) return;
+		std::stringstream ss;
+		ss << "Skipped " << skipped << " of " << total << " opening subtractions that do not intersect the bounding box of:";
+		Logger::Message(Logger::LOG_NOTICE, ss.str(), entity->entity);
+	}
+
+}
+
+void IfcGeom::Kernel::convert_opening_shapes(const IfcSchema::IfcProduct* entity, const IfcSchema::IfcRelVoidsElement::list::ptr& openings, 
+							   const gp_Trsf& entity_trsf, std::vector<TopoDS_Shape>& located_opening_shapes) {
 	// Iterate over IfcOpeningElements
 	IfcGeom::IfcRepresentationShapeItems opening_shapes;
 	unsigned int last_size = 0;
@@ -177,6 +303,35 @@ bool IfcGeom::Kernel::convert_openings(const IfcSchema::IfcProduct* entity, cons
 		}
 	}
 
+	// The opening shapes are located in the coordinate system of the
+	// IfcProduct once, rather than for every shape of the IfcProduct
+	located_opening_shapes.reserve(located_opening_shapes.size() + opening_shapes.size());
+	for ( IfcGeom::IfcRepresentationShapeItems::const_iterator it4 = opening_shapes.begin(); it4 != opening_shapes.end(); ++ it4 ) {
+		TopoDS_Shape opening_shape_solid;
+		const TopoDS_Shape& opening_shape_unlocated = ensure_fit_for_subtraction(it4->Shape(),opening_shape_solid);
+		const gp_GTrsf& opening_shape_gtrsf = it4->Placement();
+		if ( opening_shape_gtrsf.Form() == gp_Other ) {
+			Logger::Message(Logger::LOG_WARNING,"Applying non uniform transformation to opening of:",entity->entity);
+		}
+		located_opening_shapes.push_back(opening_shape_gtrsf.Form() == gp_Other
+			? BRepBuilderAPI_GTransform(opening_shape_unlocated,opening_shape_gtrsf,true).Shape()
+			: opening_shape_unlocated.Moved(opening_shape_gtrsf.Trsf()));
+	}
+}
+
+bool IfcGeom::Kernel::convert_openings(const IfcSchema::IfcProduct* entity, const IfcSchema::IfcRelVoidsElement::list::ptr& openings, 
+							   const IfcGeom::IfcRepresentationShapeItems& entity_shapes, const gp_Trsf& entity_trsf, IfcGeom::IfcRepresentationShapeItems& cut_shapes) {
+	std::vector<TopoDS_Shape> opening_shapes;
+	convert_opening_shapes(entity, openings, entity_trsf, opening_shapes);
+	return convert_openings(entity, opening_shapes, entity_shapes, cut_shapes);
+}
+
+bool IfcGeom::Kernel::convert_openings(const IfcSchema::IfcProduct* entity, const std::vector<TopoDS_Shape>& located_opening_shapes, 
+							   const IfcGeom::IfcRepresentationShapeItems& entity_shapes, IfcGeom::IfcRepresentationShapeItems& cut_shapes) {
+	OpeningBoxes opening_boxes(located_opening_shapes, getValue(GV_PRECISION));
+	std::vector<int> intersecting_openings;
+	size_t num_skipped = 0;
+
 	// Iterate over the shapes of the IfcProduct
 	for ( IfcGeom::IfcRepresentationShapeItems::const_iterator it3 = entity_shapes.begin(); it3 != entity_shapes.end(); ++ it3 ) {
 		TopoDS_Shape entity_shape_solid;
@@ -190,23 +345,28 @@ bool IfcGeom::Kernel::convert_openings(const IfcSchema::IfcProduct* entity, cons
 			entity_shape = entity_shape_unlocated.Moved(entity_shape_gtrsf.Trsf());
 		}
 
+		// Openings that are disjoint from the shape are not subtracted
+		opening_boxes.intersecting(entity_shape, intersecting_openings);
+		num_skipped += located_opening_shapes.size() - intersecting_openings.size();
+
+		// Openings that cut through a prismatic shape along its direction are
+		// subtracted from its profile, which is then extruded anew
+		TopoDS_Shape prism;
+		if ( getValue(GV_PRISMATIC_OPENINGS) > 0. && subtract_prismatic_openings(entity_shape, located_opening_shapes, intersecting_openings, prism) ) {
+			entity_shape = prism;
+		}
+
 		// Iterate over the shapes of the IfcOpeningElements
-		for ( IfcGeom::IfcRepresentationShapeItems::const_iterator it4 = opening_shapes.begin(); it4 != opening_shapes.end(); ++ it4 ) {
-			TopoDS_Shape opening_shape_solid;
-			const TopoDS_Shape& opening_shape_unlocated = ensure_fit_for_subtraction(it4->Shape(),opening_shape_solid);
-			const gp_GTrsf& opening_shape_gtrsf = it4->Placement();
-			if ( opening_shape_gtrsf.Form() == gp_Other ) {
-				Logger::Message(Logger::LOG_WARNING,"Applying non uniform transformation to opening of:",entity->entity);
-			}
-			const TopoDS_Shape& opening_shape = opening_shape_gtrsf.Form() == gp_Other
-				? BRepBuilderAPI_GTransform(opening_shape_unlocated,opening_shape_gtrsf,true).Shape()
-				: opening_shape_unlocated.Moved(opening_shape_gtrsf.Trsf());
+		for ( std::vector<int>::const_iterator it4 = intersecting_openings.begin(); it4 != intersecting_openings.end(); ++ it4 ) {
+			const TopoDS_Shape& opening_shape = located_opening_shapes[*it4];
 					
-			double opening_volume, original_shape_volume;
-			if ( Logger::Verbosity() >= Logger::LOG_WARNING ) {
-				opening_volume = shape_volume(opening_shape);
-				if ( opening_volume <= ALMOST_ZERO )
-					Logger::Message(Logger::LOG_WARNING,"Empty opening for:",entity->entity);
+			// Volumes are only computed up front in diagnostic mode, otherwise
+			// the opening is only checked for volume when the subtraction fails
+			const bool volume_diagnostics = volume_diagnostics_enabled();
+
+			double original_shape_volume = 0.;
+			report_empty_shape(opening_shape, volume_diagnostics, "Empty opening for:", entity->entity);
+			if ( volume_diagnostics ) {
 				original_shape_volume = shape_volume(entity_shape);
 			}
 
@@ -226,8 +386,7 @@ bool IfcGeom::Kernel::convert_openings(const IfcSchema::IfcProduct* entity, cons
 					bool added = false;
 					if ( brep_cut.IsDone() ) {
 						TopoDS_Shape brep_cut_result = brep_cut;
-						BRepCheck_Analyzer analyser(brep_cut_result);
-						bool is_valid = analyser.IsValid() != 0;
+						bool is_valid = is_valid_result(brep_cut_result, exp.Current(), false);
 						if (is_valid) {
 							TopExp_Explorer exp(brep_cut_result, TopAbs_SOLID);
 							for (; exp.More(); exp.Next()) {
@@ -252,11 +411,10 @@ bool IfcGeom::Kernel::convert_openings(const IfcSchema::IfcProduct* entity, cons
 				if ( brep_cut.IsDone() ) {
 					TopoDS_Shape brep_cut_result = brep_cut;
 				
-					BRepCheck_Analyzer analyser(brep_cut_result);
-					bool is_valid = analyser.IsValid() != 0;
+					bool is_valid = is_valid_result(brep_cut_result, entity_shape, false);
 					if ( is_valid ) {
 						entity_shape = brep_cut;
-						if ( Logger::Verbosity() >= Logger::LOG_WARNING ) {
+						if ( volume_diagnostics ) {
 							const double volume_after_subtraction = shape_volume(entity_shape);
 					
 							if ( ALMOST_THE_SAME(original_shape_volume,volume_after_subtraction) )
@@ -264,9 +422,11 @@ bool IfcGeom::Kernel::convert_openings(const IfcSchema::IfcProduct* entity, cons
 						}
 					} else {
 						Logger::Message(Logger::LOG_ERROR,"Invalid result from subtraction:",entity->entity);
+						if ( !volume_diagnostics ) report_empty_shape(opening_shape, true, "Empty opening for:", entity->entity);
 					}
 				} else {
 					Logger::Message(Logger::LOG_ERROR,"Failed to process subtraction:",entity->entity);
+					if ( !volume_diagnostics ) report_empty_shape(opening_shape, true, "Empty opening for:", entity->entity);
 				}
 			}
 
@@ -274,49 +434,26 @@ bool IfcGeom::Kernel::convert_openings(const IfcSchema::IfcProduct* entity, cons
 		cut_shapes.push_back(IfcGeom::IfcRepresentationShapeItem(entity_shape, &it3->Style()));
 	}
 
+	report_skipped_subtractions(entity, num_skipped, entity_shapes.size() * located_opening_shapes.size());
+
 	return true;
 }
 
 bool IfcGeom::Kernel::convert_openings_fast(const IfcSchema::IfcProduct* entity, const IfcSchema::IfcRelVoidsElement::list::ptr& openings, 
 							   const IfcGeom::IfcRepresentationShapeItems& entity_shapes, const gp_Trsf& entity_trsf, IfcGeom::IfcRepresentationShapeItems& cut_shapes) {
-	
-	// Create a compound of all opening shapes in order to speed up the boolean operations
-	TopoDS_Compound opening_compound;
-	BRep_Builder builder;
-	builder.MakeCompound(opening_compound);
-
-	for ( IfcSchema::IfcRelVoidsElement::list::it it = openings->begin(); it != openings->end(); ++ it ) {
-		IfcSchema::IfcRelVoidsElement* v = *it;
-		IfcSchema::IfcFeatureElementSubtraction* fes = v->RelatedOpeningElement();
-		if ( fes->is(IfcSchema::Type::IfcOpeningElement) ) {
-
-			// Convert the IfcRepresentation of the IfcOpeningElement
-			gp_Trsf opening_trsf;
-			IfcGeom::Kernel::convert(fes->ObjectPlacement(),opening_trsf);
-
-			// Move the opening into the coordinate system of the IfcProduct
-			opening_trsf.PreMultiply(entity_trsf.Inverted());
-
-			IfcSchema::IfcProductRepresentation* prodrep = fes->Representation();
-			IfcSchema::IfcRepresentation::list::ptr reps = prodrep->Representations();
-
-			IfcGeom::IfcRepresentationShapeItems opening_shapes;
-						
-			for ( IfcSchema::IfcRepresentation::list::it it2 = reps->begin(); it2 != reps->end(); ++ it2 ) {
-				convert_shapes(*it2,opening_shapes);
-			}
-
-			for ( unsigned int i = 0; i < opening_shapes.size(); ++ i ) {
-				gp_GTrsf gtrsf = opening_shapes[i].Placement();
-				gtrsf.PreMultiply(opening_trsf);
-				const TopoDS_Shape& opening_shape = gtrsf.Form() == gp_Other
-					? BRepBuilderAPI_GTransform(opening_shapes[i].Shape(),gtrsf,true).Shape()
-					: (opening_shapes[i].Shape()).Moved(gtrsf.Trsf());
-				builder.Add(opening_compound,opening_shape);
-			}
+	std::vector<TopoDS_Shape> opening_shapes;
+	convert_opening_shapes(entity, openings, entity_trsf, opening_shapes);
+	return convert_openings_fast(entity, opening_shapes, entity_shapes, cut_shapes);
+}
 
-		}
-	}
+bool IfcGeom::Kernel::convert_openings_fast(const IfcSchema::IfcProduct* entity, const std::vector<TopoDS_Shape>& located_opening_shapes, 
+							   const IfcGeom::IfcRepresentationShapeItems& entity_shapes, IfcGeom::IfcRepresentationShapeItems& cut_shapes) {
+	
+	OpeningBoxes opening_boxes(located_opening_shapes, getValue(GV_PRECISION));
+	std::vector<int> intersecting_openings;
+	std::vector<TopoDS_Shape> tools;
+	size_t num_skipped = 0;
+	bool succeeded = true;
 
 	// Iterate over the shapes of the IfcProduct
 	for ( IfcGeom::IfcRepresentationShapeItems::const_iterator it3 = entity_shapes.begin(); it3 != entity_shapes.end(); ++ it3 ) {
@@ -331,26 +468,221 @@ bool IfcGeom::Kernel::convert_openings_fast(const IfcSchema::IfcProduct* entity,
 			entity_shape = entity_shape_unlocated.Moved(entity_shape_gtrsf.Trsf());
 		}
 
-		BRepAlgoAPI_Cut brep_cut(entity_shape,opening_compound);
-		bool is_valid = false;
-		if ( brep_cut.IsDone() ) {
-			TopoDS_Shape brep_cut_result = brep_cut;
-				
-			BRepCheck_Analyzer analyser(brep_cut_result);
-			is_valid = analyser.IsValid() != 0;
-			if ( is_valid ) {
-				cut_shapes.push_back(IfcGeom::IfcRepresentationShapeItem(brep_cut_result, &it3->Style()));
+		// Only the openings that possibly intersect the shape are subtracted
+		opening_boxes.intersecting(entity_shape, intersecting_openings);
+		num_skipped += located_opening_shapes.size() - intersecting_openings.size();
+
+		// Openings that cut through a prismatic shape along its direction are
+		// subtracted from its profile, which is then extruded anew
+		TopoDS_Shape prism;
+		if ( getValue(GV_PRISMATIC_OPENINGS) > 0. && subtract_prismatic_openings(entity_shape, located_opening_shapes, intersecting_openings, prism) ) {
+			entity_shape = prism;
+		}
+
+		tools.clear();
+		for ( std::vector<int>::const_iterator it4 = intersecting_openings.begin(); it4 != intersecting_openings.end(); ++ it4 ) {
+			tools.push_back(located_opening_shapes[*it4]);
+		}
+
+		// Openings that cannot be subtracted are logged and skipped, the
+		// caller is then to fall back to subtracting the openings one by one
+		TopoDS_Shape result;
+		if ( !subtract_openings(entity, entity_shape, tools.begin(), tools.end(), result) ) {
+			succeeded = false;
+		}
+		cut_shapes.push_back(IfcGeom::IfcRepresentationShapeItem(result, &it3->Style()));
+	}
+
+	report_skipped_subtractions(entity, num_skipped, entity_shapes.size() * located_opening_shapes.size());
+
+	return succeeded;
+}
+
+bool IfcGeom::Kernel::boolean_cut(const TopoDS_Shape& shape, std::vector<TopoDS_Shape>::const_iterator begin, std::vector<TopoDS_Shape>::const_iterator end, TopoDS_Shape& result) {
+#if OCC_VERSION_HEX >= 0x60900
+	TopTools_ListOfShape arguments, tools;
+	arguments.Append(shape);
+	for ( std::vector<TopoDS_Shape>::const_iterator it = begin; it != end; ++ it ) {
+		tools.Append(*it);
+	}
+	BRepAlgoAPI_Cut brep_cut;
+	brep_cut.SetArguments(arguments);
+	brep_cut.SetTools(tools);
+	const double fuzziness = getValue(GV_BOOLEAN_FUZZINESS);
+	if ( fuzziness > 0. ) {
+		brep_cut.SetFuzzyValue(fuzziness);
+	}
+	brep_cut.SetRunParallel(getValue(GV_PARALLEL_BOOLEANS) > 0.);
+	brep_cut.Build();
+#else
+	// This version of Open Cascade only accepts a single tool, for which
+	// a compound of the openings is used instead
+	TopoDS_Shape tool = *begin;
+	if ( end - begin > 1 ) {
+		TopoDS_Compound compound;
+		BRep_Builder builder;
+		builder.MakeCompound(compound);
+		for ( std::vector<TopoDS_Shape>::const_iterator it = begin; it != end; ++ it ) {
+			builder.Add(compound, *it);
+		}
+		tool = compound;
+	}
+	BRepAlgoAPI_Cut brep_cut(shape, tool);
+#endif
+	if ( !brep_cut.IsDone() ) return false;
+	result = brep_cut.Shape();
+	return is_valid_result(result, shape, false);
+}
+
+bool IfcGeom::Kernel::subtract_openings(const IfcSchema::IfcProduct* entity, const TopoDS_Shape& shape, std::vector<TopoDS_Shape>::const_iterator begin, std::vector<TopoDS_Shape>::const_iterator end, TopoDS_Shape& result) {
+	if ( begin == end ) {
+		result = shape;
+		return true;
+	}
+	
+	bool succeeded = false;
+	try {
+		succeeded = boolean_cut(shape, begin, end, result);
+	} catch (...) {}
+	if ( succeeded ) return true;
+
+	if ( end - begin == 1 ) {
+		Logger::Message(Logger::LOG_ERROR,"Failed to process subtraction:",entity->entity);
+		result = shape;
+		return false;
+	}
+
+	// Bisect the openings and subtract both halves in succession, so that
+	// only the openings that cause the failure end up being skipped
+	std::vector<TopoDS_Shape>::const_iterator middle = begin + (end - begin) / 2;
+	TopoDS_Shape intermediate;
+	const bool first_half = subtract_openings(entity, shape, begin, middle, intermediate);
+	const bool second_half = subtract_openings(entity, intermediate, middle, end, result);
+	return first_half && second_half;
+}
+
+bool IfcGeom::Kernel::subtract_prismatic_openings(const TopoDS_Shape& shape, const std::vector<TopoDS_Shape>& opening_shapes, std::vector<int>& openings, TopoDS_Shape& result) {
+	const double precision = getValue(GV_PRECISION);
+
+	TopoDS_Shape solid = shape;
+	if (solid.ShapeType() == TopAbs_COMPOUND) {
+		TopoDS_Iterator it(solid);
+		if (!it.More()) return false;
+		solid = it.Value();
+		it.Next();
+		if (it.More()) return false;
+	}
+
+	gp_Dir dir;
+	prism_t host;
+	bool has_direction = false;
+
+	TopoDS_Wire outer_wire;
+	std::vector<TopoDS_Wire> inner_wires;
+	TopoDS_Face profile;
+
+	std::vector<int> remaining;
+	for (std::vector<int>::const_iterator it = openings.begin(); it != openings.end(); ++it) {
+		const TopoDS_Shape& opening = opening_shapes[*it];
+		prism_t opening_prism;
+		bool is_prismatic = false;
+
+		if (has_direction) {
+			is_prismatic = analyse_prism(opening, dir, opening_prism);
+		} else {
+			// Any of the planar faces of the opening may be a cap of the prism
+			for (TopExp_Explorer exp(opening, TopAbs_FACE); exp.More() && !is_prismatic; exp.Next()) {
+				const TopoDS_Face& face = TopoDS::Face(exp.Current());
+				BRepAdaptor_Surface surface(face, false);
+				if (surface.GetType() != GeomAbs_Plane) continue;
+				const gp_Dir candidate = planar_face_normal(face, surface.Plane()).Reversed();
+				if (analyse_prism(opening, candidate, opening_prism) && analyse_prism(solid, candidate, host) &&
+					opening_prism.bottom_offset <= host.bottom_offset + precision && opening_prism.top_offset >= host.top_offset - precision)
+				{
+					dir = candidate;
+					has_direction = is_prismatic = true;
+					outer_wire = BRepTools::OuterWire(host.bottom);
+					for (TopExp_Explorer wexp(host.bottom, TopAbs_WIRE); wexp.More(); wexp.Next()) {
+						if (!wexp.Current().IsSame(outer_wire)) inner_wires.push_back(TopoDS::Wire(wexp.Current()));
+					}
+					profile = host.bottom;
+				}
+			}
+		}
+
+		// The opening needs to cut through the entire depth of the prism, with
+		// a profile consisting of a single wire
+		bool subtracted = false;
+		if (is_prismatic &&
+			opening_prism.bottom_offset <= host.bottom_offset + precision &&
+			opening_prism.top_offset >= host.top_offset - precision)
+		{
+			TopExp_Explorer wexp(opening_prism.bottom, TopAbs_WIRE);
+			const TopoDS_Wire opening_wire_unlocated = wexp.More() ? TopoDS::Wire(wexp.Current()) : TopoDS_Wire();
+			if (wexp.More()) wexp.Next();
+			if (!opening_wire_unlocated.IsNull() && !wexp.More()) {
+				// Project the profile of the opening onto the bottom of the host
+				gp_Trsf trsf;
+				trsf.SetTranslation(gp_Vec(dir) * (host.bottom_offset - opening_prism.bottom_offset));
+				const TopoDS_Wire opening_wire = TopoDS::Wire(opening_wire_unlocated.Moved(trsf));
+
+				// The profile of the opening needs to lie strictly within the
+				// profile of the host, without touching any of the holes, and
+				// should not enclose any of the holes either.
+				bool contained = true;
+				BRepClass_FaceClassifier classifier;
+				for (TopExp_Explorer vexp(opening_wire, TopAbs_VERTEX); vexp.More() && contained; vexp.Next()) {
+					classifier.Perform(profile, BRep_Tool::Pnt(TopoDS::Vertex(vexp.Current())), precision);
+					contained = classifier.State() == TopAbs_IN;
+				}
+				for (TopExp_Explorer pexp(profile, TopAbs_WIRE); pexp.More() && contained; pexp.Next()) {
+					BRepExtrema_DistShapeShape distance(opening_wire, pexp.Current());
+					contained = distance.IsDone() && distance.Value() > precision;
+				}
+				if (contained && !inner_wires.empty()) {
+					const TopoDS_Face opening_face = BRepBuilderAPI_MakeFace(opening_wire, true).Face();
+					for (std::vector<TopoDS_Wire>::const_iterator jt = inner_wires.begin(); jt != inner_wires.end() && contained; ++jt) {
+						TopExp_Explorer vexp(*jt, TopAbs_VERTEX);
+						classifier.Perform(opening_face, BRep_Tool::Pnt(TopoDS::Vertex(vexp.Current())), precision);
+						contained = classifier.State() == TopAbs_OUT;
+					}
+				}
+
+				if (contained) {
+					inner_wires.push_back(opening_wire);
+
+					// The profile is rebuilt, so that subsequent openings are
+					// tested against the holes added so far
+					const gp_Pln pln(gp_Pnt(dir.XYZ() * host.bottom_offset), dir);
+					BRepBuilderAPI_MakeFace mf(pln, outer_wire);
+					for (std::vector<TopoDS_Wire>::const_iterator jt = inner_wires.begin(); jt != inner_wires.end(); ++jt) {
+						mf.Add(*jt);
+					}
+					if (mf.IsDone()) {
+						ShapeFix_Face fix(mf.Face());
+						fix.FixOrientation();
+						fix.Perform();
+						profile = fix.Face();
+						subtracted = true;
+					} else {
+						inner_wires.pop_back();
+					}
+				}
 			}
 		}
-		if ( !is_valid ) {
-			// Apparently processing the boolean operation failed or resulted in an invalid result
-			// in which case the original shape without the subtractions is returned instead
-			// we try convert the openings in the original way, one by one.
-			Logger::Message(Logger::LOG_WARNING,"Subtracting combined openings compound failed:",entity->entity);
-			return false;
+
+		if (!subtracted) {
+			remaining.push_back(*it);
 		}
-		
 	}
+
+	if (remaining.size() == openings.size()) return false;
+
+	TopoDS_Shape prism = BRepPrimAPI_MakePrism(profile, gp_Vec(dir) * (host.top_offset - host.bottom_offset));
+	if (!is_valid_result(prism, shape, false)) return false;
+
+	result = prism;
+	openings.swap(remaining);
 	return true;
 }
 
@@ -410,11 +742,75 @@ bool IfcGeom::Kernel::profile_helper(int numVerts, double* verts, int numFillets
 	delete[] vertices;
 	return true;
 }
+bool IfcGeom::Kernel::is_suspicious_result(const TopoDS_Shape& result, const TopoDS_Shape& bounds) {
+	if ( !TopExp_Explorer(result, TopAbs_FACE).More() ) return true;
+
+	if ( !bounds.IsNull() ) {
+		Bnd_Box result_box, bounds_box;
+		BRepBndLib::Add(result, result_box, false);
+		BRepBndLib::Add(bounds, bounds_box, false);
+		if ( result_box.IsVoid() || bounds_box.IsVoid() ) return true;
+		// Boxes are not computed tightly, hence the margin
+		bounds_box.Enlarge((std::max)(getValue(GV_PRECISION), 0.01 * sqrt(bounds_box.SquareExtent())));
+		double rx0, ry0, rz0, rx1, ry1, rz1, bx0, by0, bz0, bx1, by1, bz1;
+		result_box.Get(rx0, ry0, rz0, rx1, ry1, rz1);
+		bounds_box.Get(bx0, by0, bz0, bx1, by1, bz1);
+		if ( rx0 < bx0 || ry0 < by0 || rz0 < bz0 || rx1 > bx1 || ry1 > by1 || rz1 > bz1 ) return true;
+	}
+
+	// The boundary of a solid is closed, every edge is shared by two faces
+	if ( TopExp_Explorer(result, TopAbs_SOLID).More() ) {
+		TopTools_IndexedDataMapOfShapeListOfShape edge_faces;
+		TopExp::MapShapesAndAncestors(result, TopAbs_EDGE, TopAbs_FACE, edge_faces);
+		for ( int i = 1; i <= edge_faces.Extent(); ++ i ) {
+			if ( edge_faces(i).Extent() < 2 && !BRep_Tool::Degenerated(TopoDS::Edge(edge_faces.FindKey(i))) ) return true;
+		}
+	}
+
+	return false;
+}
+
+bool IfcGeom::Kernel::is_valid_result(TopoDS_Shape& result, const TopoDS_Shape& bounds, bool heal, const IfcUtil::IfcBaseClass* entity) {
+	if ( result.IsNull() ) return false;
+
+	const int policy = (int) getValue(GV_VALIDATION_POLICY);
+	if ( policy == IteratorSettings::VALIDATION_NONE ) return true;
+	if ( policy == IteratorSettings::VALIDATION_CHEAP && !is_suspicious_result(result, bounds) ) return true;
+
+	if ( heal ) {
+		ShapeFix_Shape fix(result);
+		try {
+			fix.Perform();
+			result = fix.Shape();
+		} catch (...) {
+			Logger::Message(Logger::LOG_WARNING, "Shape healing failed on boolean result", entity ? entity->entity : 0);
+		}
+	}
+
+	return BRepCheck_Analyzer(result).IsValid() != 0;
+}
+
 double IfcGeom::Kernel::shape_volume(const TopoDS_Shape& s) {
 	GProp_GProps prop;
 	BRepGProp::VolumeProperties(s, prop);
 	return prop.Mass();
 }
+bool IfcGeom::Kernel::volume_diagnostics_enabled() {
+	// The diagnostics only produce warnings, there is no point in computing
+	// volumes when these are not logged anyway
+	return getValue(GV_VOLUME_DIAGNOSTICS) > 0. && Logger::Verbosity() <= Logger::LOG_WARNING;
+}
+void IfcGeom::Kernel::report_empty_shape(const TopoDS_Shape& s, bool compute_volume, const std::string& message, IfcAbstractEntity* entity) {
+	// A shape without faces is empty regardless of its volume, which is only
+	// integrated when asked for, as this is a full mass property computation
+	bool empty = !TopExp_Explorer(s, TopAbs_FACE).More();
+	if ( !empty && compute_volume && Logger::Verbosity() <= Logger::LOG_WARNING ) {
+		empty = shape_volume(s) <= ALMOST_ZERO;
+	}
+	if ( empty ) {
+		Logger::Message(Logger::LOG_WARNING, message, entity);
+	}
+}
 double IfcGeom::Kernel::face_area(const TopoDS_Face& f) {
 	GProp_GProps prop;
 	BRepGProp::SurfaceProperties(f,prop);
@@ -494,15 +890,221 @@ void IfcGeom::Kernel::apply_tolerance(TopoDS_Shape& s, double t) {
 	tol.SetTolerance(s, t);
 }
 
-static double deflection_tolerance = 0.001;
-static double wire_creation_tolerance = 0.0001;
-static double minimal_face_area = 0.000001;
-static double point_equality_tolerance = 0.00001;
-static double max_faces_to_sew = -1.0;
-static double ifc_length_unit = 1.0;
-static double ifc_planeangle_unit = -1.0;
-static double force_ccw_face_orientation = -1.0;
-static double modelling_precision = 0.00001;
+// The tolerances are stored per kernel instance, so that several kernels
+// can be used concurrently, each with their own settings.
+IfcGeom::Kernel::Kernel()
+	: shared_cache(0)
+	, mapped_item_depth(0)
+	, direct_extrusion_meshes(false)
+	, direct_face_set_meshes(false)
+	, deflection_tolerance(0.001)
+	, wire_creation_tolerance(0.0001)
+	, minimal_face_area(0.000001)
+	, point_equality_tolerance(0.00001)
+	, max_faces_to_sew(-1.0)
+	, ifc_length_unit(1.0)
+	, ifc_planeangle_unit(-1.0)
+	, force_ccw_face_orientation(-1.0)
+	, modelling_precision(0.00001)
+	, boolean_fuzziness(-1.)
+	, parallel_booleans(-1.)
+	, validation_policy(IteratorSettings::VALIDATION_FULL)
+	, volume_diagnostics(-1.0)
+	, prismatic_openings(-1.0)
+{}
+
+IfcGeom::ShapeCache::ShapeCache()
+	: _budget(0)
+	, _size(0)
+	, _pinned_size(0)
+	, _hits(0)
+	, _misses(0)
+	, _evictions(0)
+{}
+
+bool IfcGeom::ShapeCache::find(int id, TopoDS_Shape& shape) {
+	std::map<int, entry>::iterator it = entries.find(id);
+	if (it == entries.end()) {
+		++ _misses;
+		return false;
+	}
+	++ _hits;
+	entry& e = it->second;
+	if (!e.pinned) {
+		recently_used.splice(recently_used.begin(), recently_used, e.position);
+	}
+	shape = e.shape;
+	return true;
+}
+
+void IfcGeom::ShapeCache::insert(int id, const TopoDS_Shape& shape, bool pinned) {
+	std::map<int, entry>::iterator it = entries.find(id);
+	if (it != entries.end()) {
+		if (it->second.pinned) {
+			_pinned_size -= it->second.bytes;
+		} else {
+			_size -= it->second.bytes;
+			recently_used.erase(it->second.position);
+		}
+		entries.erase(it);
+	}
+	entry& e = entries[id];
+	e.shape = shape;
+	e.bytes = estimate_size(shape);
+	e.pinned = pinned;
+	if (pinned) {
+		_pinned_size += e.bytes;
+	} else {
+		recently_used.push_front(id);
+		e.position = recently_used.begin();
+		_size += e.bytes;
+		if (_budget && _size > _budget) evict();
+	}
+}
+
+void IfcGeom::ShapeCache::clear() {
+	entries.clear();
+	recently_used.clear();
+	_size = _pinned_size = 0;
+}
+
+void IfcGeom::ShapeCache::budget(size_t bytes) {
+	_budget = bytes;
+	if (_budget && _size > _budget) evict();
+}
+
+void IfcGeom::ShapeCache::evict() {
+	// Walk from the least recently used entry onwards, the most recently
+	// inserted shape at the front is likely to be requested again soon.
+	// Evicting a compound releases the references to its sub-shapes, which
+	// may have been skipped before, hence the walk is repeated as long as
+	// it frees memory.
+	bool evicted = true;
+	while (_size > _budget && evicted) {
+		evicted = false;
+		std::list<int>::iterator it = recently_used.end();
+		while (_size > _budget && it != recently_used.begin()) {
+			-- it;
+			std::map<int, entry>::iterator jt = entries.find(*it);
+			const TopoDS_Shape& shape = jt->second.shape;
+			if (!shape.IsNull() && shape.TShape()->GetRefCount() > 1) {
+				continue;
+			}
+			_size -= jt->second.bytes;
+			entries.erase(jt);
+			it = recently_used.erase(it);
+			++ _evictions;
+			evicted = true;
+		}
+	}
+}
+
+size_t IfcGeom::ShapeCache::estimate_size(const TopoDS_Shape& shape) {
+	// A rough approximation of the memory occupied by the topology and the
+	// underlying geometry, which is sufficient for bounding the cache size.
+	size_t bytes = sizeof(entry);
+	if (shape.IsNull()) return bytes;
+	for (TopExp_Explorer exp(shape, TopAbs_FACE); exp.More(); exp.Next()) bytes += 512;
+	for (TopExp_Explorer exp(shape, TopAbs_EDGE); exp.More(); exp.Next()) bytes += 256;
+	for (TopExp_Explorer exp(shape, TopAbs_VERTEX); exp.More(); exp.Next()) bytes += 96;
+	return bytes;
+}
+
+bool IfcGeom::SharedCache::find_shape(int id, TopoDS_Shape& shape) {
+	shape_shard& s = shapes[(unsigned int) id % num_shards];
+	boost::mutex::scoped_lock lock(s.mutex);
+	return s.values.find(id, shape);
+}
+
+void IfcGeom::SharedCache::insert_shape(int id, const TopoDS_Shape& shape, bool pinned) {
+	// The copy is made by the inserting thread, which is the only one to
+	// use the shape at this point, so that the cached shape is not shared
+	// with the kernel that created it.
+	const TopoDS_Shape copy = shape.IsNull() ? shape : BRepBuilderAPI_Copy(shape).Shape();
+	shape_shard& s = shapes[(unsigned int) id % num_shards];
+	boost::mutex::scoped_lock lock(s.mutex);
+	s.values.insert(id, copy, pinned);
+}
+
+void IfcGeom::SharedCache::shape_budget(size_t bytes) {
+	for (unsigned int i = 0; i < num_shards; ++i) {
+		boost::mutex::scoped_lock lock(shapes[i].mutex);
+		shapes[i].values.budget(bytes / num_shards);
+	}
+}
+
+unsigned long IfcGeom::SharedCache::shape_hits() {
+	unsigned long n = 0;
+	for (unsigned int i = 0; i < num_shards; ++i) {
+		boost::mutex::scoped_lock lock(shapes[i].mutex);
+		n += shapes[i].values.hits();
+	}
+	return n;
+}
+
+unsigned long IfcGeom::SharedCache::shape_misses() {
+	unsigned long n = 0;
+	for (unsigned int i = 0; i < num_shards; ++i) {
+		boost::mutex::scoped_lock lock(shapes[i].mutex);
+		n += shapes[i].values.misses();
+	}
+	return n;
+}
+
+unsigned long IfcGeom::SharedCache::shape_evictions() {
+	unsigned long n = 0;
+	for (unsigned int i = 0; i < num_shards; ++i) {
+		boost::mutex::scoped_lock lock(shapes[i].mutex);
+		n += shapes[i].values.evictions();
+	}
+	return n;
+}
+
+size_t IfcGeom::SharedCache::shape_pinned_size_in_bytes() {
+	size_t n = 0;
+	for (unsigned int i = 0; i < num_shards; ++i) {
+		boost::mutex::scoped_lock lock(shapes[i].mutex);
+		n += shapes[i].values.pinned_size_in_bytes();
+	}
+	return n;
+}
+
+bool IfcGeom::SharedCache::find_placement(int id, gp_Trsf& trsf) {
+	shard<gp_Trsf>& s = placements[(unsigned int) id % num_shards];
+	boost::mutex::scoped_lock lock(s.mutex);
+	std::map<int, gp_Trsf>::const_iterator it = s.values.find(id);
+	if (it == s.values.end()) return false;
+	trsf = it->second;
+	return true;
+}
+
+void IfcGeom::SharedCache::insert_placement(int id, const gp_Trsf& trsf) {
+	shard<gp_Trsf>& s = placements[(unsigned int) id % num_shards];
+	boost::mutex::scoped_lock lock(s.mutex);
+	s.values.insert(std::make_pair(id, trsf));
+}
+
+const IfcGeom::SurfaceStyle* IfcGeom::SharedCache::find_style(int id) {
+	shard<SurfaceStyle>& s = styles[(unsigned int) id % num_shards];
+	boost::mutex::scoped_lock lock(s.mutex);
+	std::map<int, SurfaceStyle>::const_iterator it = s.values.find(id);
+	return it == s.values.end() ? 0 : &it->second;
+}
+
+const IfcGeom::SurfaceStyle* IfcGeom::SharedCache::insert_style(int id, const SurfaceStyle& style) {
+	shard<SurfaceStyle>& s = styles[(unsigned int) id % num_shards];
+	boost::mutex::scoped_lock lock(s.mutex);
+	// If another kernel was first, its style is returned instead
+	return &s.values.insert(std::make_pair(id, style)).first->second;
+}
+
+void IfcGeom::SharedCache::clear() {
+	for (unsigned int i = 0; i < num_shards; ++i) {
+		{ boost::mutex::scoped_lock lock(shapes[i].mutex); shapes[i].values.clear(); }
+		{ boost::mutex::scoped_lock lock(placements[i].mutex); placements[i].values.clear(); }
+		{ boost::mutex::scoped_lock lock(styles[i].mutex); styles[i].values.clear(); }
+	}
+}
 
 void IfcGeom::Kernel::setValue(GeomValue var, double value) {
 	switch (var) {
@@ -533,6 +1135,21 @@ void IfcGeom::Kernel::setValue(GeomValue var, double value) {
 	case GV_PRECISION:
 		modelling_precision = value;
 		break;
+	case GV_BOOLEAN_FUZZINESS:
+		boolean_fuzziness = value;
+		break;
+	case GV_PARALLEL_BOOLEANS:
+		parallel_booleans = value;
+		break;
+	case GV_VALIDATION_POLICY:
+		validation_policy = value;
+		break;
+	case GV_VOLUME_DIAGNOSTICS:
+		volume_diagnostics = value;
+		break;
+	case GV_PRISMATIC_OPENINGS:
+		prismatic_openings = value;
+		break;
 	default:
 		assert(!"never reach here");
 	}
@@ -562,6 +1179,16 @@ double IfcGeom::Kernel::getValue(GeomValue var) {
 	case GV_PRECISION:
 		return modelling_precision;
 		break;
+	case GV_BOOLEAN_FUZZINESS:
+		return boolean_fuzziness;
+	case GV_PARALLEL_BOOLEANS:
+		return parallel_booleans;
+	case GV_VALIDATION_POLICY:
+		return validation_policy;
+	case GV_VOLUME_DIAGNOSTICS:
+		return volume_diagnostics;
+	case GV_PRISMATIC_OPENINGS:
+		return prismatic_openings;
 	}
 	assert(!"never reach here");
 	return 0;
@@ -744,6 +1371,11 @@ bool IfcGeom::Kernel::flatten_shape_list(const IfcGeom::IfcRepresentationShapeIt
 	builder.MakeCompound(compound);
 
 	result = TopoDS_Shape();
+
+	// The shapes returned by convert_shape() already have the precision
+	// applied and may be shared with the cache, so the tolerance is only
+	// applied to topology created here.
+	bool created = false;
 			
 	for ( IfcGeom::IfcRepresentationShapeItems::const_iterator it = shapes.begin(); it != shapes.end(); ++ it ) {
 		TopoDS_Shape merged;
@@ -762,11 +1394,14 @@ bool IfcGeom::Kernel::flatten_shape_list(const IfcGeom::IfcRepresentationShapeIt
 		} catch (...) {}
 		const TopoDS_Shape moved_shape = trsf_valid ? merged.Moved(_trsf) :
 			BRepBuilderAPI_GTransform(merged,trsf,true).Shape();
+		if (!trsf_valid || !merged.IsSame(s)) created = true;
 
 		if (shapes.size() == 1) {
 			result = moved_shape;
-			const double precision = getValue(GV_PRECISION);
-			apply_tolerance(result, precision);
+			if (created) {
+				const double precision = getValue(GV_PRECISION);
+				apply_tolerance(result, precision);
+			}
 			return true;
 		}
 
@@ -778,13 +1413,15 @@ bool IfcGeom::Kernel::flatten_shape_list(const IfcGeom::IfcRepresentationShapeIt
 				if ( brep_fuse.IsDone() ) {
 					TopoDS_Shape fused = brep_fuse;
 
-					ShapeFix_Shape fix(result);
-					fix.Perform();
-					result = fix.Shape();
-		
-					bool is_valid = BRepCheck_Analyzer(result).IsValid() != 0;
+					TopoDS_Compound operands;
+					builder.MakeCompound(operands);
+					builder.Add(operands, result);
+					builder.Add(operands, moved_shape);
+
+					bool is_valid = is_valid_result(fused, operands, true);
 					if ( is_valid ) {
 						result = fused;
+						created = true;
 					} 
 				}
 			}
@@ -794,7 +1431,7 @@ bool IfcGeom::Kernel::flatten_shape_list(const IfcGeom::IfcRepresentationShapeIt
 	}
 
 	const bool success = !result.IsNull();
-	if (success) {
+	if (success && created) {
 		const double precision = getValue(GV_PRECISION);
 		apply_tolerance(result, precision);
 	}
@@ -831,7 +1468,22 @@ IfcGeom::BRepElement<P>* IfcGeom::Kernel::create_brep_for_representation_and_pro
 	IfcGeom::Representation::BRep* shape;
 	IfcGeom::IfcRepresentationShapeItems shapes;
 
-	if ( !convert_shapes(representation,shapes) ) {
+	IfcSchema::IfcRelVoidsElement::list::ptr openings = find_openings(product);
+	const bool has_openings = !settings.disable_opening_subtractions() && openings && openings->size();
+
+	// Items are only triangulated directly if their shapes are not needed
+	const bool direct_meshes = !settings.use_brep_data() && !settings.disable_triangulation() && !has_openings;
+	direct_extrusion_meshes = direct_meshes && settings.direct_extrusion_meshes();
+	direct_face_set_meshes = direct_meshes && settings.direct_face_set_meshes();
+	bool converted;
+	try {
+		converted = convert_shapes(representation,shapes);
+	} catch (...) {
+		direct_extrusion_meshes = direct_face_set_meshes = false;
+		throw;
+	}
+	direct_extrusion_meshes = direct_face_set_meshes = false;
+	if ( !converted ) {
 		return 0;
 	}
 
@@ -843,53 +1495,35 @@ IfcGeom::BRepElement<P>* IfcGeom::Kernel::create_brep_for_representation_and_pro
 		}
 	} catch (...) {}
 		
-	const std::string name = product->hasName() ? product->Name() : "";
-	const std::string guid = product->GlobalId();
+	// GlobalId and Name are the first and third attribute of IfcRoot, which
+	// are referred to in the string pool of the file when strings are interned
+	std::string name_copy, guid_copy;
+	const std::string& name = product->hasName() ? IfcParse::stringValue(product->entity->getArgument(2), name_copy) : name_copy;
+	const std::string& guid = IfcParse::stringValue(product->entity->getArgument(0), guid_copy);
 		
 	gp_Trsf trsf;
 	try {
 		convert(product->ObjectPlacement(),trsf);
 	} catch (...) {}
 
-	// Does the IfcElement have any IfcOpenings?
-	// Note that openings for IfcOpeningElements are not processed
-	IfcSchema::IfcRelVoidsElement::list::ptr openings;
-	if ( product->is(IfcSchema::Type::IfcElement) && !product->is(IfcSchema::Type::IfcOpeningElement) ) {
-		IfcSchema::IfcElement* element = (IfcSchema::IfcElement*)product;
-		openings = element->HasOpenings();
-	}
-	// Is the IfcElement a decomposition of an IfcElement with any IfcOpeningElements?
-	if ( product->is(IfcSchema::Type::IfcBuildingElementPart ) ) {
-		IfcSchema::IfcBuildingElementPart* part = (IfcSchema::IfcBuildingElementPart*)product;
-#ifdef USE_IFC4
-		IfcSchema::IfcRelAggregates::list::ptr decomposes = part->Decomposes();
-		for ( IfcSchema::IfcRelAggregates::list::it it = decomposes->begin(); it != decomposes->end(); ++ it ) {
-#else
-		IfcSchema::IfcRelDecomposes::list::ptr decomposes = part->Decomposes();
-		for ( IfcSchema::IfcRelDecomposes::list::it it = decomposes->begin(); it != decomposes->end(); ++ it ) {
-#endif
-			IfcSchema::IfcObjectDefinition* obdef = (*it)->RelatingObject();
-			if ( obdef->is(IfcSchema::Type::IfcElement) ) {
-				IfcSchema::IfcElement* element = (IfcSchema::IfcElement*)obdef;
-				openings->push(element->HasOpenings());
-			}
-		}
-	}
-
 	const std::string product_type = IfcSchema::Type::ToString(product->type());
 	ElementSettings element_settings(settings, getValue(GV_LENGTH_UNIT), product_type);
 
-	if ( !settings.disable_opening_subtractions() && openings && openings->size() ) {
+	if ( has_openings ) {
 		IfcGeom::IfcRepresentationShapeItems opened_shapes;
 		try {
+			// The opening shapes are converted once and reused in case the
+			// faster approach fails
+			std::vector<TopoDS_Shape> opening_shapes;
+			convert_opening_shapes(product,openings,trsf,opening_shapes);
 			if ( settings.faster_booleans() ) {
-				bool succes = convert_openings_fast(product,openings,shapes,trsf,opened_shapes);
+				bool succes = convert_openings_fast(product,opening_shapes,shapes,opened_shapes);
 				if ( ! succes ) {
 					opened_shapes.clear();
-					convert_openings(product,openings,shapes,trsf,opened_shapes);
+					convert_openings(product,opening_shapes,shapes,opened_shapes);
 				}
 			} else {
-				convert_openings(product,openings,shapes,trsf,opened_shapes);
+				convert_openings(product,opening_shapes,shapes,opened_shapes);
 			}
 		} catch(...) { 
 			Logger::Message(Logger::LOG_ERROR,"Error processing openings for:",product->entity); 
@@ -922,6 +1556,117 @@ IfcGeom::BRepElement<P>* IfcGeom::Kernel::create_brep_for_representation_and_pro
 	);
 }
 
+IfcSchema::IfcRelVoidsElement::list::ptr IfcGeom::Kernel::find_openings(IfcSchema::IfcProduct* product) {
+	// Does the IfcElement have any IfcOpenings?
+	// Note that openings for IfcOpeningElements are not processed
+	IfcSchema::IfcRelVoidsElement::list::ptr openings;
+	if ( product->is(IfcSchema::Type::IfcElement) && !product->is(IfcSchema::Type::IfcOpeningElement) ) {
+		IfcSchema::IfcElement* element = (IfcSchema::IfcElement*)product;
+		openings = element->HasOpenings();
+	}
+	// Is the IfcElement a decomposition of an IfcElement with any IfcOpeningElements?
+	if ( product->is(IfcSchema::Type::IfcBuildingElementPart ) ) {
+		IfcSchema::IfcBuildingElementPart* part = (IfcSchema::IfcBuildingElementPart*)product;
+#ifdef USE_IFC4
+		IfcSchema::IfcRelAggregates::list::ptr decomposes = part->Decomposes();
+		for ( IfcSchema::IfcRelAggregates::list::it it = decomposes->begin(); it != decomposes->end(); ++ it ) {
+#else
+		IfcSchema::IfcRelDecomposes::list::ptr decomposes = part->Decomposes();
+		for ( IfcSchema::IfcRelDecomposes::list::it it = decomposes->begin(); it != decomposes->end(); ++ it ) {
+#endif
+			IfcSchema::IfcObjectDefinition* obdef = (*it)->RelatingObject();
+			if ( obdef->is(IfcSchema::Type::IfcElement) ) {
+				IfcSchema::IfcElement* element = (IfcSchema::IfcElement*)obdef;
+				openings->push(element->HasOpenings());
+			}
+		}
+	}
+
+	return openings;
+}
+
+template <typename P>
+IfcGeom::BRepElement<P>* IfcGeom::Kernel::create_brep_for_mapped_item(const IteratorSettings& settings, IfcSchema::IfcRepresentation* representation, IfcSchema::IfcProduct* product) {
+	IfcSchema::IfcRepresentationItem::list::ptr items = representation->Items();
+	if ( items->size() != 1 || !(*items->begin())->is(IfcSchema::Type::IfcMappedItem) ) {
+		return 0;
+	}
+	IfcSchema::IfcMappedItem* mapped_item = (IfcSchema::IfcMappedItem*) *items->begin();
+
+	// Openings are subtracted from the individual occurrences, which
+	// therefore can not share their geometry with the other occurrences
+	if ( !settings.disable_opening_subtractions() ) {
+		IfcSchema::IfcRelVoidsElement::list::ptr openings = find_openings(product);
+		if ( openings && openings->size() ) {
+			return 0;
+		}
+	}
+
+	// A non-uniform mapping can not be represented by the matrix of the element
+	gp_GTrsf mapping;
+	if ( !convert_mapping(mapped_item, mapping) || mapping.Form() == gp_Other ) {
+		return 0;
+	}
+
+	IfcSchema::IfcRepresentationMap* map = mapped_item->MappingSource();
+	IfcGeom::IfcRepresentationShapeItems shapes;
+	++ mapped_item_depth;
+	const bool direct_meshes = !settings.use_brep_data() && !settings.disable_triangulation();
+	direct_extrusion_meshes = direct_meshes && settings.direct_extrusion_meshes();
+	direct_face_set_meshes = direct_meshes && settings.direct_face_set_meshes();
+	bool converted;
+	try {
+		converted = convert_shapes(map->MappedRepresentation(), shapes);
+	} catch (...) {
+		-- mapped_item_depth;
+		direct_extrusion_meshes = direct_face_set_meshes = false;
+		throw;
+	}
+	-- mapped_item_depth;
+	direct_extrusion_meshes = direct_face_set_meshes = false;
+	if ( !converted ) {
+		return 0;
+	}
+
+	int parent_id = -1;
+	try {
+		IfcSchema::IfcObjectDefinition* parent_object = get_decomposing_entity(product);
+		if (parent_object) {
+			parent_id = parent_object->entity->id();
+		}
+	} catch (...) {}
+
+	// GlobalId and Name are the first and third attribute of IfcRoot, which
+	// are referred to in the string pool of the file when strings are interned
+	std::string name_copy, guid_copy;
+	const std::string& name = product->hasName() ? IfcParse::stringValue(product->entity->getArgument(2), name_copy) : name_copy;
+	const std::string& guid = IfcParse::stringValue(product->entity->getArgument(0), guid_copy);
+
+	gp_Trsf trsf;
+	try {
+		convert(product->ObjectPlacement(),trsf);
+	} catch (...) {}
+	trsf.Multiply(mapping.Trsf());
+
+	const std::string product_type = IfcSchema::Type::ToString(product->type());
+	ElementSettings element_settings(settings, getValue(GV_LENGTH_UNIT), product_type);
+
+	// Note that the USE_WORLD_COORDS setting is not applied, as the whole
+	// point of instancing is that the coordinates are shared by all instances
+	IfcGeom::Representation::BRep* shape = new IfcGeom::Representation::BRep(element_settings, map->entity->id(), shapes);
+
+	return new BRepElement<P>(
+		product->entity->id(),
+		parent_id,
+		name,
+		product_type,
+		guid,
+		trsf,
+		shape,
+		true
+	);
+}
+
 IfcSchema::IfcObjectDefinition* IfcGeom::Kernel::get_decomposing_entity(IfcSchema::IfcProduct* product) {
 	IfcSchema::IfcObjectDefinition* parent = 0;
 
@@ -979,6 +1724,8 @@ IfcSchema::IfcObjectDefinition* IfcGeom::Kernel::get_decomposing_entity(IfcSchem
 
 template IfcGeom::BRepElement<float>* IfcGeom::Kernel::create_brep_for_representation_and_product<float>(const IteratorSettings& settings, IfcSchema::IfcRepresentation* representation, IfcSchema::IfcProduct* product);
 template IfcGeom::BRepElement<double>* IfcGeom::Kernel::create_brep_for_representation_and_product<double>(const IteratorSettings& settings, IfcSchema::IfcRepresentation* representation, IfcSchema::IfcProduct* product);
+template IfcGeom::BRepElement<float>* IfcGeom::Kernel::create_brep_for_mapped_item<float>(const IteratorSettings& settings, IfcSchema::IfcRepresentation* representation, IfcSchema::IfcProduct* product);
+template IfcGeom::BRepElement<double>* IfcGeom::Kernel::create_brep_for_mapped_item<double>(const IteratorSettings& settings, IfcSchema::IfcRepresentation* representation, IfcSchema::IfcProduct* product);
 
 std::pair<std::string, double> IfcGeom::Kernel::initializeUnits(IfcSchema::IfcUnitAssignment* unit_assignment) {
 	// Set default units, set length to meters, angles to undefined
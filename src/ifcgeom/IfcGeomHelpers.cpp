@@ -75,6 +75,8 @@
 
 #include <TopLoc_Location.hxx>
 
+#include <boost/bind.hpp>
+
 #include "../ifcgeom/IfcGeom.h"
 
 bool IfcGeom::Kernel::convert(const IfcSchema::IfcCartesianPoint* l, gp_Pnt& point) {
@@ -280,27 +282,109 @@ bool IfcGeom::Kernel::convert(const IfcSchema::IfcAxis2Placement2D* l, gp_Trsf2d
 	return true;
 }
 
-bool IfcGeom::Kernel::convert(const IfcSchema::IfcObjectPlacement* l, gp_Trsf& trsf) {
+bool IfcGeom::Kernel::find_placement(const IfcSchema::IfcObjectPlacement* l, gp_Trsf& trsf) {
 	IN_CACHE(IfcObjectPlacement,l,gp_Trsf,trsf)
+	if ( shared_cache && shared_cache->find_placement(l->entity->id(), trsf) ) {
+		CACHE(IfcObjectPlacement,l,trsf)
+		return true;
+	}
+	return false;
+}
+
+bool IfcGeom::Kernel::convert(const IfcSchema::IfcObjectPlacement* l, gp_Trsf& trsf) {
+	if ( find_placement(l, trsf) ) return true;
 	if ( ! l->is(IfcSchema::Type::IfcLocalPlacement) ) {
 		Logger::Message(Logger::LOG_ERROR, "Unsupported IfcObjectPlacement:", l->entity);
 		return false; 		
 	}
+	// Walk up the chain of relative placements until one is found that has
+	// been resolved before, then resolve and cache the placements on the way
+	// back down. This way every placement in the file is converted only once,
+	// also the ones that are shared by many elements, such as storeys.
+	std::vector<IfcSchema::IfcLocalPlacement*> chain;
+	gp_Trsf parent_trsf;
 	IfcSchema::IfcLocalPlacement* current = (IfcSchema::IfcLocalPlacement*)l;
 	while (1) {
-		gp_Trsf trsf2;
-		IfcSchema::IfcAxis2Placement* relplacement = current->RelativePlacement();
+		chain.push_back(current);
+		if ( ! current->hasPlacementRelTo() ) break;
+		IfcSchema::IfcObjectPlacement* relto = current->PlacementRelTo();
+		// Placements relative to other types of placements are interpreted as
+		// relative to the origin
+		if ( ! relto->is(IfcSchema::Type::IfcLocalPlacement) ) break;
+		if ( find_placement(relto, parent_trsf) ) break;
+		current = (IfcSchema::IfcLocalPlacement*)relto;
+	}
+	for ( std::vector<IfcSchema::IfcLocalPlacement*>::reverse_iterator it = chain.rbegin(); it != chain.rend(); ++ it ) {
+		gp_Trsf local_trsf = parent_trsf;
+		IfcSchema::IfcAxis2Placement* relplacement = (*it)->RelativePlacement();
 		if ( relplacement->is(IfcSchema::Type::IfcAxis2Placement3D) ) {
+			gp_Trsf trsf2;
 			IfcGeom::Kernel::convert((IfcSchema::IfcAxis2Placement3D*)relplacement,trsf2);
-			trsf.PreMultiply(trsf2);
+			local_trsf.Multiply(trsf2);
 		}
-		if ( current->hasPlacementRelTo() ) {
-			IfcSchema::IfcObjectPlacement* relto = current->PlacementRelTo();
-			if ( relto->is(IfcSchema::Type::IfcLocalPlacement) )
-				current = (IfcSchema::IfcLocalPlacement*)current->PlacementRelTo();
-			else break;			
-		} else break;
+		CACHE(IfcObjectPlacement,(*it),local_trsf)
+		if ( shared_cache ) shared_cache->insert_placement((*it)->entity->id(), local_trsf);
+		parent_trsf = local_trsf;
 	}
-	CACHE(IfcObjectPlacement,l,trsf)
+	trsf = parent_trsf;
 	return true;
+}
+
+namespace {
+	// Resolves every num_kernels-th placement, starting at offset
+	void resolve_placement_range(IfcGeom::Kernel* kernel, const std::vector<IfcSchema::IfcLocalPlacement*>* placements, size_t offset, size_t num_kernels) {
+		for ( size_t i = offset; i < placements->size(); i += num_kernels ) {
+			gp_Trsf trsf;
+			try {
+				kernel->convert((*placements)[i], trsf);
+			} catch (...) {}
+		}
+	}
+}
+
+void IfcGeom::Kernel::resolve_placements(IfcSchema::IfcLocalPlacement::list::ptr placements, const std::vector<Kernel*>& kernels) {
+	if ( kernels.empty() ) return;
+
+	// Group the placements by their depth in the placement tree, so that the
+	// placements of a level only depend on placements of the levels before.
+	std::map<int, size_t> depths;
+	std::vector< std::vector<IfcSchema::IfcLocalPlacement*> > levels;
+	for ( IfcSchema::IfcLocalPlacement::list::it it = placements->begin(); it != placements->end(); ++ it ) {
+		std::vector<IfcSchema::IfcLocalPlacement*> chain;
+		size_t depth = 0;
+		IfcSchema::IfcLocalPlacement* current = *it;
+		while (1) {
+			std::map<int, size_t>::const_iterator jt = depths.find(current->entity->id());
+			if ( jt != depths.end() ) {
+				depth = jt->second + 1;
+				break;
+			}
+			chain.push_back(current);
+			if ( ! current->hasPlacementRelTo() ) break;
+			IfcSchema::IfcObjectPlacement* relto = current->PlacementRelTo();
+			if ( ! relto->is(IfcSchema::Type::IfcLocalPlacement) ) break;
+			current = (IfcSchema::IfcLocalPlacement*)relto;
+		}
+		for ( std::vector<IfcSchema::IfcLocalPlacement*>::reverse_iterator jt = chain.rbegin(); jt != chain.rend(); ++ jt, ++ depth ) {
+			depths[(*jt)->entity->id()] = depth;
+			if ( levels.size() <= depth ) levels.resize(depth + 1);
+			levels[depth].push_back(*jt);
+		}
+	}
+
+	// The levels are resolved one after the other, the placements within a
+	// level in parallel. Kernels find the placements of the previous levels
+	// resolved by the other kernels in their shared cache.
+	for ( std::vector< std::vector<IfcSchema::IfcLocalPlacement*> >::const_iterator it = levels.begin(); it != levels.end(); ++ it ) {
+		const size_t num_kernels = (std::min)(kernels.size(), it->size());
+		if ( num_kernels <= 1 ) {
+			resolve_placement_range(kernels[0], &*it, 0, 1);
+		} else {
+			boost::thread_group threads;
+			for ( size_t i = 0; i < num_kernels; ++ i ) {
+				threads.create_thread(boost::bind(&resolve_placement_range, kernels[i], &*it, i, num_kernels));
+			}
+			threads.join_all();
+		}
+	}
 }
\ No newline at end of file
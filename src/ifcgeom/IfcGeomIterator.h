@@ -64,6 +64,11 @@
 #include <limits>
 #include <algorithm>
 
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
 #include <gp_Mat.hxx>
 #include <gp_Mat2d.hxx>
 #include <gp_GTrsf.hxx>
@@ -89,22 +94,99 @@ namespace IfcGeom {
 
 		IfcParse::IfcFile* ifc_file;
 
-		// A container and iterator for IfcRepresentations
+		// A container for IfcRepresentations
 		IfcSchema::IfcRepresentation::list::ptr representations;
-		IfcSchema::IfcRepresentation::list::it representation_iterator;
 
 		// The object is fetched beforehand to be sure that get() returns a valid element
 		TriangulationElement<P>* current_triangulation;
 		BRepElement<P>* current_shape_model;
 		SerializedElement<P>* current_serialization;
 		
-		// A container and iterator for IfcBuildingElements for the current IfcRepresentation referenced by *representation_iterator
-		IfcSchema::IfcProduct::list::ptr ifcproducts;
+		// The job that is processed in serial mode and an iterator over its
+		// IfcProducts
+		size_t current_job;
 		IfcSchema::IfcProduct::list::it ifcproduct_iterator;
 
 		int done;
 		int total;
 
+		// The combinations of representations and products are gathered
+		// beforehand. In serial mode the jobs are processed in order. When
+		// multiple threads are used every job is processed by a worker thread
+		// using its own Kernel, so that the caches and settings of the kernels
+		// are not shared between threads.
+		struct job_t {
+			IfcSchema::IfcRepresentation* representation;
+			IfcSchema::IfcProduct::list::ptr products;
+			double cost;
+		};
+		struct result_t {
+			BRepElement<P>* shape_model;
+			TriangulationElement<P>* triangulation;
+			SerializedElement<P>* serialization;
+		};
+		typedef std::vector<result_t> results_t;
+
+		std::vector<job_t> jobs;
+		// The order in which jobs are handed out to the worker threads
+		std::vector<size_t> schedule;
+		std::vector<std::pair<int, double> > product_costs;
+		std::vector<Kernel*> worker_kernels;
+		// Shapes, placements and styles created by one of the workers are
+		// reused by the others, e.g. for representation maps and openings
+		SharedCache* shared_cache;
+		boost::thread_group workers;
+
+		// The results of finished jobs by job index, guarded by queue_mutex.
+		// Workers only take a new job when less than queue_capacity jobs are
+		// waiting to be consumed, which bounds the amount of memory in use.
+		std::map<size_t, results_t> finished_jobs;
+		size_t jobs_taken;
+		size_t jobs_consumed;
+		size_t queue_capacity;
+		bool cancelled;
+		boost::mutex queue_mutex;
+		boost::condition_variable queue_changed;
+
+		// The elements of the job that is currently being consumed
+		results_t current_results;
+		size_t current_result_index;
+
+		bool parallel() const {
+			return !worker_kernels.empty();
+		}
+
+		// When mapped items are instanced, the triangulation or serialization
+		// of an IfcRepresentationMap is created once and shared by all its
+		// instances. The product type of the first instance is recorded, as
+		// default materials depend on it. Guarded by instance_mutex, as the
+		// instances are created by the worker threads in parallel mode.
+		typedef typename TriangulationElement<P>::geometry_ptr triangulation_ptr;
+		typedef typename SerializedElement<P>::geometry_ptr serialization_ptr;
+		std::map<int, std::string> instance_types;
+		std::map<int, triangulation_ptr> instance_triangulations;
+		std::map<int, serialization_ptr> instance_serializations;
+		boost::mutex instance_mutex;
+
+		// The triangulation or serialization of the representation that is
+		// being processed. The products of a representation are processed one
+		// after the other, by the same thread, and the ones of which the shape
+		// is not made product-specific by openings or world coordinates reuse
+		// it rather than to triangulate the representation again. As the
+		// iterator uses a single deflection tolerance, the representation id
+		// suffices to identify the triangulation.
+		struct representation_geometry_t {
+			triangulation_ptr triangulation;
+			serialization_ptr serialization;
+			std::string product_type;
+			void reset() {
+				triangulation.reset();
+				serialization.reset();
+				product_type.clear();
+			}
+		};
+		representation_geometry_t representation_geometry;
+
 		std::string unit_name;
 		// double?
 		P unit_magnitude;
@@ -224,17 +306,23 @@ namespace IfcGeom {
 
 			if (representations->size() == 0) return false;
 
-			representation_iterator = representations->begin();
-			ifcproducts.reset();
+			if (!gather_jobs()) return false;
 
-			if (!create()) {
-				return false;
+			done = 0;
+			total = (int) jobs.size();
+
+			int num_threads = settings.num_threads();
+			if (num_threads <= 0) {
+				num_threads = (int) boost::thread::hardware_concurrency();
+			}
+			if (num_threads > 1) {
+				return start_workers(num_threads);
 			}
 
-			done = 0;
-			total = representations->size();
+			current_job = 0;
+			ifcproduct_iterator = jobs[current_job].products->begin();
 
-			return true;
+			return create();
 		}
 
 		int progress() {
@@ -267,86 +355,428 @@ namespace IfcGeom {
 			include_entities_in_processing = false;
 		}
 
+		// Returns a rough, unitless estimate of the effort needed to create the
+		// geometry of the product. It is based on the number of faces of the
+		// explicit shells in the representation and the number of openings
+		// that need to be subtracted from it.
+		double estimate_cost(IfcSchema::IfcRepresentation* representation, IfcSchema::IfcProduct* product) {
+			double cost = 0.;
+			IfcSchema::IfcRepresentationItem::list::ptr items = representation->Items();
+			for (IfcSchema::IfcRepresentationItem::list::it it = items->begin(); it != items->end(); ++it) {
+				cost += estimate_item_cost(*it, 0);
+			}
+			int num_openings = 0;
+			if (!settings.disable_opening_subtractions() && product->is(IfcSchema::Type::IfcElement) && !product->is(IfcSchema::Type::IfcOpeningElement)) {
+				num_openings = ((IfcSchema::IfcElement*) product)->HasOpenings()->size();
+			}
+			// Every opening results in a boolean operation on the complete shape
+			return cost * (1 + num_openings);
+		}
+
+		// The estimated cost by product id of the elements to be processed in
+		// decreasing order. Available after findContext(). When multiple
+		// threads are used the most expensive elements are scheduled first,
+		// unless PRESERVE_ORDER is set.
+		const std::vector<std::pair<int, double> >& cost_estimates() const {
+			return product_costs;
+		}
+
 	private:
-		// Move to the next IfcRepresentation
-		void _nextShape() {
-			ifcproducts.reset();
-			++ representation_iterator;
-			++ done;
+		double estimate_item_cost(const IfcUtil::IfcBaseClass* item, int depth) {
+			// Guard against cyclic or unreasonably deep mapped representations
+			if (!item || depth > 8) return 1.;
+			if (item->is(IfcSchema::Type::IfcManifoldSolidBrep)) {
+				return estimate_item_cost(((IfcSchema::IfcManifoldSolidBrep*) item)->Outer(), depth + 1);
+			} else if (item->is(IfcSchema::Type::IfcConnectedFaceSet)) {
+				return (double) ((IfcSchema::IfcConnectedFaceSet*) item)->CfsFaces()->size();
+			} else if (item->is(IfcSchema::Type::IfcShellBasedSurfaceModel)) {
+				double cost = 0.;
+				IfcEntityList::ptr shells = ((IfcSchema::IfcShellBasedSurfaceModel*) item)->SbsmBoundary();
+				for (IfcEntityList::it it = shells->begin(); it != shells->end(); ++it) {
+					cost += estimate_item_cost(*it, depth + 1);
+				}
+				return cost;
+			} else if (item->is(IfcSchema::Type::IfcFaceBasedSurfaceModel)) {
+				double cost = 0.;
+				IfcSchema::IfcConnectedFaceSet::list::ptr face_sets = ((IfcSchema::IfcFaceBasedSurfaceModel*) item)->FbsmFaces();
+				for (IfcSchema::IfcConnectedFaceSet::list::it it = face_sets->begin(); it != face_sets->end(); ++it) {
+					cost += estimate_item_cost(*it, depth + 1);
+				}
+				return cost;
+			} else if (item->is(IfcSchema::Type::IfcBooleanResult)) {
+				const IfcSchema::IfcBooleanResult* result = (IfcSchema::IfcBooleanResult*) item;
+				const double operands = estimate_item_cost(result->FirstOperand(), depth + 1) + estimate_item_cost(result->SecondOperand(), depth + 1);
+				// The boolean operation itself is more expensive than creating a simple operand
+				return 2. * operands;
+			} else if (item->is(IfcSchema::Type::IfcMappedItem)) {
+				double cost = 0.;
+				IfcSchema::IfcRepresentationItem::list::ptr items = ((IfcSchema::IfcMappedItem*) item)->MappingSource()->MappedRepresentation()->Items();
+				for (IfcSchema::IfcRepresentationItem::list::it it = items->begin(); it != items->end(); ++it) {
+					cost += estimate_item_cost(*it, depth + 1);
+				}
+				return cost;
+			}
+			return 1.;
 		}
 
-		BRepElement<P>* create_shape_model_for_next_entity() {
-			while ( true ) {
-				IfcSchema::IfcRepresentation* representation;
+		struct compare_job_cost {
+			const std::vector<job_t>& jobs;
+			compare_job_cost(const std::vector<job_t>& jobs) : jobs(jobs) {}
+			bool operator()(size_t a, size_t b) const {
+				return jobs[a].cost > jobs[b].cost;
+			}
+		};
+
+		struct compare_product_cost {
+			bool operator()(const std::pair<int, double>& a, const std::pair<int, double>& b) const {
+				return a.second > b.second;
+			}
+		};
+
+		// Returns the products that use the representation, filtered by the
+		// set of entities being included or excluded for processing.
+		IfcSchema::IfcProduct::list::ptr products_for_representation(IfcSchema::IfcRepresentation* representation) {
+			IfcSchema::IfcProductRepresentation::list::ptr prodreps = representation->OfProductRepresentation();
+			IfcSchema::IfcProduct::list::ptr products(new IfcSchema::IfcProduct::list);
+			IfcSchema::IfcProduct::list::ptr unfiltered_products(new IfcSchema::IfcProduct::list);
+
+			for ( IfcSchema::IfcProductRepresentation::list::it it = prodreps->begin(); it != prodreps->end(); ++it ) {
+				if ( (*it)->is(IfcSchema::Type::IfcProductDefinitionShape) ) {
+					IfcSchema::IfcProductDefinitionShape* pds = (IfcSchema::IfcProductDefinitionShape*)*it;
+					unfiltered_products->push(pds->ShapeOfProduct());
+				} else {
+					// http://buildingsmart-tech.org/ifc/IFC2x3/TC1/html/ifcrepresentationresource/lexical/ifcproductrepresentation.htm
+					// IFC2x Edition 3 NOTE  Users should not instantiate the entity IfcProductRepresentation from IFC2x Edition 3 onwards. 
+					// It will be changed into an ABSTRACT supertype in future releases of IFC.
 
-				// Have we reached the end of our list of representations?
-				if ( representation_iterator == representations->end() ) {
-					representations.reset();
-					return 0;
+					// IfcProductRepresentation also lacks the INVERSE relation to IfcProduct
+					// Let's find the IfcProducts that reference the IfcProductRepresentation anyway
+					unfiltered_products->push((*it)->entity->getInverse(IfcSchema::Type::IfcProduct, -1)->as<IfcSchema::IfcProduct>());
 				}
-				representation = *representation_iterator;
 
-				// Has the list of IfcProducts for this representation been initialized?
-				if (!ifcproducts) {
-					
-					IfcSchema::IfcProductRepresentation::list::ptr prodreps = representation->OfProductRepresentation();
-					ifcproducts = IfcSchema::IfcProduct::list::ptr(new IfcSchema::IfcProduct::list);
-					IfcSchema::IfcProduct::list::ptr unfiltered_products(new IfcSchema::IfcProduct::list);
-
-					for ( IfcSchema::IfcProductRepresentation::list::it it = prodreps->begin(); it != prodreps->end(); ++it ) {
-						if ( (*it)->is(IfcSchema::Type::IfcProductDefinitionShape) ) {
-							IfcSchema::IfcProductDefinitionShape* pds = (IfcSchema::IfcProductDefinitionShape*)*it;
-							unfiltered_products->push(pds->ShapeOfProduct());
-						} else {
-							// http://buildingsmart-tech.org/ifc/IFC2x3/TC1/html/ifcrepresentationresource/lexical/ifcproductrepresentation.htm
-							// IFC2x Edition 3 NOTE  Users should not instantiate the entity IfcProductRepresentation from IFC2x Edition 3 onwards. 
-							// It will be changed into an ABSTRACT supertype in future releases of IFC.
-
-							// IfcProductRepresentation also lacks the INVERSE relation to IfcProduct
-							// Let's find the IfcProducts that reference the IfcProductRepresentation anyway
-							unfiltered_products->push((*it)->entity->getInverse(IfcSchema::Type::IfcProduct, -1)->as<IfcSchema::IfcProduct>());
+				// Filter the products based on the set of entities being included or excluded for
+				// processing. The set is iterated over te able to filter on subtypes.
+				for ( IfcSchema::IfcProduct::list::it it = unfiltered_products->begin(); it != unfiltered_products->end(); ++it ) {
+					bool found = false;
+					for (std::set<IfcSchema::Type::Enum>::const_iterator jt = entities_to_include_or_exclude.begin(); jt != entities_to_include_or_exclude.end(); ++jt) {
+						if ((*it)->is(*jt)) {
+							found = true;
+							break;
 						}
+					}
+					if (found == include_entities_in_processing) {
+						products->push(*it);
+					}
+				}
+			}
 
-						// Filter the products based on the set of entities being included or excluded for
-						// processing. The set is iterated over te able to filter on subtypes.
-						for ( IfcSchema::IfcProduct::list::it it = unfiltered_products->begin(); it != unfiltered_products->end(); ++it ) {
-							bool found = false;
-							for (std::set<IfcSchema::Type::Enum>::const_iterator jt = entities_to_include_or_exclude.begin(); jt != entities_to_include_or_exclude.end(); ++jt) {
-								if ((*it)->is(*jt)) {
-									found = true;
-									break;
-								}
-							}
-							if (found == include_entities_in_processing) {
-								ifcproducts->push(*it);
-							}
-						}
+			return products;
+		}
+
+		// Creates the topological representation of the product, as an instance
+		// of an IfcRepresentationMap if possible and requested by the settings.
+		BRepElement<P>* create_shape_model(Kernel& k, IfcSchema::IfcRepresentation* representation, IfcSchema::IfcProduct* product) {
+			if (settings.instance_mapped_items()) {
+				BRepElement<P>* element = k.create_brep_for_mapped_item<P>(settings, representation, product);
+				if (element) {
+					if (!settings.apply_default_materials()) return element;
+					// Instances of other product types would be assigned a
+					// different default material and are therefore copied.
+					boost::mutex::scoped_lock lock(instance_mutex);
+					const std::string& type = instance_types.insert(std::make_pair(element->geometry().getId(), element->type())).first->second;
+					if (type == element->type()) return element;
+					delete element;
+				}
+			}
+			return k.create_brep_for_representation_and_product<P>(settings, representation, product);
+		}
+
+		// Returns whether the geometry of the product only depends on its
+		// representation, so that it can be reused for the other products of
+		// the representation. When default materials are applied these depend
+		// on the product type, in which case a product of another type
+		// discards the geometry of the previous products.
+		bool reuses_representation_geometry(Kernel& k, IfcSchema::IfcProduct* product, const BRepElement<P>& shape_model, representation_geometry_t& reused) {
+			if (shape_model.is_instance() || settings.use_world_coords()) {
+				return false;
+			}
+			if (!settings.disable_opening_subtractions()) {
+				IfcSchema::IfcRelVoidsElement::list::ptr openings = k.find_openings(product);
+				if (openings && openings->size()) {
+					return false;
+				}
+			}
+			if (settings.apply_default_materials() && reused.product_type != shape_model.type()) {
+				reused.reset();
+				reused.product_type = shape_model.type();
+			}
+			return true;
+		}
+
+		// Creates the triangulation or serialization of the shape model. For an
+		// instance the representation is shared with the other instances of
+		// the IfcRepresentationMap. It is created outside of the lock, in case
+		// of concurrent creation the representation created last is not shared.
+		// Otherwise, if reuse is set, the representation of a previous product
+		// is reused, or stored in reused if there is none yet.
+		template <typename T>
+		T* create_representation(const BRepElement<P>& shape_model, std::map<int, typename T::geometry_ptr>& instances, typename T::geometry_ptr& reused, bool reuse) {
+			if (!shape_model.is_instance()) {
+				if (!reuse) {
+					return new T(shape_model);
+				}
+				if (reused && reused->id() == (int) shape_model.geometry().getId()) {
+					return new T(shape_model, reused);
+				}
+				T* element = new T(shape_model);
+				reused = element->geometry_pointer();
+				return element;
+			}
+			const int map_id = shape_model.geometry().getId();
+			{
+				boost::mutex::scoped_lock lock(instance_mutex);
+				typename std::map<int, typename T::geometry_ptr>::const_iterator it = instances.find(map_id);
+				if (it != instances.end()) {
+					return new T(shape_model, it->second);
+				}
+			}
+			T* element = new T(shape_model);
+			boost::mutex::scoped_lock lock(instance_mutex);
+			instances.insert(std::make_pair(map_id, element->geometry_pointer()));
+			return element;
+		}
+
+		// Creates the topological representation of the product and, depending
+		// on the settings, its serialization or triangulation. Returns false
+		// if any of the steps fails, in which case nothing is allocated.
+		bool create_element(Kernel& k, IfcSchema::IfcRepresentation* representation, IfcSchema::IfcProduct* product, representation_geometry_t& reused, result_t& result) {
+			result.shape_model = 0;
+			result.triangulation = 0;
+			result.serialization = 0;
+			try {
+				result.shape_model = create_shape_model(k, representation, product);
+			} catch (...) {}
+			if (!result.shape_model) return false;
+			try {
+				if (settings.use_brep_data()) {
+					const bool reuse = reuses_representation_geometry(k, product, *result.shape_model, reused);
+					result.serialization = create_representation< SerializedElement<P> >(*result.shape_model, instance_serializations, reused.serialization, reuse);
+				} else if (!settings.disable_triangulation()) {
+					const bool reuse = reuses_representation_geometry(k, product, *result.shape_model, reused);
+					result.triangulation = create_representation< TriangulationElement<P> >(*result.shape_model, instance_triangulations, reused.triangulation, reuse);
+				} else {
+					return true;
+				}
+			} catch (...) {}
+			if (result.serialization || result.triangulation) return true;
+			delete result.shape_model;
+			result.shape_model = 0;
+			return false;
+		}
+
+		// Gathers the products of every representation and estimates their
+		// cost. Representations without products are omitted.
+		bool gather_jobs() {
+			for (IfcSchema::IfcRepresentation::list::it it = representations->begin(); it != representations->end(); ++it) {
+				job_t job;
+				job.representation = *it;
+				job.cost = 0.;
+				try {
+					job.products = products_for_representation(*it);
+				} catch (...) {
+					continue;
+				}
+				if (!job.products->size()) {
+					continue;
+				}
+				for (IfcSchema::IfcProduct::list::it jt = job.products->begin(); jt != job.products->end(); ++jt) {
+					double cost = 1.;
+					try {
+						cost = estimate_cost(*it, *jt);
+					} catch (...) {}
+					job.cost += cost;
+					product_costs.push_back(std::make_pair((*jt)->entity->id(), cost));
+				}
+				jobs.push_back(job);
+			}
+			representations.reset();
 
+			if (jobs.empty()) return false;
+
+			std::stable_sort(product_costs.begin(), product_costs.end(), compare_product_cost());
+			for (size_t i = 0; i < product_costs.size() && i < 10; ++i) {
+				std::stringstream ss;
+				ss << "Estimated cost of #" << product_costs[i].first << ": " << product_costs[i].second;
+				Logger::Message(Logger::LOG_NOTICE, ss.str());
+			}
+
+			return true;
+		}
+
+		bool start_workers(int num_threads) {
+			// Hand out the most expensive jobs first, so that a few long running
+			// jobs do not end up being processed last. When the order is to be
+			// preserved the jobs are processed in order, as the consumer would
+			// otherwise have to wait for the jobs that are scheduled last.
+			for (size_t i = 0; i < jobs.size(); ++i) {
+				schedule.push_back(i);
+			}
+			if (!settings.preserve_order()) {
+				std::stable_sort(schedule.begin(), schedule.end(), compare_job_cost(jobs));
+			}
+
+			// The elements are already created in parallel, meshing their faces
+			// in parallel as well would only oversubscribe the processors.
+			settings.parallel_triangulation() = false;
+
+			jobs_taken = jobs_consumed = 0;
+			queue_capacity = (std::max)((size_t) 64, (size_t) num_threads * 8);
+
+			shared_cache = new SharedCache;
+			shared_cache->shape_budget(shape_cache_budget());
+			for (int i = 0; i < num_threads; ++i) {
+				Kernel* k = new Kernel;
+				k->set_shared_cache(shared_cache);
+				for (int v = Kernel::GV_DEFLECTION_TOLERANCE; v <= Kernel::GV_PRISMATIC_OPENINGS; ++v) {
+					k->setValue((Kernel::GeomValue) v, kernel.getValue((Kernel::GeomValue) v));
+				}
+				worker_kernels.push_back(k);
+			}
+
+			// Resolve the placement tree up front, so that the workers do not
+			// convert the placements of shared parents such as storeys again.
+			Kernel::resolve_placements(ifc_file->entitiesByType<IfcSchema::IfcLocalPlacement>(), worker_kernels);
+
+			// Read the arguments of all instances up front as well, so that
+			// the workers access them without locking the lexer.
+			ifc_file->load_arguments();
+
+			for (std::vector<Kernel*>::const_iterator it = worker_kernels.begin(); it != worker_kernels.end(); ++it) {
+				workers.create_thread(boost::bind(&Iterator<P>::process_jobs, this, *it));
+			}
+
+			return next_parallel();
+		}
+
+		// The body of a worker thread: takes the next unprocessed job as long
+		// as the number of unconsumed jobs does not exceed the queue capacity.
+		void process_jobs(Kernel* k) {
+			for (;;) {
+				size_t index;
+				{
+					boost::mutex::scoped_lock lock(queue_mutex);
+					while (!cancelled && jobs_taken < jobs.size() && jobs_taken - jobs_consumed >= queue_capacity) {
+						queue_changed.wait(lock);
 					}
-					// Does this representation have any IfcProducts?
-					if (!ifcproducts->size()) {
-						_nextShape();
-						continue;
+					if (cancelled || jobs_taken == jobs.size()) return;
+					index = schedule[jobs_taken ++];
+				}
+
+				const job_t& job = jobs[index];
+				results_t results;
+				representation_geometry_t reused;
+				for (IfcSchema::IfcProduct::list::it it = job.products->begin(); it != job.products->end(); ++it) {
+					result_t result;
+					if (create_element(*k, job.representation, *it, reused, result)) {
+						results.push_back(result);
 					}
-					ifcproduct_iterator = ifcproducts->begin();
 				}
-				// Have we reached the end of our list of IfcProducts?
-				if ( ifcproduct_iterator == ifcproducts->end() ) {
-					_nextShape();
-					continue;
+
+				{
+					boost::mutex::scoped_lock lock(queue_mutex);
+					finished_jobs[index].swap(results);
 				}
+				queue_changed.notify_all();
+			}
+		}
 
-				IfcSchema::IfcProduct* product = *ifcproduct_iterator;
+		bool next_parallel() {
+			if (++current_result_index < current_results.size()) {
+				const result_t& result = current_results[current_result_index];
+				current_shape_model = result.shape_model;
+				current_triangulation = result.triangulation;
+				current_serialization = result.serialization;
+				return true;
+			}
+			for (;;) {
+				{
+					boost::mutex::scoped_lock lock(queue_mutex);
+					typename std::map<size_t, results_t>::iterator it;
+					for (;;) {
+						if (jobs_consumed == jobs.size()) return false;
+						it = settings.preserve_order() ? finished_jobs.find(jobs_consumed) : finished_jobs.begin();
+						if (it != finished_jobs.end()) break;
+						queue_changed.wait(lock);
+					}
+					current_results.swap(it->second);
+					finished_jobs.erase(it);
+					++ jobs_consumed;
+					++ done;
+				}
+				queue_changed.notify_all();
 
-				BRepElement<P>* element = kernel.create_brep_for_representation_and_product<P>(settings, representation, product);
+				if (!current_results.empty()) {
+					current_result_index = (size_t) -1;
+					return next_parallel();
+				}
+			}
+		}
 
-				if ( !element ) {
-					_nextShape();
-					continue;
+		void stop_workers() {
+			{
+				boost::mutex::scoped_lock lock(queue_mutex);
+				cancelled = true;
+			}
+			queue_changed.notify_all();
+			workers.join_all();
+
+			for (typename std::map<size_t, results_t>::iterator it = finished_jobs.begin(); it != finished_jobs.end(); ++it) {
+				for (typename results_t::iterator jt = it->second.begin(); jt != it->second.end(); ++jt) {
+					delete jt->triangulation;
+					delete jt->serialization;
+					delete jt->shape_model;
 				}
+			}
+			finished_jobs.clear();
+			// The elements before current_result_index have been freed by next()
+			for (size_t i = current_result_index + 1; i < current_results.size(); ++i) {
+				delete current_results[i].triangulation;
+				delete current_results[i].serialization;
+				delete current_results[i].shape_model;
+			}
+			current_results.clear();
 
-				return element;
-			}	
+			for (std::vector<Kernel*>::const_iterator it = worker_kernels.begin(); it != worker_kernels.end(); ++it) {
+				delete *it;
+			}
+			worker_kernels.clear();
+
+			// Elements keep copies of their styles, so the shared cache can be freed
+			delete shared_cache;
+			shared_cache = 0;
+		}
+
+		// Move to the next job
+		void _nextShape() {
+			representation_geometry.reset();
+			++ current_job;
+			++ done;
+			if (current_job < jobs.size()) {
+				ifcproduct_iterator = jobs[current_job].products->begin();
+			}
+		}
+
+		// Advances to the next product of the current job, or to the first
+		// product of the next job. Returns false when all jobs have been
+		// processed.
+		bool find_next_product() {
+			while (current_job < jobs.size()) {
+				if (ifcproduct_iterator != jobs[current_job].products->end()) {
+					return true;
+				}
+				_nextShape();
+			}
+			return false;
 		}
 
 		public:
@@ -359,14 +789,22 @@ namespace IfcGeom {
 			current_serialization = 0;
 			delete current_shape_model;
 			current_shape_model = 0;
+
+			if (parallel()) {
+				if (next_parallel()) return true;
+				log_cache_statistics();
+				return false;
+			}
 			
 			// Increment the iterator over the list of products using the current
 			// shape representation
-			if (ifcproducts) {
+			if (current_job < jobs.size()) {
 				++ifcproduct_iterator;
 			}
 
-			return create();
+			if (create()) return true;
+			log_cache_statistics();
+			return false;
 		}
 
 		Element<P>* get() {
@@ -381,7 +819,9 @@ namespace IfcGeom {
 
 			gp_Trsf trsf;
 			int parent_id = -1;
-			std::string instance_type, product_name, product_guid;
+			std::string instance_type, name_copy, guid_copy;
+			const std::string* product_name = &name_copy;
+			const std::string* product_guid = &guid_copy;
 			
 			try {
 				const IfcUtil::IfcBaseClass* ifc_entity = ifc_file->entityById(id);
@@ -389,8 +829,13 @@ namespace IfcGeom {
 				if ( ifc_entity->is(IfcSchema::Type::IfcProduct) ) {
 					IfcSchema::IfcProduct* ifc_product = (IfcSchema::IfcProduct*)ifc_entity;
 					
-					product_guid = ifc_product->GlobalId();
-					product_name = ifc_product->hasName() ? ifc_product->Name() : "";
+					// GlobalId and Name are the first and third attribute of
+					// IfcRoot, which are referred to in the string pool of the
+					// file when strings are interned
+					product_guid = &IfcParse::stringValue(ifc_product->entity->getArgument(0), guid_copy);
+					if (ifc_product->hasName()) {
+						product_name = &IfcParse::stringValue(ifc_product->entity->getArgument(2), name_copy);
+					}
 					
 					parent_id = -1;
 					try {
@@ -407,28 +852,24 @@ namespace IfcGeom {
 			} catch(...) {}
 
 			ElementSettings element_settings(settings, unit_magnitude, instance_type);
-			Element<P>* ifc_object = new Element<P>(element_settings, id, parent_id, product_name, instance_type, product_guid, trsf);
+			Element<P>* ifc_object = new Element<P>(element_settings, id, parent_id, *product_name, instance_type, *product_guid, trsf);
 			
 			return ifc_object;
 		}
 
+		// Creates the element for the current or next product. As in parallel
+		// mode, products for which no element can be created are skipped.
 		bool create() {
-			try {
-				current_shape_model = create_shape_model_for_next_entity();
-			} catch (...) {}
-			if (!current_shape_model) return false;
-			if (settings.use_brep_data()) {
-				try {
-					current_serialization = new SerializedElement<P>(*current_shape_model);
-				} catch (...) {}
-				return !!current_serialization;
-			} else if (!settings.disable_triangulation()) {
-				try {
-					current_triangulation = new TriangulationElement<P>(*current_shape_model);
-				} catch (...) {}
-				return !!current_triangulation;
-			} else {
-				return true;
+			for (;;) {
+				if (!find_next_product()) return false;
+				result_t result;
+				if (create_element(kernel, jobs[current_job].representation, *ifcproduct_iterator, representation_geometry, result)) {
+					current_shape_model = result.shape_model;
+					current_triangulation = result.triangulation;
+					current_serialization = result.serialization;
+					return true;
+				}
+				++ifcproduct_iterator;
 			}
 		}
 	private:
@@ -440,12 +881,59 @@ namespace IfcGeom {
 			// Upon initialisation, the (empty) set of entity names,
 			// should be excluded, or no products would be processed.
 			include_entities_in_processing = false;
+
+			current_job = 0;
+			jobs_taken = jobs_consumed = 0;
+			queue_capacity = 0;
+			cancelled = false;
+			shared_cache = 0;
+			current_result_index = 0;
 		
 			unit_name = "METER";
 			unit_magnitude = 1.f;
 
 			kernel.setValue(IfcGeom::Kernel::GV_MAX_FACES_TO_SEW, settings.sew_shells() ? 1000 : -1);
 			kernel.setValue(IfcGeom::Kernel::GV_FORCE_CCW_FACE_ORIENTATION, settings.force_ccw_face_orientation() ? 1 : -1);
+			kernel.setValue(IfcGeom::Kernel::GV_VALIDATION_POLICY, settings.validation_policy());
+			kernel.setValue(IfcGeom::Kernel::GV_VOLUME_DIAGNOSTICS, settings.volume_diagnostics() ? 1 : -1);
+			kernel.setValue(IfcGeom::Kernel::GV_PRISMATIC_OPENINGS, settings.prismatic_openings() ? 1 : -1);
+			kernel.shape_cache().budget(shape_cache_budget());
+		}
+
+		size_t shape_cache_budget() const {
+			return settings.shape_cache_budget() > 0 ? (size_t) settings.shape_cache_budget() * 1024 * 1024 : 0;
+		}
+
+		void log_cache_statistics() {
+			unsigned long hits, misses, evictions;
+			size_t pinned_bytes;
+			if (shared_cache) {
+				hits = shared_cache->shape_hits();
+				misses = shared_cache->shape_misses();
+				evictions = shared_cache->shape_evictions();
+				pinned_bytes = shared_cache->shape_pinned_size_in_bytes();
+			} else {
+				hits = kernel.shape_cache().hits();
+				misses = kernel.shape_cache().misses();
+				evictions = kernel.shape_cache().evictions();
+				pinned_bytes = kernel.shape_cache().pinned_size_in_bytes();
+			}
+			// Pinned shapes are not bounded by the budget
+			std::stringstream ss;
+			ss << "Shape cache: " << hits << " hits, " << misses << " misses, " << evictions << " evictions, "
+				<< (pinned_bytes / 1024) << " KiB pinned";
+			Logger::Message(Logger::LOG_NOTICE, ss.str());
+
+			// Profiles are cached by every kernel individually
+			unsigned long profile_hits = kernel.profile_cache_hits();
+			unsigned long profile_misses = kernel.profile_cache_misses();
+			for (std::vector<Kernel*>::const_iterator it = worker_kernels.begin(); it != worker_kernels.end(); ++it) {
+				profile_hits += (*it)->profile_cache_hits();
+				profile_misses += (*it)->profile_cache_misses();
+			}
+			std::stringstream ss2;
+			ss2 << "Profile cache: " << profile_hits << " hits, " << profile_misses << " misses";
+			Logger::Message(Logger::LOG_NOTICE, ss2.str());
 		}
 	public:
 		Iterator(const IteratorSettings& settings, IfcParse::IfcFile* file)
@@ -477,6 +965,11 @@ namespace IfcGeom {
 		}
 
 		~Iterator() {
+			// The worker threads need to be joined before the file is freed
+			if (parallel()) {
+				stop_workers();
+			}
+
 			// TODO: Correctly implement destructor for IfcFile
 			delete ifc_file;
 
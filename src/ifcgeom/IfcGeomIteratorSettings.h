@@ -21,6 +21,7 @@
 #define IFCGEOMITERATORSETTINGS_H
 
 #include <string>
+#include <vector>
 
 #include "../ifcparse/IfcException.h"
 
@@ -66,12 +67,59 @@ namespace IfcGeom {
 		static const int DISABLE_TRIANGULATION = 9;
 		// Applies default materials to entity instances without a surface style.
 		static const int APPLY_DEFAULT_MATERIALS = 10;
+		// When geometry is created by multiple threads, elements are returned
+		// in the order in which they are finished. Set this to true to obtain
+		// elements in the same order as when a single thread is used.
+		static const int PRESERVE_ORDER = 11;
+		// Representations that consist of a single IfcMappedItem are created
+		// in the coordinate system of the IfcRepresentationMap and triangulated
+		// only once. The mapping is applied to the matrix of the elements, which
+		// share the triangulation, whose id is that of the IfcRepresentationMap.
+		// Elements with openings are not instanced.
+		static const int INSTANCE_MAPPED_ITEMS = 12;
+		// Meshes the faces of a single shape in parallel and collects the
+		// vertices and indices of large shapes using a pool of threads that is
+		// shared by all shapes. The resulting triangulation is identical to the
+		// one obtained serially. Ignored when elements are already created by
+		// multiple threads, see num_threads(). As with num_threads(), Open
+		// Cascade needs a thread-safe memory manager, e.g. MMGT_REENTRANT=1.
+		static const int PARALLEL_TRIANGULATION = 13;
+		// Triangulates extrusions of polygonal profiles directly from the
+		// profile and the extrusion vector, rather than to create and mesh their
+		// topology. Only applies when triangulating, i.e. when USE_BREP_DATA and
+		// DISABLE_TRIANGULATION are off, and to elements of which no openings
+		// are subtracted. The shapes of such representation items are null.
+		static const int DIRECT_EXTRUSION_MESHES = 14;
+		// Triangulates the planar faces of an IfcFacetedBrep or a surface model
+		// bounded by IfcPolyLoops directly, rather than to sew them into a shell
+		// and mesh it. Applies under the same conditions as DIRECT_EXTRUSION_MESHES.
+		static const int DIRECT_FACE_SET_MESHES = 15;
+		// Computes the volumes of the operands and results of subtractions to
+		// log empty operands and subtractions that leave the volume unchanged.
+		// Without it, volumes are only computed to explain failed subtractions.
+		static const int VOLUME_DIAGNOSTICS = 16;
+		// Subtracts openings that cut through an extruded shape along its
+		// direction from the profile of the shape, which is then extruded
+		// anew, rather than by a boolean operation. Only applies to openings
+		// of which the profile lies strictly within that of the shape, others
+		// are subtracted by boolean operations as usual.
+		static const int PRISMATIC_OPENINGS = 17;
 
 		// End of settings enumeration.
 
+		// How thoroughly the results of boolean operations and sewing are
+		// validated. VALIDATION_FULL heals and analyses every result,
+		// VALIDATION_CHEAP only does so for results that fail a bounding box
+		// and topology check, VALIDATION_NONE accepts any result that is not null.
+		enum ValidationPolicy { VALIDATION_FULL, VALIDATION_CHEAP, VALIDATION_NONE };
+
 	private:
-		bool _weld_vertices, _use_world_coords, _convert_back_units, _use_brep_data, _sew_shells, _faster_booleans, _force_ccw_face_orientation, _disable_opening_subtractions, _disable_triangulation, _apply_default_materials;
+		bool _weld_vertices, _use_world_coords, _convert_back_units, _use_brep_data, _sew_shells, _faster_booleans, _force_ccw_face_orientation, _disable_opening_subtractions, _disable_triangulation, _apply_default_materials, _preserve_order, _instance_mapped_items, _parallel_triangulation, _direct_extrusion_meshes, _direct_face_set_meshes, _volume_diagnostics, _prismatic_openings;
 		double _deflection_tolerance;
+		std::vector<double> _lod_deflection_tolerances;
+		int _num_threads;
+		int _shape_cache_budget;
+		int _validation_policy;
 	public:
 		IteratorSettings()
 			: _weld_vertices(true)
@@ -84,9 +132,19 @@ namespace IfcGeom {
 			, _disable_opening_subtractions(false)
 			, _disable_triangulation(false)
 			, _apply_default_materials(false)
+			, _preserve_order(false)
+			, _instance_mapped_items(false)
+			, _parallel_triangulation(false)
+			, _direct_extrusion_meshes(false)
+			, _direct_face_set_meshes(false)
+			, _volume_diagnostics(false)
+			, _prismatic_openings(false)
 			// TODO: Make deflection tolerance into a command line argument
 			// For now, stick to one millimeter. Note that this is independent of the IFC length unit.
 			, _deflection_tolerance(1.e-3)
+			, _num_threads(1)
+			, _shape_cache_budget(0)
+			, _validation_policy(VALIDATION_FULL)
 		{}
 
 		const bool& weld_vertices() const { return _weld_vertices; }
@@ -109,9 +167,50 @@ namespace IfcGeom {
 		bool& disable_triangulation() { return _disable_triangulation; }
 		const bool& apply_default_materials() const { return _apply_default_materials; }
 		bool& apply_default_materials() { return _apply_default_materials; }
+		const bool& preserve_order() const { return _preserve_order; }
+		bool& preserve_order() { return _preserve_order; }
+		const bool& instance_mapped_items() const { return _instance_mapped_items; }
+		bool& instance_mapped_items() { return _instance_mapped_items; }
+		const bool& parallel_triangulation() const { return _parallel_triangulation; }
+		bool& parallel_triangulation() { return _parallel_triangulation; }
+		const bool& direct_extrusion_meshes() const { return _direct_extrusion_meshes; }
+		bool& direct_extrusion_meshes() { return _direct_extrusion_meshes; }
+		const bool& direct_face_set_meshes() const { return _direct_face_set_meshes; }
+		bool& direct_face_set_meshes() { return _direct_face_set_meshes; }
+		const bool& volume_diagnostics() const { return _volume_diagnostics; }
+		bool& volume_diagnostics() { return _volume_diagnostics; }
+		const bool& prismatic_openings() const { return _prismatic_openings; }
+		bool& prismatic_openings() { return _prismatic_openings; }
 		
 		const double& deflection_tolerance() const { return _deflection_tolerance; }
 		double& deflection_tolerance() { return _deflection_tolerance; }
+
+		// Additional deflection tolerances, typically larger than the one above,
+		// at which the shapes of an element are triangulated as lower levels of
+		// detail. The levels are computed from the same shapes, so that these
+		// are only converted once, and are available from the triangulation
+		// in the order specified here.
+		const std::vector<double>& lod_deflection_tolerances() const { return _lod_deflection_tolerances; }
+		std::vector<double>& lod_deflection_tolerances() { return _lod_deflection_tolerances; }
+
+		// The number of threads used by IfcGeom::Iterator to create geometry. A
+		// value of zero or less uses the number of hardware threads available.
+		// Note that Open Cascade needs to be configured with a thread-safe memory
+		// manager for this to work reliably, e.g. by setting MMGT_REENTRANT=1.
+		const int& num_threads() const { return _num_threads; }
+		int& num_threads() { return _num_threads; }
+
+		// The approximate amount of memory in megabytes that converted shapes
+		// are allowed to occupy in the cache of the kernel before the least
+		// recently used ones are evicted. A value of zero or less means that
+		// shapes are cached for the lifetime of the iterator. The items of
+		// mapped representations are always kept and not counted.
+		const int& shape_cache_budget() const { return _shape_cache_budget; }
+		int& shape_cache_budget() { return _shape_cache_budget; }
+
+		// One of the values of ValidationPolicy
+		const int& validation_policy() const { return _validation_policy; }
+		int& validation_policy() { return _validation_policy; }
 		
 		void set(int setting, bool value) {
 			switch (setting) {
@@ -145,6 +244,27 @@ namespace IfcGeom {
 			case APPLY_DEFAULT_MATERIALS:
 				_apply_default_materials = value;
 				break;
+			case PRESERVE_ORDER:
+				_preserve_order = value;
+				break;
+			case INSTANCE_MAPPED_ITEMS:
+				_instance_mapped_items = value;
+				break;
+			case PARALLEL_TRIANGULATION:
+				_parallel_triangulation = value;
+				break;
+			case DIRECT_EXTRUSION_MESHES:
+				_direct_extrusion_meshes = value;
+				break;
+			case DIRECT_FACE_SET_MESHES:
+				_direct_face_set_meshes = value;
+				break;
+			case VOLUME_DIAGNOSTICS:
+				_volume_diagnostics = value;
+				break;
+			case PRISMATIC_OPENINGS:
+				_prismatic_openings = value;
+				break;
 			default: throw IfcParse::IfcException("Invalid IteratorSetting");
 			}
 		}
@@ -21,14 +21,14 @@
 
 static double black[3] = {0.,0.,0.};
 
-IfcGeom::Material::Material(const IfcGeom::SurfaceStyle* style) : style(style) {}
-bool IfcGeom::Material::hasDiffuse() const { return style->Diffuse() ? true : false; }
-bool IfcGeom::Material::hasSpecular() const { return style->Specular() ? true : false; }
-bool IfcGeom::Material::hasTransparency() const { return style->Transparency() ? true : false; }
-bool IfcGeom::Material::hasSpecularity() const { return style->Specularity() ? true : false; }
-const double* IfcGeom::Material::diffuse() const { if (hasDiffuse()) return &((*style->Diffuse()).R()); else return black; }
-const double* IfcGeom::Material::specular() const { if (hasSpecular()) return &((*style->Specular()).R()); else return black; }
-double IfcGeom::Material::transparency() const { if (hasTransparency()) return *style->Transparency(); else return 0; }
-double IfcGeom::Material::specularity() const { if (hasSpecularity()) return *style->Specularity(); else return 0; }
-const std::string IfcGeom::Material::name() const { return style->Name(); }
+IfcGeom::Material::Material(const IfcGeom::SurfaceStyle* style) { if (style) this->style = *style; }
+bool IfcGeom::Material::hasDiffuse() const { return style.Diffuse() ? true : false; }
+bool IfcGeom::Material::hasSpecular() const { return style.Specular() ? true : false; }
+bool IfcGeom::Material::hasTransparency() const { return style.Transparency() ? true : false; }
+bool IfcGeom::Material::hasSpecularity() const { return style.Specularity() ? true : false; }
+const double* IfcGeom::Material::diffuse() const { if (hasDiffuse()) return &((*style.Diffuse()).R()); else return black; }
+const double* IfcGeom::Material::specular() const { if (hasSpecular()) return &((*style.Specular()).R()); else return black; }
+double IfcGeom::Material::transparency() const { if (hasTransparency()) return *style.Transparency(); else return 0; }
+double IfcGeom::Material::specularity() const { if (hasSpecularity()) return *style.Specularity(); else return 0; }
+const std::string IfcGeom::Material::name() const { return style.Name(); }
 bool IfcGeom::Material::operator==(const IfcGeom::Material& other) const { return style == other.style; }
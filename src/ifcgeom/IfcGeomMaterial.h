@@ -28,7 +28,9 @@ namespace IfcGeom {
 
 	class Material {
 	private:
-		const IfcGeom::SurfaceStyle* style;
+		// A copy of the style, as the caches that own the styles can be
+		// freed while the elements that use them are still referenced
+		IfcGeom::SurfaceStyle style;
 	public:
 		explicit Material(const IfcGeom::SurfaceStyle* style = 0); // TODO default constructor for vector?
 		// Material(const Material& other);
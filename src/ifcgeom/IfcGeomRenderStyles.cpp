@@ -19,6 +19,8 @@
 
 #include <map>
 
+#include <boost/thread/mutex.hpp>
+
 #include "IfcGeom.h"
 
 bool process_colour(IfcSchema::IfcColourRgb* colour, std::tr1::array<double, 3>& rgb) {
@@ -60,6 +62,10 @@ const IfcGeom::SurfaceStyle* IfcGeom::Kernel::get_style(const IfcSchema::IfcRepr
 	if (it != cache.Style.end()) {
 		return &(it->second);
 	}
+	if (shared_cache) {
+		const SurfaceStyle* shared_style = shared_cache->find_style(surface_style_id);
+		if (shared_style) return shared_style;
+	}
 	SurfaceStyle surface_style;
 	if (shading_styles.first->hasName()) {
 		surface_style = SurfaceStyle(surface_style_id, shading_styles.first->Name());
@@ -104,12 +110,18 @@ const IfcGeom::SurfaceStyle* IfcGeom::Kernel::get_style(const IfcSchema::IfcRepr
 			surface_style.Transparency().reset(d);
 		}
 	}
+	if (shared_cache) {
+		return shared_cache->insert_style(surface_style_id, surface_style);
+	}
 	return &(cache.Style[surface_style_id] = surface_style);
 }
 
 static std::map<std::string, IfcGeom::SurfaceStyle> default_materials;
 static IfcGeom::SurfaceStyle default_material;
 static bool default_materials_initialized = false;
+// Guards the lazily populated map of default materials, styles are
+// requested by several kernels at once when geometry is created in parallel
+static boost::mutex default_materials_mutex;
 
 void InitDefaultMaterials() {
 	default_materials.insert(std::make_pair("IfcSite", IfcGeom::SurfaceStyle("IfcSite")));
@@ -150,6 +162,7 @@ void InitDefaultMaterials() {
 }
 
 const IfcGeom::SurfaceStyle* IfcGeom::get_default_style(const std::string& s) {
+	boost::mutex::scoped_lock lock(default_materials_mutex);
 	if (!default_materials_initialized) InitDefaultMaterials();
 	std::map<std::string, IfcGeom::SurfaceStyle>::const_iterator it = default_materials.find(s);
 	if (it == default_materials.end()) {
@@ -71,11 +71,9 @@ namespace IfcGeom {
 			this->name = sstr.str(); 
 		}
 		
-		// Not used at this point. In fact, equality testing in the current
-		// architecture can just as easily be accomplished by comparing the
-		// pointer addresses of the styles, as they are always referenced 
-		// from out of a global map of some sort.
-		bool operator==(const SurfaceStyle& other) {
+		// Used to compare the copies of the styles held by materials. The
+		// names include the instance id, if any, and are therefore unique.
+		bool operator==(const SurfaceStyle& other) const {
 			if (name && other.name) {
 				return *name == *other.name;
 			} else if (id && other.id) {
@@ -17,17 +17,234 @@
  *                                                                              *
  ********************************************************************************/
 
+#include <limits>
+#include <algorithm>
+
+#include <gp.hxx>
+#include <gp_Ax3.hxx>
+
 #include <BRep_Tool.hxx>
 #include <BRepTools.hxx>
 #include <BRep_Builder.hxx>
+#include <BRepTools_WireExplorer.hxx>
+#include <BRepAdaptor_Curve.hxx>
+#include <BRepAdaptor_Surface.hxx>
 
+#include <TopoDS.hxx>
+#include <TopoDS_Wire.hxx>
 #include <TopoDS_Compound.hxx>
+#include <TopExp_Explorer.hxx>
 #include <BRepBuilderAPI_GTransform.hxx>
 
 #include "../ifcgeom/IfcGeom.h"
 
 #include "IfcGeomRepresentation.h"
 
+namespace {
+
+	struct PolygonVertex {
+		double u, v;
+		int index;
+	};
+
+	typedef std::vector<PolygonVertex> Polygon;
+
+	inline double cross(const PolygonVertex& a, const PolygonVertex& b, const PolygonVertex& c) {
+		return (b.u - a.u) * (c.v - a.v) - (b.v - a.v) * (c.u - a.u);
+	}
+
+	inline bool coincident(const PolygonVertex& a, const PolygonVertex& b) {
+		return a.u == b.u && a.v == b.v;
+	}
+
+	double signed_area(const Polygon& polygon) {
+		double area = 0.;
+		for (size_t i = 0, j = polygon.size() - 1; i < polygon.size(); j = i++) {
+			area += polygon[j].u * polygon[i].v - polygon[i].u * polygon[j].v;
+		}
+		return area / 2.;
+	}
+
+	// Whether the segments properly intersect, segments that merely share
+	// an end point are not considered to intersect
+	bool segments_intersect(const PolygonVertex& p1, const PolygonVertex& p2, const PolygonVertex& q1, const PolygonVertex& q2) {
+		if (coincident(p1, q1) || coincident(p1, q2) || coincident(p2, q1) || coincident(p2, q2)) return false;
+		const double d1 = cross(q1, q2, p1);
+		const double d2 = cross(q1, q2, p2);
+		const double d3 = cross(p1, p2, q1);
+		const double d4 = cross(p1, p2, q2);
+		if (((d1 > 0 && d2 < 0) || (d1 < 0 && d2 > 0)) && ((d3 > 0 && d4 < 0) || (d3 < 0 && d4 > 0))) return true;
+		// Collinear overlap, a point of one segment lies on the other
+		if (d1 == 0 && d2 == 0) {
+			const double min_pu = (std::min)(p1.u, p2.u), max_pu = (std::max)(p1.u, p2.u);
+			const double min_pv = (std::min)(p1.v, p2.v), max_pv = (std::max)(p1.v, p2.v);
+			const double min_qu = (std::min)(q1.u, q2.u), max_qu = (std::max)(q1.u, q2.u);
+			const double min_qv = (std::min)(q1.v, q2.v), max_qv = (std::max)(q1.v, q2.v);
+			return min_pu <= max_qu && min_qu <= max_pu && min_pv <= max_qv && min_qv <= max_pv;
+		}
+		return false;
+	}
+
+	bool crosses_polygon(const PolygonVertex& a, const PolygonVertex& b, const Polygon& polygon) {
+		for (size_t i = 0, j = polygon.size() - 1; i < polygon.size(); j = i++) {
+			if (segments_intersect(a, b, polygon[j], polygon[i])) return true;
+		}
+		return false;
+	}
+
+	bool has_greater_u(const Polygon& a, const Polygon& b) {
+		double max_a = -std::numeric_limits<double>::infinity(), max_b = max_a;
+		for (Polygon::const_iterator it = a.begin(); it != a.end(); ++it) max_a = (std::max)(max_a, it->u);
+		for (Polygon::const_iterator it = b.begin(); it != b.end(); ++it) max_b = (std::max)(max_b, it->u);
+		return max_a > max_b;
+	}
+
+	struct closer_to {
+		const PolygonVertex& p;
+		closer_to(const PolygonVertex& p) : p(p) {}
+		double distance(const PolygonVertex& q) const {
+			return (q.u - p.u) * (q.u - p.u) + (q.v - p.v) * (q.v - p.v);
+		}
+		bool operator()(const std::pair<size_t, PolygonVertex>& a, const std::pair<size_t, PolygonVertex>& b) const {
+			return distance(a.second) < distance(b.second);
+		}
+	};
+
+	// Joins the holes, which are oriented clockwise, to the counter-clockwise
+	// outer boundary by a pair of coincident edges to a visible vertex. Holes
+	// are processed from right to left, starting at their rightmost vertex.
+	bool bridge_holes(Polygon& outer, std::vector<Polygon>& holes) {
+		std::sort(holes.begin(), holes.end(), has_greater_u);
+		for (size_t h = 0; h < holes.size(); ++h) {
+			const Polygon& hole = holes[h];
+			size_t m = 0;
+			for (size_t i = 1; i < hole.size(); ++i) {
+				if (hole[i].u > hole[m].u) m = i;
+			}
+			std::vector< std::pair<size_t, PolygonVertex> > candidates;
+			candidates.reserve(outer.size());
+			for (size_t i = 0; i < outer.size(); ++i) {
+				candidates.push_back(std::make_pair(i, outer[i]));
+			}
+			std::sort(candidates.begin(), candidates.end(), closer_to(hole[m]));
+			
+			size_t bridge = outer.size();
+			for (std::vector< std::pair<size_t, PolygonVertex> >::const_iterator it = candidates.begin(); it != candidates.end(); ++it) {
+				const PolygonVertex& p = it->second;
+				// The bridge needs to run through the interior of the polygon at
+				// its end on the outer boundary
+				const PolygonVertex& prev = outer[(it->first + outer.size() - 1) % outer.size()];
+				const PolygonVertex& next = outer[(it->first + 1) % outer.size()];
+				const bool convex = cross(prev, p, next) >= 0;
+				const bool inside = convex
+					? (cross(prev, p, hole[m]) > 0 && cross(p, next, hole[m]) > 0)
+					: !(cross(prev, p, hole[m]) <= 0 && cross(p, next, hole[m]) <= 0);
+				if (!inside) continue;
+				bool visible = !crosses_polygon(hole[m], p, outer);
+				for (size_t i = h; visible && i < holes.size(); ++i) {
+					visible = !crosses_polygon(hole[m], p, holes[i]);
+				}
+				if (visible) {
+					bridge = it->first;
+					break;
+				}
+			}
+			if (bridge == outer.size()) return false;
+
+			Polygon joined;
+			joined.reserve(outer.size() + hole.size() + 2);
+			joined.insert(joined.end(), outer.begin(), outer.begin() + bridge + 1);
+			for (size_t i = 0; i <= hole.size(); ++i) {
+				joined.push_back(hole[(m + i) % hole.size()]);
+			}
+			joined.insert(joined.end(), outer.begin() + bridge, outer.end());
+			outer.swap(joined);
+		}
+		return true;
+	}
+
+	bool is_ear(const Polygon& polygon, const std::vector<size_t>& prev, const std::vector<size_t>& next, size_t i, bool allow_degenerate) {
+		const PolygonVertex& a = polygon[prev[i]];
+		const PolygonVertex& b = polygon[i];
+		const PolygonVertex& c = polygon[next[i]];
+		const double area = cross(a, b, c);
+		if (area < 0 || (area == 0 && !allow_degenerate)) return false;
+		for (size_t j = next[next[i]]; j != prev[i]; j = next[j]) {
+			const PolygonVertex& p = polygon[j];
+			if (coincident(p, a) || coincident(p, b) || coincident(p, c)) continue;
+			if (cross(a, b, p) >= 0 && cross(b, c, p) >= 0 && cross(c, a, p) >= 0) return false;
+		}
+		return true;
+	}
+
+	// Clips ears off a simple counter-clockwise polygon, possibly with
+	// bridged holes, until a single triangle remains.
+	bool clip_ears(const Polygon& polygon, std::vector<int>& indices) {
+		const size_t n = polygon.size();
+		std::vector<size_t> prev(n), next(n);
+		for (size_t i = 0; i < n; ++i) {
+			prev[i] = (i + n - 1) % n;
+			next[i] = (i + 1) % n;
+		}
+		size_t remaining = n;
+		size_t i = 0;
+		size_t visited = 0;
+		bool allow_degenerate = false;
+		while (remaining > 3) {
+			if (is_ear(polygon, prev, next, i, allow_degenerate)) {
+				indices.push_back(polygon[prev[i]].index);
+				indices.push_back(polygon[i].index);
+				indices.push_back(polygon[next[i]].index);
+				next[prev[i]] = next[i];
+				prev[next[i]] = prev[i];
+				i = next[i];
+				-- remaining;
+				visited = 0;
+				allow_degenerate = false;
+			} else {
+				i = next[i];
+				if (++ visited == remaining) {
+					// No proper ear remains, due to collinear or coincident
+					// vertices, clip a degenerate one instead
+					if (allow_degenerate) return false;
+					allow_degenerate = true;
+					visited = 0;
+				}
+			}
+		}
+		indices.push_back(polygon[prev[i]].index);
+		indices.push_back(polygon[i].index);
+		indices.push_back(polygon[next[i]].index);
+		return true;
+	}
+
+	// Triangulates the counter-clockwise outer boundary with the clockwise
+	// holes, of which the vertices are indexed from zero to num_points.
+	bool triangulate_polygons(Polygon& outer, std::vector<Polygon>& holes, size_t num_points, std::vector<int>& indices) {
+		double expected_area = signed_area(outer);
+		for (std::vector<Polygon>::const_iterator it = holes.begin(); it != holes.end(); ++it) {
+			expected_area += signed_area(*it);
+		}
+
+		if (!bridge_holes(outer, holes) || !clip_ears(outer, indices)) return false;
+
+		// The triangles need to cover the face exactly once, which is not the
+		// case for self-intersecting boundaries, for which the ear clipping still
+		// yields a result.
+		std::vector<PolygonVertex> vertices(num_points);
+		for (Polygon::const_iterator it = outer.begin(); it != outer.end(); ++it) {
+			vertices[it->index] = *it;
+		}
+		double area = 0.;
+		for (size_t i = 0; i < indices.size(); i += 3) {
+			const double a = cross(vertices[indices[i]], vertices[indices[i + 1]], vertices[indices[i + 2]]) / 2.;
+			if (a < 0) return false;
+			area += a;
+		}
+		return fabs(area - expected_area) <= 1.e-9 * (std::max)(1., fabs(expected_area));
+	}
+}
+
 IfcGeom::Representation::Serialization::Serialization(const BRep& brep)
 	: Representation(brep.settings())
 	, _id(brep.getId())
@@ -56,4 +273,176 @@ IfcGeom::Representation::Serialization::Serialization(const BRep& brep)
 	std::stringstream sstream;
 	BRepTools::Write(compound,sstream);
 	_brep_data = sstream.str();
-}
\ No newline at end of file
+}
+
+bool IfcGeom::Representation::triangulate_planar_face(const TopoDS_Face& face, std::vector<gp_XYZ>& points, std::vector<int>& indices, gp_Dir& normal) {
+	BRepAdaptor_Surface surface(face, false);
+	if (surface.GetType() != GeomAbs_Plane) return false;
+
+	const gp_Ax3 position = surface.Plane().Position();
+	normal = position.Direct() ? position.Direction() : position.Direction().Reversed();
+	if (face.Orientation() == TopAbs_REVERSED) normal.Reverse();
+
+	// A right handed coordinate system in the plane of the face, so that
+	// counter-clockwise polygons are oriented along the normal
+	const gp_Dir x = position.XDirection();
+	const gp_Dir y = normal ^ x;
+
+	const TopoDS_Wire outer_wire = BRepTools::OuterWire(face);
+	if (outer_wire.IsNull()) return false;
+
+	Polygon outer;
+	std::vector<Polygon> holes;
+
+	TopExp_Explorer exp;
+	for (exp.Init(face, TopAbs_WIRE); exp.More(); exp.Next()) {
+		const TopoDS_Wire& wire = TopoDS::Wire(exp.Current());
+		Polygon polygon;
+		BRepTools_WireExplorer wexp;
+		for (wexp.Init(wire, face); wexp.More(); wexp.Next()) {
+			const TopoDS_Edge& edge = wexp.Current();
+			if (BRep_Tool::Degenerated(edge)) continue;
+			if (BRepAdaptor_Curve(edge).GetType() != GeomAbs_Line) return false;
+			const gp_XYZ p = BRep_Tool::Pnt(wexp.CurrentVertex()).XYZ();
+			PolygonVertex v;
+			v.u = p.Dot(x.XYZ());
+			v.v = p.Dot(y.XYZ());
+			v.index = (int) points.size();
+			points.push_back(p);
+			polygon.push_back(v);
+		}
+		if (polygon.size() < 3) return false;
+		const double area = signed_area(polygon);
+		if (wire.IsSame(outer_wire)) {
+			if (area < 0) std::reverse(polygon.begin(), polygon.end());
+			outer.swap(polygon);
+		} else {
+			if (area > 0) std::reverse(polygon.begin(), polygon.end());
+			holes.push_back(polygon);
+		}
+	}
+	if (outer.empty()) return false;
+
+	return triangulate_polygons(outer, holes, points.size(), indices);
+}
+
+bool IfcGeom::Representation::triangulate_polygon(const std::vector< std::vector<gp_XYZ> >& loops, const gp_Dir& normal, std::vector<int>& indices) {
+	if (loops.empty()) return false;
+
+	const gp_Dir x = gp_Ax3(gp::Origin(), normal).XDirection();
+	const gp_Dir y = normal ^ x;
+
+	Polygon outer;
+	std::vector<Polygon> holes;
+	int index = 0;
+
+	for (std::vector< std::vector<gp_XYZ> >::const_iterator it = loops.begin(); it != loops.end(); ++it) {
+		if (it->size() < 3) return false;
+		Polygon polygon;
+		polygon.reserve(it->size());
+		for (std::vector<gp_XYZ>::const_iterator jt = it->begin(); jt != it->end(); ++jt) {
+			PolygonVertex v;
+			v.u = jt->Dot(x.XYZ());
+			v.v = jt->Dot(y.XYZ());
+			v.index = index++;
+			polygon.push_back(v);
+		}
+		const double area = signed_area(polygon);
+		if (it == loops.begin()) {
+			if (area < 0) std::reverse(polygon.begin(), polygon.end());
+			outer.swap(polygon);
+		} else {
+			if (area > 0) std::reverse(polygon.begin(), polygon.end());
+			holes.push_back(polygon);
+		}
+	}
+
+	return triangulate_polygons(outer, holes, (size_t) index, indices);
+}
+
+namespace {
+	boost::mutex task_pool_mutex;
+	IfcGeom::Representation::TaskPool* task_pool = 0;
+}
+
+IfcGeom::Representation::TaskPool& IfcGeom::Representation::TaskPool::instance() {
+	boost::mutex::scoped_lock lock(task_pool_mutex);
+	if (!task_pool) {
+		const unsigned int hardware_threads = boost::thread::hardware_concurrency();
+		// The pool is never destroyed, its threads wait for work until the process exits
+		task_pool = new TaskPool(hardware_threads > 1 ? hardware_threads - 1 : 0);
+	}
+	return *task_pool;
+}
+
+IfcGeom::Representation::TaskPool::TaskPool(unsigned int num_threads)
+	: num_threads(num_threads)
+{
+	for (unsigned int i = 0; i < num_threads; ++i) {
+		threads.create_thread(boost::bind(&TaskPool::work, this));
+	}
+}
+
+void IfcGeom::Representation::TaskPool::execute(Batch* batch, unsigned int i) {
+	try {
+		batch->task(i);
+	} catch (...) {}
+	boost::mutex::scoped_lock lock(mutex);
+	if (-- batch->remaining == 0) {
+		batch_finished.notify_all();
+	}
+}
+
+void IfcGeom::Representation::TaskPool::run(const boost::function<void(unsigned int)>& task, unsigned int n) {
+	if (n == 0) return;
+	Batch batch;
+	batch.task = task;
+	batch.next = 0;
+	batch.n = n;
+	batch.remaining = n;
+	{
+		boost::mutex::scoped_lock lock(mutex);
+		batches.push_back(&batch);
+	}
+	work_available.notify_all();
+
+	// The calling thread takes part in executing its own batch, which is
+	// removed from the queue once all of its calls have been taken.
+	for (;;) {
+		unsigned int i;
+		{
+			boost::mutex::scoped_lock lock(mutex);
+			if (batch.next == batch.n) break;
+			std::deque<Batch*>::iterator it = std::find(batches.begin(), batches.end(), &batch);
+			i = batch.next ++;
+			if (batch.next == batch.n) {
+				batches.erase(it);
+			}
+		}
+		execute(&batch, i);
+	}
+
+	boost::mutex::scoped_lock lock(mutex);
+	while (batch.remaining) {
+		batch_finished.wait(lock);
+	}
+}
+
+void IfcGeom::Representation::TaskPool::work() {
+	for (;;) {
+		Batch* batch;
+		unsigned int i;
+		{
+			boost::mutex::scoped_lock lock(mutex);
+			while (batches.empty()) {
+				work_available.wait(lock);
+			}
+			batch = batches.front();
+			i = batch->next ++;
+			if (batch->next == batch->n) {
+				batches.pop_front();
+			}
+		}
+		execute(batch, i);
+	}
+}
@@ -20,7 +20,20 @@
 #ifndef IFCGEOMREPRESENTATION_H
 #define IFCGEOMREPRESENTATION_H
 
+#include <vector>
+#include <algorithm>
+
+#include <deque>
+
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+#include <Standard_Version.hxx>
 #include <BRepMesh_IncrementalMesh.hxx>
+#include <BRepBuilderAPI_Copy.hxx>
 #include <BRepGProp_Face.hxx>
 
 #include <Poly_Triangulation.hxx>
@@ -28,9 +41,14 @@
 #include <TColgp_Array1OfPnt2d.hxx>
 
 #include <TopExp_Explorer.hxx>
+#include <TopoDS_Compound.hxx>
+#include <BRep_Builder.hxx>
+
+#include "../ifcparse/SharedPointer.h"
 
 #include "../ifcgeom/IfcGeomIteratorSettings.h"
 #include "../ifcgeom/IfcGeomMaterial.h"
+#include "../ifcgeom/IfcGeomVertexIndexMap.h"
 #include "../ifcgeom/IfcRepresentationShapeItem.h"
 
 namespace IfcGeom {
@@ -81,16 +99,71 @@ namespace IfcGeom {
 			Serialization& operator=(const Serialization&);
 		};
 
+		// Triangulates a planar face that is bounded by straight edges only,
+		// without invoking the mesher of Open Cascade. The vertices of the
+		// wires of the face are returned in points and the triangles as triplets
+		// of indices into points, oriented along the normal of the face.
+		// Returns false if the face is not of this kind or if the polygon could
+		// not be triangulated, in which case the face is to be meshed regularly.
+		bool triangulate_planar_face(const TopoDS_Face& face, std::vector<gp_XYZ>& points, std::vector<int>& indices, gp_Dir& normal);
+
+		// Triangulates a planar polygon, the outer boundary first followed by
+		// the holes, in either orientation. The triangles are oriented
+		// counter-clockwise about the normal and are returned as triplets of indices into the
+		// concatenation of the boundaries. Returns false if the polygon could
+		// not be triangulated, e.g. because its boundaries intersect.
+		bool triangulate_polygon(const std::vector< std::vector<gp_XYZ> >& loops, const gp_Dir& normal, std::vector<int>& indices);
+
+		// A process-wide pool of threads, one less than the number of hardware
+		// threads, that is shared by all triangulations that process the faces
+		// of large shapes in parallel, so that no threads are created for every
+		// shape. The threads are created on first use and live until the
+		// process exits.
+		class TaskPool {
+		public:
+			static TaskPool& instance();
+			// The number of threads that execute tasks, including the caller of run()
+			unsigned int size() const { return num_threads + 1; }
+			// Calls task(i) for every i in [0, n) on the threads of the pool and
+			// on the calling thread, and returns when all calls have completed.
+			// Tasks should not throw, exceptions are discarded.
+			void run(const boost::function<void(unsigned int)>& task, unsigned int n);
+		private:
+			struct Batch {
+				boost::function<void(unsigned int)> task;
+				unsigned int next, n, remaining;
+			};
+			unsigned int num_threads;
+			boost::mutex mutex;
+			boost::condition_variable work_available, batch_finished;
+			std::deque<Batch*> batches;
+			boost::thread_group threads;
+			explicit TaskPool(unsigned int num_threads);
+			void execute(Batch* batch, unsigned int i);
+			void work();
+			TaskPool(const TaskPool&);
+			TaskPool& operator=(const TaskPool&);
+		};
+
 		template <typename P>
 		class Triangulation : public Representation {
 		private:
-			// A nested pair of floats and a material index to be able to store an XYZ coordinate in a map.
-			// TODO: Make this a std::tuple when compilers add support for that.
-			typedef typename std::pair<P, std::pair<P, P> > Coordinate;
-			typedef typename std::pair<int, Coordinate> VertexKey;
-			typedef std::map<VertexKey, int> VertexKeyMap;
 			typedef std::pair<int, int> Edge;
 
+			// The mesh of a single face, with vertex indices local to the face
+			struct FaceTriangulation {
+				std::vector<P> verts;
+				std::vector<P> normals;
+				std::vector<int> faces;
+				std::vector<int> edges;
+				bool planar;
+				bool failed;
+				FaceTriangulation() : planar(false), failed(false) {}
+			};
+
+			// Shapes with fewer faces than this are not split over the threads of the TaskPool
+			static const unsigned int MIN_FACES_PER_THREAD = 64;
+
 			int _id;
 			std::vector<P> _verts;
 			std::vector<int> _faces;
@@ -98,7 +171,9 @@ namespace IfcGeom {
 			std::vector<P> _normals;
 			std::vector<int> _material_ids;
 			std::vector<Material> _materials;
-			VertexKeyMap welds;
+			VertexIndexMap<P> welds;
+			double _deflection;
+			std::vector< SHARED_PTR< Triangulation<P> > > _levels_of_detail;
 
 		public:
 			int id() const { return _id; }
@@ -108,158 +183,418 @@ namespace IfcGeom {
 			const std::vector<P>& normals() const { return _normals; }
 			const std::vector<int>& material_ids() const { return _material_ids; }
 			const std::vector<Material>& materials() const { return _materials; }
+			double deflection() const { return _deflection; }
+			// The lower levels of detail, one for every deflection tolerance in
+			// IteratorSettings::lod_deflection_tolerances().
+			size_t num_levels_of_detail() const { return _levels_of_detail.size(); }
+			const Triangulation<P>& level_of_detail(size_t i) const { return *_levels_of_detail.at(i); }
 			Triangulation(const BRep& shape_model)
 					: Representation(shape_model.settings())
 					, _id(shape_model.getId())
+					, _deflection(shape_model.settings().deflection_tolerance())
 			{
+				const std::vector<double>& lods = settings().lod_deflection_tolerances();
+				for ( std::vector<double>::const_iterator it = lods.begin(); it != lods.end(); ++it ) {
+					_levels_of_detail.push_back(SHARED_PTR< Triangulation<P> >(new Triangulation<P>(shape_model, *it)));
+				}
+				triangulate(shape_model);
+			}
+			virtual ~Triangulation() {}
+		private:
+			// A lower level of detail, which is filled by the triangulation
+			// of the primary level of detail.
+			Triangulation(const BRep& shape_model, double deflection)
+					: Representation(shape_model.settings())
+					, _id(shape_model.getId())
+					, _deflection(deflection)
+			{}
+			int addMaterial(const Material& material) {
+				std::vector<Material>::const_iterator it = std::find(_materials.begin(), _materials.end(), material);
+				if (it != _materials.end()) return (int) (it - _materials.begin());
+				_materials.push_back(material);
+				return (int) _materials.size() - 1;
+			}
+			static bool compare_deflection(const Triangulation<P>* a, const Triangulation<P>* b) {
+				return a->_deflection > b->_deflection;
+			}
+			// Triangulates all levels of detail in a single pass over the items.
+			// Only the faces that need to be meshed are processed for every level,
+			// the planar faces, extrusions and face sets are triangulated once.
+			void triangulate(const BRep& shape_model) {
+				std::vector<Triangulation<P>*> levels(1, this);
+				for ( typename std::vector< SHARED_PTR< Triangulation<P> > >::const_iterator it = _levels_of_detail.begin(); it != _levels_of_detail.end(); ++it ) {
+					levels.push_back(it->get());
+				}
+				// The faces are meshed from coarse to fine, an existing triangulation
+				// is then always refined by the mesher rather than kept.
+				std::vector<Triangulation<P>*> meshing_order(levels);
+				std::stable_sort(meshing_order.begin(), meshing_order.end(), compare_deflection);
+
 				for ( IfcGeom::IfcRepresentationShapeItems::const_iterator it = shape_model.begin(); it != shape_model.end(); ++ it ) {
 
 					int surface_style_id = -1;
 					if (it->hasStyle()) {
-						Material adapter(&it->Style());
-						std::vector<Material>::const_iterator jt = std::find(_materials.begin(), _materials.end(), adapter);
-						if (jt == _materials.end()) {
-							surface_style_id = _materials.size();
-							_materials.push_back(adapter);
-						} else {
-							surface_style_id = jt - _materials.begin();
+						const Material material(&it->Style());
+						for ( typename std::vector<Triangulation<P>*>::const_iterator jt = levels.begin(); jt != levels.end(); ++jt ) {
+							surface_style_id = (*jt)->addMaterial(material);
 						}
 					}
 
 					if (settings().apply_default_materials() && surface_style_id == -1) {
-						Material material(IfcGeom::get_default_style(settings().element_type()));
-						std::vector<Material>::const_iterator it = std::find(_materials.begin(), _materials.end(), material);
-						if (it == _materials.end()) {
-							surface_style_id = _materials.size();
-							_materials.push_back(material);
+						const Material material(IfcGeom::get_default_style(settings().element_type()));
+						for ( typename std::vector<Triangulation<P>*>::const_iterator jt = levels.begin(); jt != levels.end(); ++jt ) {
+							surface_style_id = (*jt)->addMaterial(material);
+						}
+					}
+
+					const gp_GTrsf& trsf = it->Placement();
+
+					if ( it->hasExtrusion() || it->hasFaceSet() ) {
+						std::vector<FaceTriangulation> face_triangulations;
+						if ( it->hasExtrusion() ) {
+							triangulateExtrusion(it->Extrusion(), trsf, face_triangulations);
 						} else {
-							surface_style_id = it - _materials.begin();
+							triangulateFaceSet(it->FaceSet(), trsf, face_triangulations);
 						}
+						for ( typename std::vector<Triangulation<P>*>::const_iterator jt = levels.begin(); jt != levels.end(); ++jt ) {
+							(*jt)->merge(surface_style_id, face_triangulations);
+						}
+						continue;
 					}
 
 					const TopoDS_Shape& s = it->Shape();
-					const gp_GTrsf& trsf = it->Placement();
 
-					// Triangulate the shape
+					std::vector<TopoDS_Face> shape_faces;
+					TopExp_Explorer exp;
+					for ( exp.Init(s,TopAbs_FACE); exp.More(); exp.Next() ) {
+						shape_faces.push_back(TopoDS::Face(exp.Current()));
+					}
+
+					// The faces are processed independently, by multiple threads if
+					// requested, and subsequently merged in the order of the shape.
+					// Planar faces bounded by straight edges are triangulated directly,
+					// only the remaining faces are passed to the mesher.
+					std::vector<FaceTriangulation> planar_triangulations(shape_faces.size());
+					triangulateFaces(shape_faces, trsf, planar_triangulations, true);
+
+					TopoDS_Compound meshed_faces;
+					BRep_Builder builder;
+					builder.MakeCompound(meshed_faces);
+					bool has_meshed_faces = false;
+					for ( size_t i = 0; i < shape_faces.size(); ++i ) {
+						if ( !planar_triangulations[i].planar ) {
+							builder.Add(meshed_faces, shape_faces[i]);
+							has_meshed_faces = true;
+						}
+					}
+
+					if ( !has_meshed_faces ) {
+						for ( typename std::vector<Triangulation<P>*>::const_iterator jt = levels.begin(); jt != levels.end(); ++jt ) {
+							(*jt)->merge(surface_style_id, planar_triangulations);
+						}
+						continue;
+					}
+
+					// The shapes may be shared with the cache of the kernel and with
+					// other threads, so a copy of the faces is meshed. Exploring the
+					// copy yields its faces in the same order as the original.
+					std::vector<TopoDS_Face> copied_faces(shape_faces);
+					TopoDS_Shape copy;
 					try {
-						BRepMesh_IncrementalMesh(s, settings().deflection_tolerance());
+						copy = BRepBuilderAPI_Copy(meshed_faces).Shape();
+						size_t i = 0;
+						for ( exp.Init(copy, TopAbs_FACE); exp.More(); exp.Next() ) {
+							while ( planar_triangulations[i].planar ) ++i;
+							copied_faces[i++] = TopoDS::Face(exp.Current());
+						}
 					} catch(...) {
-
-						// TODO: Catch outside
-						// Logger::Message(Logger::LOG_ERROR,"Failed to triangulate shape:",ifc_file->entityById(_id)->entity);
 						Logger::Message(Logger::LOG_ERROR,"Failed to triangulate shape");
 						continue;
 					}
-					TopExp_Explorer exp;
 
-					// Iterates over the faces of the shape
-					for ( exp.Init(s,TopAbs_FACE); exp.More(); exp.Next() ) {
-						TopoDS_Face face = TopoDS::Face(exp.Current());
-						TopLoc_Location loc;
-						Handle_Poly_Triangulation tri = BRep_Tool::Triangulation(face,loc);
-
-						if ( ! tri.IsNull() ) {
-
-							// A 3x3 matrix to rotate the vertex normals
-							const gp_Mat rotation_matrix = trsf.VectorialPart();
-			
-							// Keep track of the number of times an edge is used
-							// Manifold edges (i.e. edges used twice) are deemed invisible
-							std::map<std::pair<int,int>,int> edgecount;
-							std::vector<std::pair<int,int> > edges_temp;
-
-							const TColgp_Array1OfPnt& nodes = tri->Nodes();
-							const TColgp_Array1OfPnt2d& uvs = tri->UVNodes();
-							std::vector<gp_XYZ> coords;
-							BRepGProp_Face prop(face);
-							std::map<int,int> dict;
-
-							// Vertex normals are only calculated if vertices are not welded
-							const bool calculate_normals = !settings().weld_vertices();
-
-							for( int i = 1; i <= nodes.Length(); ++ i ) {
-								coords.push_back(nodes(i).Transformed(loc).XYZ());
-								trsf.Transforms(*coords.rbegin());
-								dict[i] = addVertex(surface_style_id, *coords.rbegin());
-					
-								if ( calculate_normals ) {
-									const gp_Pnt2d& uv = uvs(i);
-									gp_Pnt p;
-									gp_Vec normal_direction;
-									prop.Normal(uv.X(),uv.Y(),p,normal_direction);
-									gp_Vec normal(0., 0., 0.);
-									if (normal_direction.Magnitude() > ALMOST_ZERO) {
-										normal = gp_Dir(normal_direction.XYZ() * rotation_matrix);
-									}
-									_normals.push_back((float)normal.X());
-									_normals.push_back((float)normal.Y());
-									_normals.push_back((float)normal.Z());
-								}
-							}
+					for ( typename std::vector<Triangulation<P>*>::const_iterator jt = meshing_order.begin(); jt != meshing_order.end(); ++jt ) {
+						// Triangulate the shape
+						try {
+							mesh(copy, (*jt)->_deflection);
+						} catch(...) {
 
-							const Poly_Array1OfTriangle& triangles = tri->Triangles();			
-							for( int i = 1; i <= triangles.Length(); ++ i ) {
-								int n1,n2,n3;
-								if ( face.Orientation() == TopAbs_REVERSED )
-									triangles(i).Get(n3,n2,n1);
-								else triangles(i).Get(n1,n2,n3);
-
-								/* An alternative would be to calculate normals based
-									* on the coordinates of the mesh vertices */
-								/*
-								const gp_XYZ pt1 = coords[n1-1];
-								const gp_XYZ pt2 = coords[n2-1];
-								const gp_XYZ pt3 = coords[n3-1];
-								const gp_XYZ v1 = pt2-pt1;
-								const gp_XYZ v2 = pt3-pt2;
-								gp_Dir normal = gp_Dir(v1^v2);
-								_normals.push_back((float)normal.X());
-								_normals.push_back((float)normal.Y());
-								_normals.push_back((float)normal.Z());
-								*/
-
-								_faces.push_back(dict[n1]);
-								_faces.push_back(dict[n2]);
-								_faces.push_back(dict[n3]);
-
-								_material_ids.push_back(surface_style_id);
-
-								addEdge(n1,n2,edgecount,edges_temp);
-								addEdge(n2,n3,edgecount,edges_temp);
-								addEdge(n3,n1,edgecount,edges_temp);
-							}
-							for ( std::vector<std::pair<int,int> >::const_iterator it = edges_temp.begin(); it != edges_temp.end(); ++it ) {
-								_edges.push_back(edgecount[*it]==1);
+							// TODO: Catch outside
+							// Logger::Message(Logger::LOG_ERROR,"Failed to triangulate shape:",ifc_file->entityById(_id)->entity);
+							Logger::Message(Logger::LOG_ERROR,"Failed to triangulate shape");
+							continue;
+						}
+						std::vector<FaceTriangulation> face_triangulations(planar_triangulations);
+						triangulateFaces(copied_faces, trsf, face_triangulations, false);
+
+						for ( typename std::vector<FaceTriangulation>::const_iterator kt = face_triangulations.begin(); kt != face_triangulations.end(); ++kt ) {
+							if ( kt->failed ) {
+								throw IfcParse::IfcException("Failed to triangulate face");
 							}
 						}
+
+						(*jt)->merge(surface_style_id, face_triangulations);
+					}
+				}
+			}
+			void mesh(const TopoDS_Shape& s, double deflection) const {
+#if OCC_VERSION_HEX < 0x60800
+				// Meshing the faces of a shape in parallel is not supported by this version of Open Cascade
+				BRepMesh_IncrementalMesh(s, deflection);
+#else
+				BRepMesh_IncrementalMesh(s, deflection, Standard_False, 0.5, settings().parallel_triangulation());
+#endif
+			}
+			inline P convertUnit(double v) const {
+				return static_cast<P>(settings().convert_back_units() ? (v / settings().unit_magnitude()) : v);
+			}
+			// Triangulates either the planar faces that do not need to be meshed,
+			// or the remaining faces, which need to have been meshed beforehand.
+			void triangulateFaces(const std::vector<TopoDS_Face>& faces, const gp_GTrsf& trsf, std::vector<FaceTriangulation>& results, bool planar) const {
+				if (settings().parallel_triangulation() && faces.size() >= MIN_FACES_PER_THREAD * 2) {
+					TaskPool& pool = TaskPool::instance();
+					const unsigned int num_chunks = (std::min)(pool.size(), (unsigned int) (faces.size() / MIN_FACES_PER_THREAD));
+					if (num_chunks > 1) {
+						pool.run(boost::bind(&Triangulation::triangulateFaceRange, this, boost::cref(faces), boost::cref(trsf), boost::ref(results), planar, _1, num_chunks), num_chunks);
+						return;
+					}
+				}
+				triangulateFaceRange(faces, trsf, results, planar, 0, 1);
+			}
+			// Triangulates every step-th face starting at the first. Only the
+			// results for these faces are written, so that several threads can
+			// operate on the same vector of results.
+			void triangulateFaceRange(const std::vector<TopoDS_Face>& faces, const gp_GTrsf& trsf, std::vector<FaceTriangulation>& results, bool planar, unsigned int first, unsigned int step) const {
+				for ( size_t i = first; i < faces.size(); i += step ) {
+					if ( planar ) {
+						try {
+							triangulatePlanarFace(faces[i], trsf, results[i]);
+						} catch(...) {
+							// Leave the face to the mesher
+							results[i] = FaceTriangulation();
+						}
+					} else if ( !results[i].planar ) {
+						try {
+							triangulateFace(faces[i], trsf, results[i]);
+						} catch(...) {
+							results[i].failed = true;
+						}
 					}
 				}
 			}
-			virtual ~Triangulation() {}
-		private:
+			void triangulatePlanarFace(const TopoDS_Face& face, const gp_GTrsf& trsf, FaceTriangulation& result) const {
+				std::vector<gp_XYZ> points;
+				std::vector<int> indices;
+				gp_Dir face_normal;
+				if ( !triangulate_planar_face(face, points, indices, face_normal) ) return;
+				setPlanarFace(points, indices, face_normal, trsf, result);
+			}
+			// Creates the faces of an extrusion of a polygonal profile, of which
+			// the caps have been triangulated in advance, without meshing: the
+			// bottom and top cap followed by a quad for every edge of the profile.
+			void triangulateExtrusion(const PolygonalExtrusion& extrusion, const gp_GTrsf& trsf, std::vector<FaceTriangulation>& results) const {
+				const gp_XYZ offset = extrusion.extrusion.XYZ();
+
+				std::vector<gp_XYZ> bottom, top;
+				for ( std::vector< std::vector<gp_XYZ> >::const_iterator it = extrusion.loops.begin(); it != extrusion.loops.end(); ++it ) {
+					bottom.insert(bottom.end(), it->begin(), it->end());
+				}
+				top.reserve(bottom.size());
+				for ( std::vector<gp_XYZ>::const_iterator it = bottom.begin(); it != bottom.end(); ++it ) {
+					top.push_back(*it + offset);
+				}
+
+				results.resize(2);
+				std::vector<int> indices(extrusion.triangles.rbegin(), extrusion.triangles.rend());
+				setPlanarFace(bottom, indices, extrusion.normal.Reversed(), trsf, results[0]);
+				indices.assign(extrusion.triangles.begin(), extrusion.triangles.end());
+				setPlanarFace(top, indices, extrusion.normal, trsf, results[1]);
+
+				// The outer boundary is oriented counter-clockwise about the normal
+				// and the holes clockwise, hence the side faces point outwards.
+				std::vector<gp_XYZ> quad(4);
+				for ( std::vector< std::vector<gp_XYZ> >::const_iterator it = extrusion.loops.begin(); it != extrusion.loops.end(); ++it ) {
+					for ( size_t i = 0; i < it->size(); ++i ) {
+						const gp_XYZ& a = (*it)[i];
+						const gp_XYZ& b = (*it)[(i + 1) % it->size()];
+						const gp_XYZ side_normal = (b - a).Crossed(offset);
+						if ( side_normal.Modulus() < ALMOST_ZERO ) continue;
+						quad[0] = a;
+						quad[1] = b;
+						quad[2] = b + offset;
+						quad[3] = a + offset;
+						const int quad_indices[6] = { 0, 1, 2, 0, 2, 3 };
+						indices.assign(quad_indices, quad_indices + 6);
+						results.push_back(FaceTriangulation());
+						setPlanarFace(quad, indices, gp_Dir(side_normal), trsf, results.back());
+					}
+				}
+			}
+			// Creates the faces of a set of planar faces that have been triangulated in advance
+			void triangulateFaceSet(const PolygonalFaceSet& face_set, const gp_GTrsf& trsf, std::vector<FaceTriangulation>& results) const {
+				results.resize(face_set.size());
+				std::vector<gp_XYZ> points;
+				std::vector<int> indices;
+				for ( size_t i = 0; i < face_set.size(); ++i ) {
+					const PolygonalFace& face = face_set[i];
+					points.clear();
+					for ( std::vector< std::vector<gp_XYZ> >::const_iterator it = face.loops.begin(); it != face.loops.end(); ++it ) {
+						points.insert(points.end(), it->begin(), it->end());
+					}
+					indices.assign(face.triangles.begin(), face.triangles.end());
+					setPlanarFace(points, indices, face.normal, trsf, results[i]);
+				}
+			}
+			// Stores the triangles of a planar face, of which the vertices are
+			// transformed and converted here. The indices are swapped out.
+			void setPlanarFace(const std::vector<gp_XYZ>& points, std::vector<int>& indices, const gp_Dir& face_normal, const gp_GTrsf& trsf, FaceTriangulation& result) const {
+				const bool calculate_normals = !settings().weld_vertices();
+				gp_Vec normal(0., 0., 0.);
+				if ( calculate_normals ) {
+					normal = gp_Dir(face_normal.XYZ() * trsf.VectorialPart());
+				}
+
+				result.verts.reserve(3 * points.size());
+				if ( calculate_normals ) {
+					result.normals.reserve(3 * points.size());
+				}
+				for ( std::vector<gp_XYZ>::const_iterator it = points.begin(); it != points.end(); ++it ) {
+					gp_XYZ xyz = *it;
+					trsf.Transforms(xyz);
+					result.verts.push_back(convertUnit(xyz.X()));
+					result.verts.push_back(convertUnit(xyz.Y()));
+					result.verts.push_back(convertUnit(xyz.Z()));
+					if ( calculate_normals ) {
+						result.normals.push_back((float)normal.X());
+						result.normals.push_back((float)normal.Y());
+						result.normals.push_back((float)normal.Z());
+					}
+				}
+				result.faces.swap(indices);
+				addEdges(result);
+				result.planar = true;
+			}
+			void triangulateFace(const TopoDS_Face& face, const gp_GTrsf& trsf, FaceTriangulation& result) const {
+				TopLoc_Location loc;
+				Handle_Poly_Triangulation tri = BRep_Tool::Triangulation(face,loc);
+
+				if ( tri.IsNull() ) return;
+
+				// A 3x3 matrix to rotate the vertex normals
+				const gp_Mat rotation_matrix = trsf.VectorialPart();
+
+				const TColgp_Array1OfPnt& nodes = tri->Nodes();
+				const TColgp_Array1OfPnt2d& uvs = tri->UVNodes();
+				BRepGProp_Face prop(face);
+
+				// Vertex normals are only calculated if vertices are not welded
+				const bool calculate_normals = !settings().weld_vertices();
+
+				result.verts.reserve(3 * nodes.Length());
+				if ( calculate_normals ) {
+					result.normals.reserve(3 * nodes.Length());
+				}
+
+				for( int i = 1; i <= nodes.Length(); ++ i ) {
+					gp_XYZ xyz = nodes(i).Transformed(loc).XYZ();
+					trsf.Transforms(xyz);
+					result.verts.push_back(convertUnit(xyz.X()));
+					result.verts.push_back(convertUnit(xyz.Y()));
+					result.verts.push_back(convertUnit(xyz.Z()));
+					
+					if ( calculate_normals ) {
+						const gp_Pnt2d& uv = uvs(i);
+						gp_Pnt p;
+						gp_Vec normal_direction;
+						prop.Normal(uv.X(),uv.Y(),p,normal_direction);
+						gp_Vec normal(0., 0., 0.);
+						if (normal_direction.Magnitude() > ALMOST_ZERO) {
+							normal = gp_Dir(normal_direction.XYZ() * rotation_matrix);
+						}
+						result.normals.push_back((float)normal.X());
+						result.normals.push_back((float)normal.Y());
+						result.normals.push_back((float)normal.Z());
+					}
+				}
+
+				const Poly_Array1OfTriangle& triangles = tri->Triangles();
+				result.faces.reserve(3 * triangles.Length());
+				for( int i = 1; i <= triangles.Length(); ++ i ) {
+					int n1,n2,n3;
+					if ( face.Orientation() == TopAbs_REVERSED )
+						triangles(i).Get(n3,n2,n1);
+					else triangles(i).Get(n1,n2,n3);
+
+					result.faces.push_back(n1 - 1);
+					result.faces.push_back(n2 - 1);
+					result.faces.push_back(n3 - 1);
+				}
+				addEdges(result);
+			}
+			// Keep track of the edges of the triangles, the ones used
+			// twice (i.e. manifold edges) are deemed invisible
+			static void addEdges(FaceTriangulation& result) {
+				std::vector<Edge> edges_temp;
+				edges_temp.reserve(result.faces.size());
+				for ( size_t i = 0; i < result.faces.size(); i += 3 ) {
+					addEdge(result.faces[i    ], result.faces[i + 1], edges_temp);
+					addEdge(result.faces[i + 1], result.faces[i + 2], edges_temp);
+					addEdge(result.faces[i + 2], result.faces[i    ], edges_temp);
+				}
+				// The number of times an edge is used is obtained from a sorted copy
+				std::vector<Edge> sorted_edges(edges_temp);
+				std::sort(sorted_edges.begin(), sorted_edges.end());
+				result.edges.reserve(edges_temp.size());
+				for ( std::vector<Edge>::const_iterator it = edges_temp.begin(); it != edges_temp.end(); ++it ) {
+					const std::pair<std::vector<Edge>::const_iterator, std::vector<Edge>::const_iterator> range = std::equal_range(sorted_edges.begin(), sorted_edges.end(), *it);
+					result.edges.push_back(range.second - range.first == 1);
+				}
+			}
+			// Appends the faces in the order of the shape. The buffers are sized
+			// upfront from the totals of the individual faces, after which the
+			// indices of each face are offset by the vertices that precede it.
+			void merge(int surface_style_id, const std::vector<FaceTriangulation>& face_triangulations) {
+				size_t num_verts = 0, num_normals = 0, num_indices = 0;
+				for ( typename std::vector<FaceTriangulation>::const_iterator it = face_triangulations.begin(); it != face_triangulations.end(); ++it ) {
+					num_verts += it->verts.size();
+					num_normals += it->normals.size();
+					num_indices += it->faces.size();
+				}
+				_verts.reserve(_verts.size() + num_verts);
+				_normals.reserve(_normals.size() + num_normals);
+				_faces.reserve(_faces.size() + num_indices);
+				_edges.reserve(_edges.size() + num_indices);
+				_material_ids.reserve(_material_ids.size() + num_indices / 3);
+
+				// The vertex index by the face-local index of the node
+				std::vector<int> dict;
+				for ( typename std::vector<FaceTriangulation>::const_iterator it = face_triangulations.begin(); it != face_triangulations.end(); ++it ) {
+					const size_t n = it->verts.size() / 3;
+					dict.resize(n);
+					for ( size_t i = 0; i < n; ++i ) {
+						dict[i] = addVertex(surface_style_id, it->verts[3 * i], it->verts[3 * i + 1], it->verts[3 * i + 2]);
+					}
+					_normals.insert(_normals.end(), it->normals.begin(), it->normals.end());
+					for ( std::vector<int>::const_iterator jt = it->faces.begin(); jt != it->faces.end(); ++jt ) {
+						_faces.push_back(dict[*jt]);
+					}
+					_material_ids.insert(_material_ids.end(), it->faces.size() / 3, surface_style_id);
+					_edges.insert(_edges.end(), it->edges.begin(), it->edges.end());
+				}
+			}
 			// Welds vertices that belong to different faces
-			int addVertex(int material_index, const gp_XYZ& p) {
-				const P X = static_cast<P>(settings().convert_back_units() ? (p.X() / settings().unit_magnitude()) : p.X());
-				const P Y = static_cast<P>(settings().convert_back_units() ? (p.Y() / settings().unit_magnitude()) : p.Y());
-				const P Z = static_cast<P>(settings().convert_back_units() ? (p.Z() / settings().unit_magnitude()) : p.Z());
+			int addVertex(int material_index, P X, P Y, P Z) {
 				int i = (int) _verts.size() / 3;
 				if (settings().weld_vertices()) {
-					const VertexKey key = std::make_pair(material_index, std::make_pair(X, std::make_pair(Y, Z)));
-					typename VertexKeyMap::const_iterator it = welds.find(key);
-					if ( it != welds.end() ) return it->second;
-					i = (int) welds.size();
-					welds[key] = i;
+					const int existing = welds.insert(material_index, X, Y, Z, i);
+					if ( existing != i ) return existing;
 				}
 				_verts.push_back(X);
 				_verts.push_back(Y);
 				_verts.push_back(Z);
 				return i;
 			}
-			inline void addEdge(int n1, int n2, std::map<std::pair<int,int>,int>& edgecount, std::vector<std::pair<int,int> >& edges_temp) {
-				const Edge e = Edge( (std::min)(n1,n2),(std::max)(n1,n2) );
-				if ( edgecount.find(e) == edgecount.end() ) edgecount[e] = 1;
-				else edgecount[e] ++;
-				edges_temp.push_back(e);
+			static inline void addEdge(int n1, int n2, std::vector<Edge>& edges_temp) {
+				edges_temp.push_back(Edge( (std::min)(n1,n2),(std::max)(n1,n2) ));
 			}
 			Triangulation();
 			Triangulation(const Triangulation&);
@@ -23,6 +23,10 @@
  *                                                                              *
  ********************************************************************************/
 
+#include <cmath>
+#include <algorithm>
+
+#include <gp.hxx>
 #include <gp_Pnt.hxx>
 #include <gp_Vec.hxx>
 #include <gp_Dir.hxx>
@@ -65,8 +69,14 @@
 #include <TopoDS.hxx>
 #include <TopoDS_Wire.hxx>
 #include <TopoDS_Face.hxx>
+#include <TopoDS_Edge.hxx>
+#include <TopoDS_Vertex.hxx>
+#include <TopoDS_Shell.hxx>
+#include <TopoDS_Compound.hxx>
 #include <TopExp_Explorer.hxx>
 
+#include <BRep_Builder.hxx>
+
 #include <BRepPrimAPI_MakePrism.hxx>
 #include <BRepPrimAPI_MakeRevol.hxx>
 #include <BRepPrimAPI_MakeBox.hxx>
@@ -96,6 +106,7 @@
 #include <Standard_Version.hxx>
 
 #include "../ifcgeom/IfcGeom.h"
+#include "../ifcgeom/IfcGeomVertexIndexMap.h"
 
 bool IfcGeom::Kernel::convert(const IfcSchema::IfcExtrudedAreaSolid* l, TopoDS_Shape& shape) {
 	TopoDS_Shape face;
@@ -140,6 +151,106 @@ bool IfcGeom::Kernel::convert(const IfcSchema::IfcExtrudedAreaSolid* l, TopoDS_S
 	return ! shape.IsNull();
 }
 
+bool IfcGeom::Kernel::convert_polygonal_loop(const IfcSchema::IfcCurve* l, std::vector<gp_XYZ>& loop) {
+	if ( !l->is(IfcSchema::Type::IfcPolyline) ) return false;
+	IfcSchema::IfcCartesianPoint::list::ptr points = ((IfcSchema::IfcPolyline*)l)->Points();
+
+	TColgp_SequenceOfPnt polygon;
+	for(IfcSchema::IfcCartesianPoint::list::it it = points->begin(); it != points->end(); ++ it) {
+		gp_Pnt pnt;
+		IfcGeom::Kernel::convert(*it, pnt);
+		polygon.Append(pnt);
+	}
+
+	// Remove points that are too close to one another, including the
+	// closing point that coincides with the first point of the polyline
+	remove_redundant_points_from_loop(polygon, true);
+	if ( polygon.Length() < 3 ) return false;
+
+	loop.clear();
+	loop.reserve(polygon.Length());
+	for (int i = 1; i <= polygon.Length(); ++i) {
+		loop.push_back(polygon.Value(i).XYZ());
+	}
+	return true;
+}
+
+bool IfcGeom::Kernel::convert_polygonal_extrusion(const IfcSchema::IfcExtrudedAreaSolid* l, PolygonalExtrusion& extrusion) {
+	IfcSchema::IfcProfileDef* profile = l->SweptArea();
+	if ( profile->ProfileType() != IfcSchema::IfcProfileTypeEnum::IfcProfileType_AREA ) return false;
+
+	std::vector< std::vector<gp_XYZ> >& loops = extrusion.loops;
+	loops.clear();
+
+	if ( profile->type() == IfcSchema::Type::IfcRectangleProfileDef ) {
+		IfcSchema::IfcRectangleProfileDef* rectangle = (IfcSchema::IfcRectangleProfileDef*) profile;
+		const double x = rectangle->XDim() / 2.0f * getValue(GV_LENGTH_UNIT);
+		const double y = rectangle->YDim() / 2.0f * getValue(GV_LENGTH_UNIT);
+		if ( x < ALMOST_ZERO || y < ALMOST_ZERO ) return false;
+
+		gp_Trsf2d trsf2d;
+		IfcGeom::Kernel::convert(rectangle->Position(),trsf2d);
+		const double coords[8] = {-x,-y,x,-y,x,y,-x,y};
+		std::vector<gp_XYZ> loop;
+		for (int i = 0; i < 4; ++i) {
+			gp_Pnt2d pnt(coords[2*i], coords[2*i+1]);
+			pnt.Transform(trsf2d);
+			loop.push_back(gp_XYZ(pnt.X(), pnt.Y(), 0.));
+		}
+		loops.push_back(loop);
+	} else if ( profile->is(IfcSchema::Type::IfcArbitraryClosedProfileDef) ) {
+		IfcSchema::IfcArbitraryClosedProfileDef* arbitrary = (IfcSchema::IfcArbitraryClosedProfileDef*) profile;
+		loops.push_back(std::vector<gp_XYZ>());
+		if ( !convert_polygonal_loop(arbitrary->OuterCurve(), loops.back()) ) return false;
+		if ( profile->is(IfcSchema::Type::IfcArbitraryProfileDefWithVoids) ) {
+			IfcSchema::IfcCurve::list::ptr voids = ((IfcSchema::IfcArbitraryProfileDefWithVoids*) profile)->InnerCurves();
+			for( IfcSchema::IfcCurve::list::it it = voids->begin(); it != voids->end(); ++ it ) {
+				loops.push_back(std::vector<gp_XYZ>());
+				if ( !convert_polygonal_loop(*it, loops.back()) ) return false;
+			}
+		}
+	} else {
+		return false;
+	}
+
+	const double height = l->Depth() * getValue(GV_LENGTH_UNIT);
+	gp_Trsf trsf;
+	IfcGeom::Kernel::convert(l->Position(),trsf);
+
+	gp_Dir dir;
+	convert(l->ExtrudedDirection(),dir);
+
+	gp_Dir normal = gp::DZ();
+	gp_Vec direction = gp_Vec(dir) * height;
+	if ( std::fabs(direction.Dot(normal)) < ALMOST_ZERO ) return false;
+	// The caps are oriented such that the normal points to the side of the extrusion
+	if ( direction.Dot(normal) < 0. ) normal.Reverse();
+
+	for (std::vector< std::vector<gp_XYZ> >::iterator it = loops.begin(); it != loops.end(); ++it) {
+		// Newell's method for the orientation of the loop about the normal
+		gp_XYZ newell;
+		for (size_t i = 0; i < it->size(); ++i) {
+			const gp_XYZ& a = (*it)[i];
+			const gp_XYZ& b = (*it)[(i + 1) % it->size()];
+			newell += a.Crossed(b);
+		}
+		const bool counter_clockwise = newell.Dot(normal.XYZ()) > 0.;
+		if ( counter_clockwise != (it == loops.begin()) ) {
+			std::reverse(it->begin(), it->end());
+		}
+		for (std::vector<gp_XYZ>::iterator jt = it->begin(); jt != it->end(); ++jt) {
+			trsf.Transforms(*jt);
+		}
+	}
+
+	normal.Transform(trsf);
+	direction.Transform(trsf);
+	extrusion.normal = normal;
+	extrusion.extrusion = direction;
+
+	return IfcGeom::Representation::triangulate_polygon(loops, normal, extrusion.triangles);
+}
+
 bool IfcGeom::Kernel::convert(const IfcSchema::IfcSurfaceOfLinearExtrusion* l, TopoDS_Shape& shape) {
 	TopoDS_Wire wire;
 	if ( !convert_wire(l->SweptCurve(), wire) ) {
@@ -290,9 +401,18 @@ bool IfcGeom::Kernel::convert(const IfcSchema::IfcBooleanResult* l, TopoDS_Shape
 		s1 = ensure_fit_for_subtraction(s1, temp_solid); }
 	}
 
-	const double first_operand_volume = shape_volume(s1);
-	if ( first_operand_volume <= ALMOST_ZERO )
-		Logger::Message(Logger::LOG_WARNING,"Empty solid for:",l->FirstOperand()->entity);
+	// Volumes are only computed up front in diagnostic mode, otherwise the
+	// operands are only checked for volume when the operation fails
+	const bool volume_diagnostics = volume_diagnostics_enabled();
+
+	double first_operand_volume = 0.;
+	if ( volume_diagnostics ) {
+		first_operand_volume = shape_volume(s1);
+		if ( first_operand_volume <= ALMOST_ZERO )
+			Logger::Message(Logger::LOG_WARNING,"Empty solid for:",operand1->entity);
+	} else {
+		report_empty_shape(s1, false, "Empty solid for:", operand1->entity);
+	}
 
 	bool shape2_processed = false;
 	if ( is_shape_collection(operand2) ) {
@@ -312,9 +432,7 @@ bool IfcGeom::Kernel::convert(const IfcSchema::IfcBooleanResult* l, TopoDS_Shape
 	}
 
 	if (!is_halfspace) {
-		const double second_operand_volume = shape_volume(s2);
-		if ( second_operand_volume <= ALMOST_ZERO )
-			Logger::Message(Logger::LOG_WARNING,"Empty solid for:",operand2->entity);
+		report_empty_shape(s2, volume_diagnostics, "Empty solid for:", operand2->entity);
 	}
 
 	const IfcSchema::IfcBooleanOperator::IfcBooleanOperator op = l->Operator();
@@ -326,27 +444,23 @@ bool IfcGeom::Kernel::convert(const IfcSchema::IfcBooleanResult* l, TopoDS_Shape
 		if ( brep_cut.IsDone() ) {
 			TopoDS_Shape result = brep_cut;
 
-			ShapeFix_Shape fix(result);
-			try {
-				fix.Perform();
-				result = fix.Shape();
-			} catch (...) {
-				Logger::Message(Logger::LOG_WARNING, "Shape healing failed on boolean result", l->entity);
-			}
-		
-			bool is_valid = BRepCheck_Analyzer(result).IsValid() != 0;
+			bool is_valid = is_valid_result(result, s1, true, l);
 			if ( is_valid ) {
 				shape = result;
 				valid_cut = true;
 			} 
 		}
 
-		if ( valid_cut ) {
+		if ( valid_cut && volume_diagnostics ) {
 			const double volume_after_subtraction = shape_volume(shape);
 			if ( ALMOST_THE_SAME(first_operand_volume,volume_after_subtraction) )
 				Logger::Message(Logger::LOG_WARNING,"Subtraction yields unchanged volume:",l->entity);
-		} else {
+		} else if ( !valid_cut ) {
 			Logger::Message(Logger::LOG_ERROR,"Failed to process subtraction:",l->entity);
+			if ( !volume_diagnostics ) {
+				report_empty_shape(s1, true, "Empty solid for:", operand1->entity);
+				if (!is_halfspace) report_empty_shape(s2, true, "Empty solid for:", operand2->entity);
+			}
 			shape = s1;
 		}
 
@@ -358,11 +472,13 @@ bool IfcGeom::Kernel::convert(const IfcSchema::IfcBooleanResult* l, TopoDS_Shape
 		if ( brep_fuse.IsDone() ) {
 			TopoDS_Shape result = brep_fuse;
 
-			ShapeFix_Shape fix(result);
-			fix.Perform();
-			result = fix.Shape();
-		
-			bool is_valid = BRepCheck_Analyzer(result).IsValid() != 0;
+			TopoDS_Compound operands;
+			BRep_Builder builder;
+			builder.MakeCompound(operands);
+			builder.Add(operands, s1);
+			builder.Add(operands, s2);
+
+			bool is_valid = is_valid_result(result, operands, true, l);
 			if ( is_valid ) {
 				shape = result;
 				return true;
@@ -375,11 +491,7 @@ bool IfcGeom::Kernel::convert(const IfcSchema::IfcBooleanResult* l, TopoDS_Shape
 		if ( brep_common.IsDone() ) {
 			TopoDS_Shape result = brep_common;
 
-			ShapeFix_Shape fix(result);
-			fix.Perform();
-			result = fix.Shape();
-		
-			bool is_valid = BRepCheck_Analyzer(result).IsValid() != 0;
+			bool is_valid = is_valid_result(result, s1, true, l);
 			if ( is_valid ) {
 				shape = result;
 				return true;
@@ -417,25 +529,43 @@ bool IfcGeom::Kernel::convert(const IfcSchema::IfcConnectedFaceSet* l, TopoDS_Sh
 		try {
 			builder.Perform();
 			shape = builder.SewedShape();
-			valid_shell = BRepCheck_Analyzer(shape).IsValid();
+			// Either a single shell is sewn or, for disconnected faces, a compound of shells
+			valid_shell = is_valid_result(shape, TopoDS_Shape(), false) &&
+				(shape.ShapeType() == TopAbs_SHELL || shape.ShapeType() == TopAbs_COMPOUND);
 		} catch(...) {}
-		if (valid_shell) {
-			try {
-				ShapeFix_Solid solid;
-				solid.LimitTolerance(getValue(GV_POINT_EQUALITY_TOLERANCE));
-				TopoDS_Solid solid_shape = solid.SolidFromShell(TopoDS::Shell(shape));
-				if (!solid_shape.IsNull()) {
-					try {
-						BRepClass3d_SolidClassifier classifier(solid_shape);
-						shape = solid_shape;
-					} catch (...) {}
-				}
-			} catch(...) {}
+		if (!valid_shell) {
+			Logger::Message(Logger::LOG_WARNING,"Failed to sew faceset:",l->entity);
+		}
+	} else if ( getValue(GV_MAX_FACES_TO_SEW) > 0 ) {
+		// BRepOffsetAPI_Sewing scales poorly with the number of faces, larger
+		// sets of polygonal faces are sewn by merging their vertices instead
+		bool sewn = false;
+		try {
+			// Validated like the result of BRepOffsetAPI_Sewing, an invalid
+			// result is replaced by a compound of the individual faces
+			sewn = sew_polygonal_faces(l, shape) && is_valid_result(shape, TopoDS_Shape(), false);
+		} catch(...) {}
+		if (sewn) {
+			// Disconnected faces result in a compound of shells, which is kept as is
+			if (shape.ShapeType() != TopAbs_SHELL) return true;
+			valid_shell = true;
 		} else {
 			Logger::Message(Logger::LOG_WARNING,"Failed to sew faceset:",l->entity);
 		}
 	}
-	if (!valid_shell) {
+	if (valid_shell && shape.ShapeType() == TopAbs_SHELL) {
+		try {
+			ShapeFix_Solid solid;
+			solid.LimitTolerance(getValue(GV_POINT_EQUALITY_TOLERANCE));
+			TopoDS_Solid solid_shape = solid.SolidFromShell(TopoDS::Shell(shape));
+			if (!solid_shape.IsNull()) {
+				try {
+					BRepClass3d_SolidClassifier classifier(solid_shape);
+					shape = solid_shape;
+				} catch (...) {}
+			}
+		} catch(...) {}
+	} else if (!valid_shell) {
 		TopoDS_Compound compound;
 		BRep_Builder builder;
 		builder.MakeCompound(compound);
@@ -458,8 +588,375 @@ bool IfcGeom::Kernel::convert(const IfcSchema::IfcConnectedFaceSet* l, TopoDS_Sh
 	return true;
 }
 
-bool IfcGeom::Kernel::convert(const IfcSchema::IfcMappedItem* l, IfcRepresentationShapeItems& shapes) {
-	gp_GTrsf gtrsf;
+bool IfcGeom::Kernel::convert_polygonal_face(const IfcSchema::IfcFace* l, PolygonalFace& face) {
+	IfcSchema::IfcFaceBound::list::ptr bounds = l->Bounds();
+	face.loops.clear();
+	face.triangles.clear();
+
+	// The outer bound, if marked as such, is moved to the front
+	std::vector<IfcSchema::IfcFaceBound*> ordered_bounds;
+	for( IfcSchema::IfcFaceBound::list::it jt = bounds->begin(); jt != bounds->end(); ++ jt ) {
+		if ( (*jt)->is(IfcSchema::Type::IfcFaceOuterBound) ) {
+			ordered_bounds.insert(ordered_bounds.begin(), *jt);
+		} else {
+			ordered_bounds.push_back(*jt);
+		}
+	}
+	if ( ordered_bounds.empty() ) return false;
+
+	for( std::vector<IfcSchema::IfcFaceBound*>::const_iterator jt = ordered_bounds.begin(); jt != ordered_bounds.end(); ++ jt ) {
+		IfcSchema::IfcLoop* loop = (*jt)->Bound();
+		if ( !loop->is(IfcSchema::Type::IfcPolyLoop) ) return false;
+		IfcSchema::IfcCartesianPoint::list::ptr points = ((IfcSchema::IfcPolyLoop*)loop)->Polygon();
+
+		TColgp_SequenceOfPnt polygon;
+		for(IfcSchema::IfcCartesianPoint::list::it kt = points->begin(); kt != points->end(); ++ kt) {
+			gp_Pnt pnt;
+			IfcGeom::Kernel::convert(*kt, pnt);
+			polygon.Append(pnt);
+		}
+		remove_redundant_points_from_loop(polygon, true);
+		if ( polygon.Length() < 3 ) {
+			face.loops.clear();
+			return true;
+		}
+
+		face.loops.push_back(std::vector<gp_XYZ>());
+		std::vector<gp_XYZ>& xyzs = face.loops.back();
+		xyzs.reserve(polygon.Length());
+		for (int i = 1; i <= polygon.Length(); ++i) {
+			xyzs.push_back(polygon.Value(i).XYZ());
+		}
+		if ( !(*jt)->Orientation() ) {
+			std::reverse(xyzs.begin(), xyzs.end());
+		}
+	}
+
+	gp_XYZ newell;
+	const std::vector<gp_XYZ>& outer = face.loops.front();
+	for (size_t i = 0; i < outer.size(); ++i) {
+		newell += outer[i].Crossed(outer[(i + 1) % outer.size()]);
+	}
+	if ( newell.Modulus() / 2. <= getValue(GV_MINIMAL_FACE_AREA) ) {
+		face.loops.clear();
+		return true;
+	}
+	face.normal = gp_Dir(newell);
+
+	// Non-planar faces are left to the regular conversion
+	const double tolerance = getValue(GV_POINT_EQUALITY_TOLERANCE);
+	const gp_XYZ& origin = outer.front();
+	for( std::vector< std::vector<gp_XYZ> >::const_iterator jt = face.loops.begin(); jt != face.loops.end(); ++ jt ) {
+		for( std::vector<gp_XYZ>::const_iterator kt = jt->begin(); kt != jt->end(); ++ kt ) {
+			if ( std::fabs((*kt - origin).Dot(face.normal.XYZ())) > tolerance ) return false;
+		}
+	}
+
+	return true;
+}
+
+bool IfcGeom::Kernel::convert_polygonal_face_set(const IfcSchema::IfcConnectedFaceSet* l, PolygonalFaceSet& face_set) {
+	IfcSchema::IfcFace::list::ptr faces = l->CfsFaces();
+	face_set.clear();
+	face_set.reserve(faces->size());
+
+	for( IfcSchema::IfcFace::list::it it = faces->begin(); it != faces->end(); ++ it ) {
+		PolygonalFace face;
+		if ( !convert_polygonal_face(*it, face) ) return false;
+		// Like in the conversion of an IfcConnectedFaceSet, degenerate faces are skipped
+		if ( face.loops.empty() ) {
+			Logger::Message(Logger::LOG_WARNING,"Invalid face:",(*it)->entity);
+			continue;
+		}
+		if ( !IfcGeom::Representation::triangulate_polygon(face.loops, face.normal, face.triangles) ) return false;
+		face_set.push_back(face);
+	}
+
+	return !face_set.empty();
+}
+
+bool IfcGeom::Kernel::convert_polygonal_face_sets(const IfcSchema::IfcRepresentationItem* l, IfcRepresentationShapeItems& shapes) {
+	// The face sets with the styles they are to be assigned, which are
+	// obtained in the same way as by the regular conversion functions
+	std::vector< std::pair<IfcSchema::IfcConnectedFaceSet*, const SurfaceStyle*> > face_sets;
+	const SurfaceStyle* collective_style = get_style(l);
+
+	if ( l->is(IfcSchema::Type::IfcFacetedBrep) ) {
+		IfcSchema::IfcClosedShell* shell = ((IfcSchema::IfcFacetedBrep*)l)->Outer();
+		const SurfaceStyle* indiv_style = get_style(shell);
+		face_sets.push_back(std::make_pair((IfcSchema::IfcConnectedFaceSet*)shell, indiv_style ? indiv_style : collective_style));
+	} else if ( l->is(IfcSchema::Type::IfcFaceBasedSurfaceModel) ) {
+		IfcSchema::IfcConnectedFaceSet::list::ptr facesets = ((IfcSchema::IfcFaceBasedSurfaceModel*)l)->FbsmFaces();
+		for( IfcSchema::IfcConnectedFaceSet::list::it it = facesets->begin(); it != facesets->end(); ++ it ) {
+			const SurfaceStyle* shell_style = get_style(*it);
+			face_sets.push_back(std::make_pair(*it, shell_style ? shell_style : collective_style));
+		}
+	} else if ( l->is(IfcSchema::Type::IfcShellBasedSurfaceModel) ) {
+		IfcEntityList::ptr shells = ((IfcSchema::IfcShellBasedSurfaceModel*)l)->SbsmBoundary();
+		for( IfcEntityList::it it = shells->begin(); it != shells->end(); ++ it ) {
+			if ( !(*it)->is(IfcSchema::Type::IfcConnectedFaceSet) ) return false;
+			IfcSchema::IfcConnectedFaceSet* shell = (IfcSchema::IfcConnectedFaceSet*)*it;
+			const SurfaceStyle* shell_style = get_style(shell);
+			face_sets.push_back(std::make_pair(shell, shell_style ? shell_style : collective_style));
+		}
+	} else {
+		return false;
+	}
+
+	IfcRepresentationShapeItems items;
+	for ( std::vector< std::pair<IfcSchema::IfcConnectedFaceSet*, const SurfaceStyle*> >::const_iterator it = face_sets.begin(); it != face_sets.end(); ++it ) {
+		SHARED_PTR<PolygonalFaceSet> face_set(new PolygonalFaceSet);
+		if ( !convert_polygonal_face_set(it->first, *face_set) ) return false;
+		items.push_back(IfcRepresentationShapeItem(SHARED_PTR<const PolygonalFaceSet>(face_set), it->second));
+	}
+
+	shapes.insert(shapes.end(), items.begin(), items.end());
+	return !items.empty();
+}
+
+namespace {
+	// Merges points that are within a tolerance of one another by hashing
+	// them on a grid with cells the size of the tolerance. A point is only
+	// compared to the points in its own cell and in the neighbouring cells.
+	class VertexGrid {
+	private:
+		double tolerance;
+		IfcGeom::KeyIndexMap<double, 3> cells;
+		std::vector<int> next_in_cell;
+		std::vector<gp_XYZ> points;
+		void cell(const gp_XYZ& xyz, double* key) const {
+			// Adding zero normalizes negative zero, which has a different representation
+			key[0] = std::floor(xyz.X() / tolerance) + 0.;
+			key[1] = std::floor(xyz.Y() / tolerance) + 0.;
+			key[2] = std::floor(xyz.Z() / tolerance) + 0.;
+		}
+	public:
+		VertexGrid(double tolerance) : tolerance(tolerance) {}
+		int insert(const gp_XYZ& xyz) {
+			double key[3];
+			cell(xyz, key);
+			double neighbour[3];
+			for (int dx = -1; dx <= 1; ++dx) {
+				for (int dy = -1; dy <= 1; ++dy) {
+					for (int dz = -1; dz <= 1; ++dz) {
+						neighbour[0] = key[0] + dx; neighbour[1] = key[1] + dy; neighbour[2] = key[2] + dz;
+						for (int i = cells.find(neighbour); i != -1; i = next_in_cell[i]) {
+							if ((points[i] - xyz).Modulus() <= tolerance) return i;
+						}
+					}
+				}
+			}
+			const int index = (int) points.size();
+			points.push_back(xyz);
+			next_in_cell.push_back(cells.find(key));
+			cells.set(key, index);
+			return index;
+		}
+		const std::vector<gp_XYZ>& vertices() const { return points; }
+	};
+
+	// An edge of a face boundary, referring to the shared edge and whether
+	// it is traversed from its lowest to its highest vertex index.
+	struct EdgeUse {
+		int edge;
+		bool forward;
+	};
+}
+
+bool IfcGeom::Kernel::sew_polygonal_faces(const IfcSchema::IfcConnectedFaceSet* l, TopoDS_Shape& shape) {
+	IfcSchema::IfcFace::list::ptr faces = l->CfsFaces();
+	const double tolerance = getValue(GV_POINT_EQUALITY_TOLERANCE);
+	if ( tolerance < ALMOST_ZERO ) return false;
+
+	std::vector<PolygonalFace> polygons;
+	std::vector<IfcSchema::IfcFace*> polygon_faces;
+	polygons.reserve(faces->size());
+	polygon_faces.reserve(faces->size());
+	for( IfcSchema::IfcFace::list::it it = faces->begin(); it != faces->end(); ++ it ) {
+		PolygonalFace face;
+		if ( !convert_polygonal_face(*it, face) ) return false;
+		if ( face.loops.empty() ) {
+			Logger::Message(Logger::LOG_WARNING,"Invalid face:",(*it)->entity);
+			continue;
+		}
+		polygons.push_back(face);
+		polygon_faces.push_back(*it);
+	}
+
+	// Vertices within the tolerance of one another are merged and the
+	// boundaries of the faces are expressed as edges between them. The
+	// uses of the edges are stored such that every edge that is shared
+	// by exactly two faces connects those faces.
+	VertexGrid grid(tolerance);
+	IfcGeom::KeyIndexMap<int, 2> edge_indices;
+	std::vector< std::pair<int, int> > edges;
+	std::vector<int> edge_use_count, edge_first_face, edge_second_face;
+	std::vector<bool> edge_first_forward, edge_second_forward;
+	std::vector< std::vector< std::vector<EdgeUse> > > face_edges(polygons.size());
+
+	for (size_t f = 0; f < polygons.size(); ++f) {
+		const std::vector< std::vector<gp_XYZ> >& loops = polygons[f].loops;
+		for (std::vector< std::vector<gp_XYZ> >::const_iterator it = loops.begin(); it != loops.end(); ++it) {
+			std::vector<int> indices;
+			indices.reserve(it->size());
+			for (std::vector<gp_XYZ>::const_iterator jt = it->begin(); jt != it->end(); ++jt) {
+				const int index = grid.insert(*jt);
+				if (indices.empty() || indices.back() != index) indices.push_back(index);
+			}
+			while (indices.size() > 1 && indices.front() == indices.back()) {
+				indices.pop_back();
+			}
+			if (indices.size() < 3) {
+				// Only holes that collapse are skipped, a collapsed outer boundary skips the face
+				if (it == loops.begin()) {
+					Logger::Message(Logger::LOG_WARNING,"Invalid face:",polygon_faces[f]->entity);
+					break;
+				}
+				continue;
+			}
+
+			face_edges[f].push_back(std::vector<EdgeUse>());
+			std::vector<EdgeUse>& uses = face_edges[f].back();
+			uses.reserve(indices.size());
+			for (size_t i = 0; i < indices.size(); ++i) {
+				const int a = indices[i];
+				const int b = indices[(i + 1) % indices.size()];
+				const int key[2] = { std::min(a, b), std::max(a, b) };
+				const int edge = edge_indices.insert(key, (int) edges.size());
+				if (edge == (int) edges.size()) {
+					edges.push_back(std::make_pair(key[0], key[1]));
+					edge_use_count.push_back(0);
+					edge_first_face.push_back((int) f);
+					edge_second_face.push_back(-1);
+					edge_first_forward.push_back(a < b);
+					edge_second_forward.push_back(false);
+				} else if (edge_use_count[edge] == 1) {
+					edge_second_face[edge] = (int) f;
+					edge_second_forward[edge] = a < b;
+				}
+				++ edge_use_count[edge];
+				EdgeUse use;
+				use.edge = edge;
+				use.forward = a < b;
+				uses.push_back(use);
+			}
+		}
+	}
+
+	// The faces are oriented consistently by a breadth-first traversal over
+	// the manifold edges, which should be traversed in opposite directions
+	// by the two faces they connect. Every traversal yields a shell.
+	std::vector<int> flipped(polygons.size(), -1);
+	std::vector< std::vector<int> > components;
+	std::vector<int> queue;
+	queue.reserve(polygons.size());
+	for (size_t f = 0; f < polygons.size(); ++f) {
+		if (face_edges[f].empty() || flipped[f] != -1) continue;
+		components.push_back(std::vector<int>());
+		queue.clear();
+		queue.push_back((int) f);
+		flipped[f] = 0;
+		for (size_t head = 0; head < queue.size(); ++head) {
+			const int g = queue[head];
+			components.back().push_back(g);
+			for (std::vector< std::vector<EdgeUse> >::const_iterator it = face_edges[g].begin(); it != face_edges[g].end(); ++it) {
+				for (std::vector<EdgeUse>::const_iterator jt = it->begin(); jt != it->end(); ++jt) {
+					const int e = jt->edge;
+					if (edge_use_count[e] != 2) continue;
+					const int h = edge_first_face[e] == g ? edge_second_face[e] : edge_first_face[e];
+					if (h == g || flipped[h] != -1) continue;
+					const bool forward_h = edge_first_face[e] == h ? edge_first_forward[e] : edge_second_forward[e];
+					const bool effective_g = jt->forward != (flipped[g] == 1);
+					flipped[h] = (forward_h == effective_g) ? 1 : 0;
+					queue.push_back(h);
+				}
+			}
+		}
+	}
+	if (components.empty()) return false;
+
+	BRep_Builder builder;
+	const std::vector<gp_XYZ>& vertices = grid.vertices();
+	std::vector<TopoDS_Vertex> topo_vertices(vertices.size());
+	for (size_t i = 0; i < vertices.size(); ++i) {
+		builder.MakeVertex(topo_vertices[i], gp_Pnt(vertices[i]), tolerance);
+	}
+	std::vector<TopoDS_Edge> topo_edges(edges.size());
+	for (size_t i = 0; i < edges.size(); ++i) {
+		BRepBuilderAPI_MakeEdge me(topo_vertices[edges[i].first], topo_vertices[edges[i].second]);
+		if ( !me.IsDone() ) return false;
+		topo_edges[i] = me.Edge();
+	}
+
+	TopoDS_Compound compound;
+	builder.MakeCompound(compound);
+	int num_shells = 0;
+	TopoDS_Shell last_shell;
+
+	for (std::vector< std::vector<int> >::const_iterator it = components.begin(); it != components.end(); ++it) {
+		TopoDS_Shell shell;
+		builder.MakeShell(shell);
+		bool faces_added = false;
+		for (std::vector<int>::const_iterator jt = it->begin(); jt != it->end(); ++jt) {
+			const PolygonalFace& polygon = polygons[*jt];
+			const std::vector< std::vector<EdgeUse> >& loops = face_edges[*jt];
+			const gp_Pln plane(gp_Pnt(polygon.loops.front().front()), polygon.normal);
+
+			std::vector<TopoDS_Wire> wires;
+			for (std::vector< std::vector<EdgeUse> >::const_iterator kt = loops.begin(); kt != loops.end(); ++kt) {
+				TopoDS_Wire wire;
+				builder.MakeWire(wire);
+				gp_XYZ newell;
+				for (std::vector<EdgeUse>::const_iterator lt = kt->begin(); lt != kt->end(); ++lt) {
+					const TopoDS_Edge& edge = topo_edges[lt->edge];
+					builder.Add(wire, lt->forward ? edge : TopoDS::Edge(edge.Reversed()));
+					const gp_XYZ& a = vertices[lt->forward ? edges[lt->edge].first : edges[lt->edge].second];
+					const gp_XYZ& b = vertices[lt->forward ? edges[lt->edge].second : edges[lt->edge].first];
+					newell += a.Crossed(b);
+				}
+				wire.Closed(true);
+				// Holes are oriented clockwise about the normal of the face
+				if (kt != loops.begin() && newell.Dot(polygon.normal.XYZ()) > 0.) {
+					wire.Reverse();
+				}
+				wires.push_back(wire);
+			}
+
+			TopoDS_Face face;
+			BRepBuilderAPI_MakeFace mf(plane, wires.front());
+			if ( mf.IsDone() ) {
+				for (size_t i = 1; i < wires.size(); ++i) {
+					mf.Add(wires[i]);
+				}
+				face = mf.Face();
+			}
+			if (face.IsNull()) {
+				Logger::Message(Logger::LOG_WARNING,"Invalid face:",l->entity);
+				continue;
+			}
+			if (flipped[*jt] == 1) {
+				face.Reverse();
+			}
+			builder.Add(shell, face);
+			faces_added = true;
+		}
+		if (faces_added) {
+			builder.Add(compound, shell);
+			last_shell = shell;
+			++ num_shells;
+		}
+	}
+
+	if (num_shells == 0) return false;
+	if (num_shells == 1) {
+		shape = last_shell;
+	} else {
+		shape = compound;
+	}
+	return true;
+}
+
+bool IfcGeom::Kernel::convert_mapping(const IfcSchema::IfcMappedItem* l, gp_GTrsf& gtrsf) {
 	IfcSchema::IfcCartesianTransformationOperator* transform = l->MappingTarget();
 	if ( transform->is(IfcSchema::Type::IfcCartesianTransformationOperator3DnonUniform) ) {
 		IfcGeom::Kernel::convert((IfcSchema::IfcCartesianTransformationOperator3DnonUniform*)transform,gtrsf);
@@ -486,8 +983,27 @@ bool IfcGeom::Kernel::convert(const IfcSchema::IfcMappedItem* l, IfcRepresentati
 		trsf = trsf_2d;
 	}
 	gtrsf.Multiply(trsf);
+	return true;
+}
+
+bool IfcGeom::Kernel::convert(const IfcSchema::IfcMappedItem* l, IfcRepresentationShapeItems& shapes) {
+	gp_GTrsf gtrsf;
+	if (!convert_mapping(l, gtrsf)) {
+		return false;
+	}
+	IfcSchema::IfcRepresentationMap* map = l->MappingSource();
 	const unsigned int previous_size = (const unsigned int) shapes.size();
-	bool b = convert_shapes(map->MappedRepresentation(),shapes);
+	// The items of the mapped representation are likely to be reused by
+	// other instances, so these are pinned in the shape cache
+	++ mapped_item_depth;
+	bool b;
+	try {
+		b = convert_shapes(map->MappedRepresentation(),shapes);
+	} catch (...) {
+		-- mapped_item_depth;
+		throw;
+	}
+	-- mapped_item_depth;
 	for ( unsigned int i = previous_size; i < shapes.size(); ++ i ) {
 		shapes[i].append(gtrsf);
 	}
@@ -501,8 +1017,30 @@ bool IfcGeom::Kernel::convert(const IfcSchema::IfcShapeRepresentation* l, IfcRep
 		for ( IfcSchema::IfcRepresentationItem::list::it it = items->begin(); it != items->end(); ++ it ) {
 			IfcSchema::IfcRepresentationItem* representation_item = *it;
 			if ( is_shape_collection(representation_item) ) {
+				if ( direct_face_set_meshes ) {
+					bool converted = false;
+					try {
+						converted = convert_polygonal_face_sets(representation_item, shapes);
+					} catch (...) {}
+					if ( converted ) {
+						part_succes |= true;
+						continue;
+					}
+				}
 				part_succes |= convert_shapes(*it, shapes);
 			} else {
+				if ( direct_extrusion_meshes && representation_item->is(IfcSchema::Type::IfcExtrudedAreaSolid) ) {
+					SHARED_PTR<PolygonalExtrusion> extrusion(new PolygonalExtrusion);
+					bool converted = false;
+					try {
+						converted = convert_polygonal_extrusion((IfcSchema::IfcExtrudedAreaSolid*) representation_item, *extrusion);
+					} catch (...) {}
+					if ( converted ) {
+						shapes.push_back(IfcRepresentationShapeItem(SHARED_PTR<const PolygonalExtrusion>(extrusion), get_style(representation_item)));
+						part_succes |= true;
+						continue;
+					}
+				}
 				TopoDS_Shape s;
 				if (convert_shape(representation_item,s)) {
 					shapes.push_back(IfcRepresentationShapeItem(s, get_style(representation_item)));
@@ -783,11 +1321,7 @@ bool IfcGeom::Kernel::convert(const IfcSchema::IfcSweptDiskSolid* l, TopoDS_Shap
 		if (brep_cut.IsDone()) {
 			TopoDS_Shape result = brep_cut;
 
-			ShapeFix_Shape fix(result);
-			fix.Perform();
-			result = fix.Shape();
-		
-			is_valid = BRepCheck_Analyzer(result).IsValid() != 0;
+			is_valid = is_valid_result(result, shape, true, l);
 			if (is_valid) {
 				shape = result;
 			}
@@ -0,0 +1,127 @@
+/********************************************************************************
+ *                                                                              *
+ * This file is part of IfcOpenShell.                                           *
+ *                                                                              *
+ * IfcOpenShell is free software: you can redistribute it and/or modify         *
+ * it under the terms of the Lesser GNU General Public License as published by  *
+ * the Free Software Foundation, either version 3.0 of the License, or          *
+ * (at your option) any later version.                                          *
+ *                                                                              *
+ * IfcOpenShell is distributed in the hope that it will be useful,              *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of               *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                 *
+ * Lesser GNU General Public License for more details.                          *
+ *                                                                              *
+ * You should have received a copy of the Lesser GNU General Public License     *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.         *
+ *                                                                              *
+ ********************************************************************************/
+
+#ifndef IFCGEOMVERTEXINDEXMAP_H
+#define IFCGEOMVERTEXINDEXMAP_H
+
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+
+namespace IfcGeom {
+
+	// An open addressing hash table with linear probing that maps a key of
+	// N values to a non-negative integer. Keys are compared by value, hence
+	// negative zero needs to be normalized by the caller.
+	template <typename T, size_t N>
+	class KeyIndexMap {
+	private:
+		struct Slot {
+			T key[N];
+			int value;
+		};
+		std::vector<Slot> slots;
+		size_t count;
+		static size_t hash(const T* key) {
+			// FNV-1a over the bytes of the key
+			size_t h = 2166136261u;
+			const unsigned char* c = (const unsigned char*) key;
+			for (size_t i = 0; i < N * sizeof(T); ++i) {
+				h = (h ^ c[i]) * 16777619u;
+			}
+			return h;
+		}
+		size_t locate(const T* key) const {
+			size_t i = hash(key) & (slots.size() - 1);
+			while (slots[i].value != -1 && !std::equal(key, key + N, slots[i].key)) {
+				i = (i + 1) & (slots.size() - 1);
+			}
+			return i;
+		}
+		void grow() {
+			std::vector<Slot> old;
+			old.swap(slots);
+			Slot empty;
+			empty.value = -1;
+			slots.resize(old.empty() ? 64 : old.size() * 2, empty);
+			for (typename std::vector<Slot>::const_iterator it = old.begin(); it != old.end(); ++it) {
+				if (it->value != -1) slots[locate(it->key)] = *it;
+			}
+		}
+	public:
+		KeyIndexMap() : count(0) {}
+		// Returns the value stored for the key, or -1 if there is none
+		int find(const T* key) const {
+			return slots.empty() ? -1 : slots[locate(key)].value;
+		}
+		// Returns the value stored for the key if any, otherwise
+		// stores the value provided and returns that
+		int insert(const T* key, int value) {
+			if (2 * (count + 1) > slots.size()) {
+				grow();
+			}
+			Slot& slot = slots[locate(key)];
+			if (slot.value == -1) {
+				std::copy(key, key + N, slot.key);
+				slot.value = value;
+				++ count;
+			}
+			return slot.value;
+		}
+		// Stores the value for the key, replacing the previous value if any
+		void set(const T* key, int value) {
+			const int existing = insert(key, value);
+			if (existing != value) slots[locate(key)].value = value;
+		}
+		size_t size() const { return count; }
+	};
+
+	// Maps the material index and the coordinates of a vertex to its index,
+	// with a table of coordinates for every material. Vertices are only
+	// welded when their coordinates are equal.
+	template <typename P>
+	class VertexIndexMap {
+	private:
+		// By the material index plus one, as vertices without a material have index -1
+		std::vector< KeyIndexMap<P, 3> > materials;
+	public:
+		// Returns the index of an equal vertex if any, otherwise
+		// stores the vertex with the index provided and returns that
+		int insert(int material, P x, P y, P z, int index) {
+			const size_t m = (size_t) (material + 1);
+			if (m >= materials.size()) {
+				materials.resize(m + 1);
+			}
+			// Adding zero normalizes negative zero, which compares
+			// equal to positive zero, but has a different representation
+			const P xyz[3] = {x + P(0), y + P(0), z + P(0)};
+			return materials[m].insert(xyz, index);
+		}
+		size_t size() const {
+			size_t count = 0;
+			for (typename std::vector< KeyIndexMap<P, 3> >::const_iterator it = materials.begin(); it != materials.end(); ++it) {
+				count += it->size();
+			}
+			return count;
+		}
+	};
+
+}
+
+#endif
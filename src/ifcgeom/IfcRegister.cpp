@@ -17,6 +17,8 @@
 *                                                                              *
 ********************************************************************************/
 
+#include <BRepBuilderAPI_Copy.hxx>
+
 #include "IfcGeom.h"
 
 using namespace IfcSchema;
@@ -37,20 +39,96 @@ bool IfcGeom::Kernel::convert_shape(const IfcBaseClass* l, TopoDS_Shape& r) {
 	const unsigned int id = l->entity->id();
 	bool success = false;
 	bool processed = false;
-	std::map<int,TopoDS_Shape>::const_iterator it = cache.Shape.find(id);
-	if ( it != cache.Shape.end() ) { r = it->second; return true; }
+	// When a shared cache is used, shapes are only stored there, so that
+	// they are not kept alive by the private cache of the kernel as well.
+	// Failures are cached as null shapes, so that they are not repeated.
+	if ( shared_cache ? shared_cache->find_shape(id, r) : cache.Shape.find(id, r) ) {
+		return !r.IsNull();
+	}
 #include "IfcRegisterConvertShape.h"
 	if ( processed ) { 
 		const double precision = getValue(GV_PRECISION);
 		apply_tolerance(r, precision);
-		cache.Shape[id] = r;
+		const TopoDS_Shape cached = success ? r : TopoDS_Shape();
+		if ( shared_cache ) {
+			shared_cache->insert_shape(id, cached, mapped_item_depth > 0);
+		} else {
+			cache.Shape.insert(id, cached, mapped_item_depth > 0);
+		}
 	} else {
 		Logger::Message(Logger::LOG_ERROR,"No operation defined for:",l->entity);
 	}
 	return success;
 }
 
+namespace {
+	// Appends the value of the argument, with instance references replaced
+	// by the values of the referenced instance
+	void append_value_key(std::stringstream& ss, Argument* arg) {
+		if ( arg->isNull() ) {
+			ss << "$";
+		} else if ( arg->type() == Argument_ENTITY ) {
+			IfcBaseClass* instance = *arg;
+			ss << IfcSchema::Type::ToString(instance->type()) << "(";
+			for ( unsigned int i = 0; i < instance->getArgumentCount(); ++ i ) {
+				if ( i ) ss << ",";
+				append_value_key(ss, instance->getArgument(i));
+			}
+			ss << ")";
+		} else {
+			ss << arg->toString();
+		}
+	}
+
+	// A key that is equal for parameterized profiles of which all attributes,
+	// including the ProfileName, are equal
+	std::string parameterized_profile_key(const IfcSchema::IfcParameterizedProfileDef* l) {
+		std::stringstream ss;
+		ss << IfcSchema::Type::ToString(l->type()) << "(";
+		for ( unsigned int i = 0; i < l->getArgumentCount(); ++ i ) {
+			if ( i ) ss << ",";
+			append_value_key(ss, l->getArgument(i));
+		}
+		ss << ")";
+		return ss.str();
+	}
+}
+
+bool IfcGeom::Kernel::find_profile(int key, TopoDS_Shape& result) {
+	TopoDS_Shape cached;
+	const bool found = shared_cache ? shared_cache->find_shape(key, cached) : cache.Shape.find(key, cached);
+	if ( !found || cached.IsNull() ) return false;
+	result = BRepBuilderAPI_Copy(cached).Shape();
+	return true;
+}
+
+void IfcGeom::Kernel::insert_profile(int key, const TopoDS_Shape& profile) {
+	if ( shared_cache ) {
+		// The shared cache stores a copy itself
+		shared_cache->insert_shape(key, profile);
+	} else {
+		cache.Shape.insert(key, BRepBuilderAPI_Copy(profile).Shape());
+	}
+}
+
 bool IfcGeom::Kernel::convert_wire(const IfcBaseClass* l, TopoDS_Wire& r) {
+	if ( ! l->is(IfcSchema::Type::IfcProfileDef) ) {
+		return convert_wire_uncached(l, r);
+	}
+	const int id = l->entity->id();
+	TopoDS_Shape wire;
+	if ( find_profile(-id, wire) && wire.ShapeType() == TopAbs_WIRE ) {
+		++ cache.profile_hits;
+		r = TopoDS::Wire(wire);
+		return true;
+	}
+	++ cache.profile_misses;
+	const bool success = convert_wire_uncached(l, r);
+	if ( success ) insert_profile(-id, r);
+	return success;
+}
+
+bool IfcGeom::Kernel::convert_wire_uncached(const IfcBaseClass* l, TopoDS_Wire& r) {
 #include "IfcRegisterConvertWire.h"
 	Handle(Geom_Curve) curve;
 	if (IfcGeom::Kernel::convert_curve(l, curve)) {
@@ -61,6 +139,36 @@ bool IfcGeom::Kernel::convert_wire(const IfcBaseClass* l, TopoDS_Wire& r) {
 }
 
 bool IfcGeom::Kernel::convert_face(const IfcBaseClass* l, TopoDS_Shape& r) {
+	if ( ! l->is(IfcSchema::Type::IfcProfileDef) ) {
+		return convert_face_uncached(l, r);
+	}
+	const int id = l->entity->id();
+	if ( find_profile(id, r) ) {
+		++ cache.profile_hits;
+		return true;
+	}
+	std::string key;
+	if ( l->is(IfcSchema::Type::IfcParameterizedProfileDef) ) {
+		key = parameterized_profile_key((const IfcSchema::IfcParameterizedProfileDef*) l);
+		std::map<std::string, int>::const_iterator it = cache.ParameterizedProfile.find(key);
+		// The face of the equal profile may have been evicted in the meantime
+		if ( it != cache.ParameterizedProfile.end() && find_profile(it->second, r) ) {
+			++ cache.profile_hits;
+			return true;
+		}
+	}
+	++ cache.profile_misses;
+	const bool success = convert_face_uncached(l, r);
+	if ( success ) {
+		insert_profile(id, r);
+		if ( !key.empty() && (cache.ParameterizedProfile.size() < Cache::MAX_PARAMETERIZED_PROFILES || cache.ParameterizedProfile.count(key)) ) {
+			cache.ParameterizedProfile[key] = id;
+		}
+	}
+	return success;
+}
+
+bool IfcGeom::Kernel::convert_face_uncached(const IfcBaseClass* l, TopoDS_Shape& r) {
 #include "IfcRegisterConvertFace.h"
 	Logger::Message(Logger::LOG_ERROR,"No operation defined for:",l->entity);
 	return false;
@@ -20,18 +20,52 @@
 #ifndef IFCSHAPELIST_H
 #define IFCSHAPELIST_H
 
+#include <vector>
+
 #include <gp_GTrsf.hxx>
+#include <gp_XYZ.hxx>
+#include <gp_Dir.hxx>
+#include <gp_Vec.hxx>
 #include <TopoDS_Shape.hxx>
 
+#include "../ifcparse/SharedPointer.h"
 #include "../ifcgeom/IfcGeomRenderStyles.h"
 
 namespace IfcGeom {	
+	// The extrusion of a polygonal profile, which is triangulated directly
+	// instead of being created as a topological shape first. The boundaries
+	// of the profile are defined in the coordinate system of the item, the
+	// outer boundary first and oriented counter-clockwise about the normal,
+	// which points to the side of the extrusion, followed by the clockwise
+	// holes. The triangles of the profile index the concatenated boundaries.
+	struct PolygonalExtrusion {
+		std::vector< std::vector<gp_XYZ> > loops;
+		std::vector<int> triangles;
+		gp_Dir normal;
+		gp_Vec extrusion;
+	};
+
+	// A planar face of which the boundaries and triangles are defined in the
+	// same way as the profile of a PolygonalExtrusion.
+	struct PolygonalFace {
+		std::vector< std::vector<gp_XYZ> > loops;
+		std::vector<int> triangles;
+		gp_Dir normal;
+	};
+	typedef std::vector<PolygonalFace> PolygonalFaceSet;
+
 	class IfcRepresentationShapeItem {
 	private:
 		gp_GTrsf placement;
 		TopoDS_Shape shape;
 		const SurfaceStyle* style;
+		SHARED_PTR<const PolygonalExtrusion> extrusion;
+		SHARED_PTR<const PolygonalFaceSet> face_set;
 	public:
+		IfcRepresentationShapeItem(const SHARED_PTR<const PolygonalExtrusion>& extrusion, const SurfaceStyle* style)
+			: style(style), extrusion(extrusion) {}
+		IfcRepresentationShapeItem(const SHARED_PTR<const PolygonalFaceSet>& face_set, const SurfaceStyle* style)
+			: style(style), face_set(face_set) {}
 		IfcRepresentationShapeItem(const gp_GTrsf& placement, const TopoDS_Shape& shape, const SurfaceStyle* style)
 			: placement(placement), shape(shape), style(style) {}
 		IfcRepresentationShapeItem(const gp_GTrsf& placement, const TopoDS_Shape& shape)
@@ -46,6 +80,11 @@ namespace IfcGeom {
 		const gp_GTrsf& Placement() const { return placement; }
 		bool hasStyle() const { return style != 0; }
 		const SurfaceStyle& Style() const { return *style; }
+		// Items with an extrusion or a face set have a null shape
+		bool hasExtrusion() const { return !!extrusion; }
+		const PolygonalExtrusion& Extrusion() const { return *extrusion; }
+		bool hasFaceSet() const { return !!face_set; }
+		const PolygonalFaceSet& FaceSet() const { return *face_set; }
 	};
 	typedef std::vector<IfcRepresentationShapeItem> IfcRepresentationShapeItems;
 }
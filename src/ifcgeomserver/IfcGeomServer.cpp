@@ -24,6 +24,7 @@
  *                                                                              *
  ********************************************************************************/
 
+#include <set>
 #include <iostream>
 #include <boost/cstdint.hpp>
 
@@ -109,6 +110,8 @@ const int32_t NEXT      = MORE      + 1;
 const int32_t BYE       = NEXT      + 1;
 const int32_t GET_LOG   = BYE       + 1;
 const int32_t LOG       = GET_LOG   + 1;
+const int32_t SETTING   = LOG       + 1;
+const int32_t INSTANCE  = SETTING   + 1;
 
 class Hello : public Command {
 private:
@@ -184,26 +187,51 @@ public:
 	WriteLog(const std::string& str) : Command(LOG), str(str) {};
 };
 
+class Setting : public Command {
+private:
+	int32_t id;
+	int32_t value;
+protected:
+	void read_content(std::istream& s) {
+		id = sread<int32_t>(s);
+		value = sread<int32_t>(s);
+	}
+	void write_content(std::ostream& s) {
+		swrite(s, id);
+		swrite(s, value);
+	}
+public:
+	int32_t setting() const { return id; }
+	bool enabled() const { return value != 0; }
+	Setting() : Command(SETTING) {};
+};
+
+// The attributes of the element and the id of its geometry, which are sent
+// both for entities that are accompanied by a mesh and for instances
+void write_element(std::ostream& s, const IfcGeom::TriangulationElement<float>* geom) {
+	swrite<int32_t>(s, geom->id());
+	swrite(s, geom->guid());
+	swrite(s, geom->name());
+	swrite(s, geom->type());
+	swrite<int32_t>(s, geom->parent_id());
+	const std::vector<float>& m = geom->transformation().matrix().data();
+	const float matrix_array[16] = {
+		m[0], m[3], m[6], m[ 9],
+		m[1], m[4], m[7], m[10],
+		m[2], m[5], m[8], m[11],
+		   0,    0,    0,     1
+	};
+	swrite(s, std::string((char*)matrix_array, 16 * sizeof(float)));
+	swrite<int32_t>(s, geom->geometry().id());
+}
+
 class Entity : public Command {
 private:
 	const IfcGeom::TriangulationElement<float>* geom;
 protected:
 	void read_content(std::istream& s) {}
 	void write_content(std::ostream& s) {
-		swrite<int32_t>(s, geom->id());
-		swrite(s, geom->guid());
-		swrite(s, geom->name());
-		swrite(s, geom->type());
-		swrite<int32_t>(s, geom->parent_id());
-		const std::vector<float>& m = geom->transformation().matrix().data();
-		const float matrix_array[16] = {
-			m[0], m[3], m[6], m[ 9],
-			m[1], m[4], m[7], m[10],
-			m[2], m[5], m[8], m[11],
-			   0,    0,    0,     1
-		};
-		swrite(s, std::string((char*)matrix_array, 16 * sizeof(float)));
-		swrite<int32_t>(s, geom->geometry().id());
+		write_element(s, geom);
 		swrite(s, std::string((char*)geom->geometry().verts().data(), geom->geometry().verts().size() * sizeof(float)));
 		swrite(s, std::string((char*)geom->geometry().normals().data(), geom->geometry().normals().size() * sizeof(float)));
 		{ std::vector<int32_t> indices;
@@ -241,6 +269,20 @@ public:
 	Entity(const IfcGeom::TriangulationElement<float>* geom) : Command(ENTITY), geom(geom) {};
 };
 
+// Sent instead of an Entity for an element that shares the geometry of an
+// IfcRepresentationMap of which the mesh has been sent before
+class Instance : public Command {
+private:
+	const IfcGeom::TriangulationElement<float>* geom;
+protected:
+	void read_content(std::istream& s) {}
+	void write_content(std::ostream& s) {
+		write_element(s, geom);
+	}
+public:
+	Instance(const IfcGeom::TriangulationElement<float>* geom) : Command(INSTANCE), geom(geom) {};
+};
+
 class Next : public Command {
 protected:
 	void read_content(std::istream& s) {}
@@ -280,6 +322,16 @@ int main (int argc, char** argv) {
 
 	IfcGeom::Iterator<float>* iterator = 0;
 
+	// Can be changed by Setting messages prior to sending the model
+	IfcGeom::IteratorSettings settings;
+	settings.use_world_coords() = false;
+	settings.weld_vertices() = false;
+	settings.convert_back_units() = true;
+	settings.force_ccw_face_orientation() = true;
+
+	// The ids of the IfcRepresentationMaps of which the mesh has been sent
+	std::set<int> sent_geometries;
+
 	Hello().write(std::cout);
 
 	int exit_code = 0;
@@ -292,12 +344,7 @@ int main (int argc, char** argv) {
 			char* data = new char[len];
 			memcpy(data, m.string().c_str(), len);
 
-			IfcGeom::IteratorSettings settings;
-			settings.use_world_coords() = false;
-			settings.weld_vertices() = false;
-			settings.convert_back_units() = true;
-			settings.force_ccw_face_orientation() = true;
-
+			sent_geometries.clear();
 			iterator = new IfcGeom::Iterator<float>(settings, data, len);
 			has_more = iterator->findContext();
 
@@ -311,7 +358,22 @@ int main (int argc, char** argv) {
 				break;
 			}
 			const IfcGeom::TriangulationElement<float>* geom = static_cast<const IfcGeom::TriangulationElement<float>*>(iterator->get());
-			Entity(geom).write(std::cout);
+			if (geom->is_instance() && !sent_geometries.insert(geom->geometry().id()).second) {
+				Instance(geom).write(std::cout);
+			} else {
+				Entity(geom).write(std::cout);
+			}
+			continue;
+		}
+		case SETTING: {
+			// Settings are applied to subsequent models, there is no reply
+			Setting s; s.read(std::cin);
+			try {
+				settings.set(s.setting(), s.enabled());
+			} catch (const IfcParse::IfcException&) {
+				exit_code = 1;
+				break;
+			}
 			continue;
 		}
 		case NEXT: {
@@ -116,6 +116,8 @@ class file(object):
 		return [entity_instance(e) for e in self.wrapped_data.traverse(inst.wrapped_data)]
 	def remove(self, inst):
 		return self.wrapped_data.remove(inst.wrapped_data)
+	def remove_many(self, insts):
+		return self.wrapped_data.remove_many([inst.wrapped_data for inst in insts])
 	def __iter__(self):
 		return iter(self[id] for id in self.wrapped_data.entity_names())
 
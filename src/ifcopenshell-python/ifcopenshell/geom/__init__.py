@@ -72,6 +72,12 @@ def create_shape(settings, inst):
     return wrap_shape_creation(settings, ifcopenshell_wrapper.create_shape(settings, inst.wrapped_data))
 
 
+# Shapes created by create_shape() are cached for the file they belong to.
+# Call this function after modifying the geometry of the file.
+def clear_shape_cache(f):
+    ifcopenshell_wrapper.clear_shape_cache(f.wrapped_data)
+
+
 def iterate(settings, filename):
     it = iterator(settings, filename)
     if it.findContext():
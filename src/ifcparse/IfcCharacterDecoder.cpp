@@ -27,11 +27,16 @@
 #include <string>
 #include <sstream>
 #include <iomanip>
+#include <cstring>
 
 #include "../ifcparse/IfcCharacterDecoder.h"
 #include "../ifcparse/IfcException.h"
 #include "../ifcparse/IfcSpfStream.h"
 
+#ifdef HAVE_ICU
+#include "unicode/utf8.h"
+#endif
+
 #define FIRST_SOLIDUS						(1 << 1)
 #define PAGE								(1 << 2)
 #define ALPHABET							(1 << 3)
@@ -80,21 +85,21 @@ void IfcCharacterDecoder::addChar(std::stringstream& s,const UChar32& ch) {
         extraction_buffer[4] = '\0';
 		s << extraction_buffer;
 	} else {
-		std::stringstream s2;
-		s2 << "\\u" << std::hex << std::setw(4) << std::setfill('0') << (int) ch;
-		s << s2.str();
+		s << "\\u" << std::hex << std::setw(4) << std::setfill('0') << (int) ch << std::dec;
 	}
 #else
-	s.put(substitution_character);
+	s.put(substitution);
 #endif
 }
 IfcCharacterDecoder::IfcCharacterDecoder(IfcParse::IfcSpfStream* f) {
   file = f;
 #ifdef HAVE_ICU
-  if (destination) ucnv_close(destination);
-  if (compatibility_converter) ucnv_close(compatibility_converter);
   destination = 0;
+  converter = 0;
   compatibility_converter = 0;
+  previous_codepage = -1;
+  status = U_ZERO_ERROR;
+  use_compatibility_mode = compatibility_mode;
 
   if (mode == DEFAULT) {
     destination = ucnv_open(0, &status);
@@ -103,10 +108,12 @@ IfcCharacterDecoder::IfcCharacterDecoder(IfcParse::IfcSpfStream* f) {
   } else if (mode == LATIN) {
     destination = ucnv_open("iso-8859-1", &status);
   }
-  if (compatibility_charset.empty()) {
-    compatibility_charset = ucnv_getDefaultName();
+  if (use_compatibility_mode) {
+    const char* charset = compatibility_charset.empty() ? ucnv_getDefaultName() : compatibility_charset.c_str();
+    compatibility_converter = ucnv_open(charset, &status);
   }
-  compatibility_converter = ucnv_open(compatibility_charset.c_str(), &status);
+#else
+  substitution = substitution_character;
 #endif
 }
 IfcCharacterDecoder::~IfcCharacterDecoder() {
@@ -114,12 +121,43 @@ IfcCharacterDecoder::~IfcCharacterDecoder() {
   if ( destination ) ucnv_close(destination);
   if ( converter ) ucnv_close(converter);
   if ( compatibility_converter ) ucnv_close(compatibility_converter);
-  destination = 0;
-  converter = 0;
-  compatibility_converter = 0;
 #endif
 }
+
+// Most strings in IFC files, such as GlobalIds and enumeration-like
+// names, do not contain any escape sequences. This function returns
+// the number of characters up to the closing apostrophe in case the
+// string does not contain control directives, escaped apostrophes or
+// line breaks, so that the string can be copied as is. Otherwise -1 is
+// returned and the string needs to be decoded character by character.
+int IfcCharacterDecoder::plainStringLength() {
+	unsigned int available;
+	const char* begin = file->Buffer(available);
+	const char* end = begin + available;
+	const char* apostrophe = (const char*) memchr(begin, '\'', available);
+	if (!apostrophe || apostrophe + 1 == end) return -1;
+	const char next = *(apostrophe + 1);
+	if (next == '\'' || next == '\r' || next == '\n') return -1;
+	const size_t n = apostrophe - begin;
+	if (memchr(begin, '\\', n) || memchr(begin, '\n', n) || memchr(begin, '\r', n) || memchr(begin, 0, n)) return -1;
+	return (int) n;
+}
+
 IfcCharacterDecoder::operator std::string() {
+	const int plain_length = plainStringLength();
+	if (plain_length >= 0) {
+		unsigned int available;
+		const char* begin = file->Buffer(available);
+		std::string s;
+		s.reserve(plain_length + 2);
+		s.push_back('\'');
+		s.append(begin, plain_length);
+		s.push_back('\'');
+		file->Seek(file->Tell() + plain_length);
+		file->Inc();
+		return s;
+	}
+
 	unsigned int parse_state = 0;
 	std::stringstream s;
 	s.put('\'');
@@ -137,6 +175,7 @@ IfcCharacterDecoder::operator std::string() {
 				if ( converter ) ucnv_close(converter);
 				char encoder[11] = {'i','s','o','-','8','8','5','9','-',codepage + 0x30};
 				converter = ucnv_open(encoder, &status);
+				previous_codepage = codepage;
 			}
 			const char characters[2] = { current_char + 0x80 };
 			const char* char_array = &characters[0];
@@ -184,7 +223,7 @@ IfcCharacterDecoder::operator std::string() {
 				(hex_count == 4 && !(parse_state & EXTENDED4)) ||
 				(hex_count == 8) ) {
 #ifdef HAVE_ICU
-					if (compatibility_mode) {
+					if (use_compatibility_mode) {
 						if (old_hex == 0) {
 							old_hex = hex;
 						} else {
@@ -224,6 +263,13 @@ IfcCharacterDecoder::operator std::string() {
 }
 
 void IfcCharacterDecoder::dryRun() {
+	const int plain_length = plainStringLength();
+	if (plain_length >= 0) {
+		file->Seek(file->Tell() + plain_length);
+		file->Inc();
+		return;
+	}
+
 	unsigned int parse_state = 0;
 	char current_char;
 	unsigned int hex_count = 0;
@@ -279,14 +325,6 @@ void IfcCharacterDecoder::dryRun() {
 		file->Inc();
 	}
 }
-#ifdef HAVE_ICU
-UConverter* IfcCharacterDecoder::destination = 0;
-UConverter* IfcCharacterDecoder::converter = 0;
-UConverter* IfcCharacterDecoder::compatibility_converter = 0;
-int IfcCharacterDecoder::previous_codepage = -1;
-UErrorCode IfcCharacterDecoder::status = U_ZERO_ERROR;
-#endif
-
 #ifdef HAVE_ICU
 IfcCharacterDecoder::ConversionMode IfcCharacterDecoder::mode = IfcCharacterDecoder::JSON;
 
@@ -300,18 +338,10 @@ char IfcCharacterDecoder::substitution_character = '_';
 
 
 IfcCharacterEncoder::IfcCharacterEncoder(const std::string& input) {
-#ifdef HAVE_ICU
-	if ( !converter) converter = ucnv_open("utf-8", &status);
-#endif
 	str = input;
 }
 
-IfcCharacterEncoder::~IfcCharacterEncoder() {
-#ifdef HAVE_ICU
-	if ( !converter) ucnv_close(converter);
-	converter = 0;
-#endif
-}
+IfcCharacterEncoder::~IfcCharacterEncoder() {}
 
 IfcCharacterEncoder::operator std::string() {
 	std::ostringstream oss;
@@ -326,13 +356,17 @@ IfcCharacterEncoder::operator std::string() {
 
 	UChar32 ch;
 
+	// The input is UTF-8 encoded, which is decoded without a converter,
+	// so that strings can be encoded simultaneously from different threads.
 	const char* source = str.c_str();
-	const char* limit = source + str.size();
+	const int32_t length = (int32_t) str.size();
+	int32_t offset = 0;
 	
 	bool in_extended = false;
 
-	while(source < limit) {
-		ch = ucnv_getNextUChar(converter, &source, limit, &status);
+	while(offset < length) {
+		U8_NEXT(source, offset, length, ch);
+		if (ch < 0) ch = 0xFFFD;
 		const bool within_spf_range = ch >= 0x20 && ch <= 0x7e;
 		if ( in_extended && within_spf_range ) {
 			oss << "\\X0\\";
@@ -359,9 +393,3 @@ IfcCharacterEncoder::operator std::string() {
 	oss.put('\'');
 	return oss.str();
 }
-
-
-#ifdef HAVE_ICU
-UErrorCode IfcCharacterEncoder::status = U_ZERO_ERROR;
-UConverter* IfcCharacterEncoder::converter = 0;
-#endif
\ No newline at end of file
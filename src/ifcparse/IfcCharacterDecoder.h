@@ -40,17 +40,11 @@ typedef unsigned int UChar32;
 
 namespace IfcParse {
 
+	/// Decodes the strings in an IFC-SPF file. The conversion state is kept
+	/// per instance, so that multiple files can be decoded simultaneously
+	/// from different threads. The static members below only provide the
+	/// defaults that are read when a decoder is constructed.
 	class IfcCharacterDecoder {
-	private:
-		IfcParse::IfcSpfStream* file;
-#ifdef HAVE_ICU
-		static UConverter* destination;
-		static UConverter* converter;
-		static UConverter* compatibility_converter;
-		static int previous_codepage;
-		static UErrorCode status;
-#endif
-		void addChar(std::stringstream& s,const UChar32& ch);
 	public:
 #ifdef HAVE_ICU
 		enum ConversionMode {DEFAULT,UTF8,LATIN,JSON,PYTHON};
@@ -65,6 +59,24 @@ namespace IfcParse {
 #else
 		static char substitution_character;
 #endif
+	private:
+		IfcParse::IfcSpfStream* file;
+#ifdef HAVE_ICU
+		UConverter* destination;
+		UConverter* converter;
+		UConverter* compatibility_converter;
+		int previous_codepage;
+		UErrorCode status;
+		bool use_compatibility_mode;
+#else
+		char substitution;
+#endif
+		void addChar(std::stringstream& s,const UChar32& ch);
+		int plainStringLength();
+		// Decoders own their converters and can therefore not be copied
+		IfcCharacterDecoder(const IfcCharacterDecoder&);
+		IfcCharacterDecoder& operator=(const IfcCharacterDecoder&);
+	public:
 		IfcCharacterDecoder(IfcParse::IfcSpfStream* file);
 		~IfcCharacterDecoder();
 		void dryRun();
@@ -78,10 +90,6 @@ namespace IfcWrite {
 	class IfcCharacterEncoder {
 	private:
 		std::string str;
-#ifdef HAVE_ICU
-		static UErrorCode status;
-		static UConverter* converter;
-#endif
 	public:
 		IfcCharacterEncoder(const std::string& input);
 		~IfcCharacterEncoder();
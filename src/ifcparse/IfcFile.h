@@ -42,6 +42,9 @@ private:
 	typedef std::map<IfcUtil::IfcBaseClass*, IfcUtil::IfcBaseClass*> entity_entity_map_t;
 
 	bool _create_latebound_entities;
+	IfcStringPool* _string_pool;
+	bool _intern_strings;
+	bool _arguments_loaded;
 
 	entity_by_id_t byid;
 	entities_by_type_t bytype;
@@ -123,6 +126,23 @@ public:
 
 	void removeEntity(IfcUtil::IfcBaseClass* entity);
 
+	/// Removes a collection of instances from the file. This is equivalent
+	/// to calling removeEntity() for every instance in the list, but the
+	/// referring instances are rewritten in a single sweep and the mappings
+	/// by type and by reference are compacted only once.
+	void removeEntities(IfcEntityList::ptr entities);
+
+	/// Merges instances of the specified types that are structurally
+	/// identical, i.e. instances that have equal attribute values and that
+	/// refer to identical instances. References to the duplicates are
+	/// redirected to a single instance and the duplicates are removed from
+	/// the file. Returns the number of instances that have been removed.
+	unsigned int removeDuplicateEntities(const std::set<IfcSchema::Type::Enum>& types);
+
+	/// Merges structurally identical IfcCartesianPoint, IfcDirection,
+	/// IfcAxis2Placement3D and IfcColourRgb instances.
+	unsigned int removeDuplicateEntities();
+
 	const IfcSpfHeader& header() const { return _header; }
 	IfcSpfHeader& header() { return _header; }
 
@@ -130,6 +150,24 @@ public:
 
 	bool create_latebound_entities() const { return _create_latebound_entities; }
 
+	/// Enables or disables the interning of string and enumeration values.
+	/// When enabled, values are decoded once when the arguments of an
+	/// instance are read and later reads return a copy of, or with
+	/// TokenArgument::asStringRef() and IfcParse::stringValue() a reference
+	/// to, the value stored in the pool. Once created, the pool is retained
+	/// until the file is destroyed, so that disabling interning does not
+	/// invalidate the handles that have been handed out before.
+	void intern_strings(bool b);
+	bool intern_strings() const { return _intern_strings; }
+	IfcStringPool* string_pool() { return _intern_strings ? _string_pool : 0; }
+
+	/// Reads the arguments of all instances, which are otherwise read when
+	/// they are first accessed. Afterwards the arguments are accessed
+	/// without locking the lexer, so this is to be called before the
+	/// instances are read from multiple threads.
+	void load_arguments();
+	bool arguments_loaded() const { return _arguments_loaded; }
+
 	std::pair<IfcSchema::IfcNamedUnit*, double> getUnit(IfcSchema::IfcUnitEnum::IfcUnitEnum);
 };
 
@@ -217,6 +217,14 @@ unsigned int IfcSpfStream::Tell() {
 #endif
 }
 
+//
+// Returns the characters in memory from the cursor onwards
+//
+const char* IfcSpfStream::Buffer(unsigned int& available) {
+	available = ptr < len ? len - ptr : 0;
+	return buffer + ptr;
+}
+
 //
 // Increments cursor and reads new chunk if necessary
 //
@@ -325,6 +333,24 @@ Token IfcSpfLexer::Next() {
 // Omits whitespace and comments
 //
 std::string IfcSpfLexer::TokenString(unsigned int offset) {
+#ifndef BUF_SIZE
+	// Without paging the file is kept in memory as a whole and is not
+	// modified after it has been read. Tokens other than strings are then
+	// read without locking the lexer and without moving the cursor.
+	{
+		std::string buffer;
+		unsigned int i = offset;
+		for ( ; i < stream->size; ++i ) {
+			char c = stream->Read(i);
+			if ( buffer.size() && (c == '(' || c == ')' || c == '=' || c == ',' || c == ';' || c == '/') ) break;
+			if ( c == ' ' || c == '\r' || c == '\n' || c == '\t' ) continue;
+			else if ( c == '\'' ) break;
+			else buffer.push_back(c);
+		}
+		if ( i == stream->size || stream->Read(i) != '\'' ) return buffer;
+	}
+#endif
+	boost::recursive_mutex::scoped_lock lock(mutex);
 	const bool was_eof = stream->eof;
 	unsigned int old_offset = stream->Tell();
 	stream->Seek(offset);
@@ -336,7 +362,10 @@ std::string IfcSpfLexer::TokenString(unsigned int offset) {
 		if ( buffer.size() && (c == '(' || c == ')' || c == '=' || c == ',' || c == ';' || c == '/') ) break;
 		stream->Inc();
 		if ( c == ' ' || c == '\r' || c == '\n' || c == '\t' ) continue;
-		else if ( c == '\'' ) return *decoder;
+		else if ( c == '\'' ) {
+			buffer = *decoder;
+			break;
+		}
 		else buffer.push_back(c);
 		p = c;
 	}
@@ -448,14 +477,47 @@ std::string TokenFunc::asString(const Token& t) {
 	return isString(t) || isEnumeration(t) ? str.substr(1,str.size()-2) : str;
 }
 
+IfcStringRef TokenFunc::asStringRef(const Token& t) {
+	if ( isOperator(t,'$') ) return IfcStringRef();
+	else if ( isOperator(t) ) throw IfcException("Token is not a string");
+	IfcStringPool* pool = t.first->file ? t.first->file->string_pool() : 0;
+	if ( !pool ) throw IfcException("String interning is not enabled for this file");
+	return IfcStringRef(pool->intern(asString(t)));
+}
+
+const std::string& IfcStringRef::str() const {
+	static const std::string empty;
+	return value ? *value : empty;
+}
+
+const std::string* IfcStringPool::intern(const std::string& value) {
+	boost::mutex::scoped_lock lock(mutex);
+	return &*values.insert(value).first;
+}
+
 std::string TokenFunc::toString(const Token& t) {
 	if ( isOperator(t) ) return std::string ( (char*) &t.second	, 1 );
 	else return t.first->TokenString(t.second);
 }
 
 
-TokenArgument::TokenArgument(const Token& t) {
+TokenArgument::TokenArgument(const Token& t)
+	: interned(0)
+{
 	token = t;
+	// Strings and enumerations are interned while the arguments are read,
+	// so that later reads neither decode the token nor take a lock
+	IfcStringPool* pool = t.first && t.first->file ? t.first->file->string_pool() : 0;
+	if ( pool && (TokenFunc::isString(t) || TokenFunc::isEnumeration(t)) ) {
+		interned = pool->intern(TokenFunc::asString(t));
+	}
+}
+
+const std::string& IfcParse::stringValue(const Argument* argument, std::string& copy) {
+	const TokenArgument* token_argument = dynamic_cast<const TokenArgument*>(argument);
+	if ( token_argument && token_argument->internedValue() ) return *token_argument->internedValue();
+	copy = static_cast<std::string>(*argument);
+	return copy;
 }
 
 EntityArgument::EntityArgument(const Token& t) {
@@ -642,7 +704,7 @@ IfcUtil::ArgumentType TokenArgument::type() const {
 TokenArgument::operator int() const { return TokenFunc::asInt(token); }
 TokenArgument::operator bool() const { return TokenFunc::asBool(token); }
 TokenArgument::operator double() const { return TokenFunc::asFloat(token); }
-TokenArgument::operator std::string() const { return TokenFunc::asString(token); }
+TokenArgument::operator std::string() const { return interned ? *interned : TokenFunc::asString(token); }
 TokenArgument::operator std::vector<double>() const { throw IfcException("Argument is not a list of floats"); }
 TokenArgument::operator std::vector<int>() const { throw IfcException("Argument is not a list of ints"); }
 TokenArgument::operator std::vector<std::string>() const { throw IfcException("Argument is not a list of strings"); }
@@ -713,25 +775,34 @@ Entity::Entity(unsigned int i, IfcFile* f, unsigned int o) { // : file(f) {
 // Access the Nth argument from the ArgumentList
 //
 Argument* Entity::getArgument(unsigned int i) {
-	if ( ! args ) {
-		std::vector<unsigned int> ids;
-		Load(ids, true);
-	}
-	return (*args)[i];
+	return (*arguments())[i];
 }
 
 unsigned int Entity::getArgumentCount() const {
+	return arguments()->size();
+}
+
+//
+// Returns the ArgumentList, reading it first if necessary. Until the
+// arguments of all instances have been read by IfcFile::load_arguments(),
+// the lexer is locked on every access, not only when the list is read,
+// because the pointer may be assigned by another thread at the same time.
+//
+ArgumentList* Entity::arguments() const {
+	if ( file->arguments_loaded() && args ) return args;
+	boost::recursive_mutex::scoped_lock lock(file->tokens->mutex);
 	if ( ! args ) {
 		std::vector<unsigned int> ids;
 		Load(ids, true);
 	}
-	return args->size();
+	return args;
 }
 
 //
 // Load the ArgumentList
 //
 void Entity::Load(std::vector<unsigned int>& ids, bool seek) const {
+	boost::recursive_mutex::scoped_lock lock(file->tokens->mutex);
 	if ( seek ) {
 		file->tokens->stream->Seek(offset);
 		Token datatype = file->tokens->Next();
@@ -739,8 +810,10 @@ void Entity::Load(std::vector<unsigned int>& ids, bool seek) const {
 		_type = IfcSchema::Type::FromString(TokenFunc::asString(datatype));
 	}
 	Token open = file->tokens->Next();
-	args = new ArgumentList();
-	args->read(file->tokens, ids);
+	// The list is assigned once it is complete
+	ArgumentList* list = new ArgumentList();
+	list->read(file->tokens, ids);
+	args = list;
 	unsigned int old_offset = file->tokens->stream->Tell();
 	Token semilocon = file->tokens->Next();
 	if ( ! TokenFunc::isOperator(semilocon,';') ) file->tokens->stream->Seek(old_offset);
@@ -762,10 +835,7 @@ std::string Entity::datatype() const {
 // Note that this initializes the entity if it is not initialized
 //
 std::string Entity::toString(bool upper) const {
-	if (!args) {
-		std::vector<unsigned int> ids;
-		Load(ids, true);
-	}
+	const ArgumentList* list = arguments();
 
 	std::stringstream ss;
 	ss.imbue(std::locale::classic());
@@ -779,7 +849,7 @@ std::string Entity::toString(bool upper) const {
 		ss << "#" << _id << "=";
 	}
 
-	ss << dt << args->toString(upper);
+	ss << dt << list->toString(upper);
 
 	return ss.str();
 }
@@ -804,6 +874,9 @@ IfcWrite::IfcWritableEntity* Entity::isWritable() {
 
 IfcFile::IfcFile(bool create_latebound_entities)
 	: _create_latebound_entities(create_latebound_entities)
+	, _string_pool(0)
+	, _intern_strings(false)
+	, _arguments_loaded(false)
 	, stream(0)
 	, lastId(0)
 	, tokens(0)
@@ -1266,6 +1339,380 @@ void IfcFile::removeEntity(IfcUtil::IfcBaseClass* entity) {
 	delete entity;
 }
 
+namespace IfcParse {
+	// A predicate that tests instances against a bitmap indexed by their
+	// ENTITY_INSTANCE_NAME. Simple types, which are not referenced by
+	// name, are never considered to be marked.
+	class marked_by_id {
+		const std::vector<bool>& marked;
+	public:
+		marked_by_id(const std::vector<bool>& m) : marked(m) {}
+		bool operator()(IfcUtil::IfcBaseClass* instance) const {
+			if (IfcSchema::Type::IsSimple(instance->type())) return false;
+			const unsigned id = instance->entity->id();
+			return id < marked.size() && marked[id];
+		}
+	};
+}
+
+void IfcFile::removeEntities(IfcEntityList::ptr entities) {
+	if (!entities || entities->size() == 0 || byid.empty()) return;
+
+	// See the remark on weak relations in IfcFile::removeEntity()
+	std::set<IfcSchema::Type::Enum> weak_roots;
+
+	std::vector<bool> marked(byid.rbegin()->first + 1, false);
+	const marked_by_id is_marked(marked);
+
+	std::vector<IfcUtil::IfcBaseClass*> victims;
+	victims.reserve(entities->size());
+
+	for (IfcEntityList::it it = entities->begin(); it != entities->end(); ++it) {
+		IfcUtil::IfcBaseClass* entity = *it;
+		const unsigned id = entity->entity->id();
+		if (entityById(id) != entity) {
+			throw IfcParse::IfcException("Instance not part of this file");
+		}
+		if (!marked[id]) {
+			marked[id] = true;
+			victims.push_back(entity);
+		}
+	}
+
+	// Forward references that are no longer referenced by instances that
+	// are retained are removed as well. Note that the victims list grows
+	// while it is being iterated over. The remaining forward references
+	// are collected, because their entries in the reference mapping need
+	// to be compacted.
+	std::set<unsigned> forward_references;
+	for (std::vector<IfcUtil::IfcBaseClass*>::size_type i = 0; i < victims.size(); ++i) {
+		IfcUtil::IfcBaseClass* entity = victims[i];
+		IfcEntityList::ptr entity_attributes = traverse(entity, 1);
+		for (IfcEntityList::it it = entity_attributes->begin(); it != entity_attributes->end(); ++it) {
+			IfcUtil::IfcBaseClass* entity_attribute = *it;
+			if (entity_attribute == entity || IfcSchema::Type::IsSimple(entity_attribute->type())) continue;
+			const unsigned id = entity_attribute->entity->id();
+			if (marked[id]) continue;
+			forward_references.insert(id);
+			IfcEntityList::ptr refs = entitiesByReference(id);
+			if (!refs) continue;
+			refs = refs->filtered(weak_roots);
+			bool retained = false;
+			for (IfcEntityList::it jt = refs->begin(); jt != refs->end(); ++jt) {
+				if (!is_marked(*jt)) {
+					retained = true;
+					break;
+				}
+			}
+			if (!retained) {
+				marked[id] = true;
+				victims.push_back(entity_attribute);
+			}
+		}
+	}
+
+	// Collect the instances that are retained, but that refer to any of
+	// the instances being deleted. Each of them is visited only once.
+	std::vector<bool> visited(marked.size(), false);
+	std::vector<IfcUtil::IfcBaseClass*> referrers;
+	for (std::vector<IfcUtil::IfcBaseClass*>::const_iterator it = victims.begin(); it != victims.end(); ++it) {
+		IfcEntityList::ptr refs = entitiesByReference((*it)->entity->id());
+		if (!refs) continue;
+		for (IfcEntityList::it jt = refs->begin(); jt != refs->end(); ++jt) {
+			const unsigned id = (*jt)->entity->id();
+			if (!marked[id] && !visited[id]) {
+				visited[id] = true;
+				referrers.push_back(*jt);
+			}
+		}
+	}
+
+	// Remove the dangling references from the referring instances. As in
+	// IfcFile::removeEntity() the referring instances are not deleted,
+	// even when they are left with empty aggregates.
+	for (std::vector<IfcUtil::IfcBaseClass*>::const_iterator it = referrers.begin(); it != referrers.end(); ++it) {
+		IfcUtil::IfcBaseEntity* related_instance = (IfcUtil::IfcBaseEntity*) *it;
+		for (unsigned i = 0; i < related_instance->getArgumentCount(); ++i) {
+			Argument* attr = related_instance->getArgument(i);
+			if (attr->isNull()) continue;
+
+			IfcUtil::ArgumentType attr_type = related_instance->getArgumentType(i);
+			switch(attr_type) {
+			case IfcUtil::Argument_ENTITY: {
+				IfcUtil::IfcBaseClass* instance_attribute = *attr;
+				if (is_marked(instance_attribute)) {
+					make_writable(related_instance)->setArgument(i);
+				} }
+				break;
+			case IfcUtil::Argument_ENTITY_LIST: {
+				IfcEntityList::ptr instance_list = *attr;
+				const unsigned size = instance_list->size();
+				instance_list->remove_if(is_marked);
+				if (instance_list->size() != size) {
+					make_writable(related_instance)->setArgument(i, instance_list);
+				} }
+				break;
+			case IfcUtil::Argument_ENTITY_LIST_LIST: {
+				IfcEntityListList::ptr instance_list_list = *attr;
+				IfcEntityListList::ptr new_list(new IfcEntityListList);
+				bool changed = false;
+				for (IfcEntityListList::outer_it jt = instance_list_list->begin(); jt != instance_list_list->end(); ++jt) {
+					std::vector<IfcUtil::IfcBaseClass*> instances = *jt;
+					const std::vector<IfcUtil::IfcBaseClass*>::size_type size = instances.size();
+					instances.erase(std::remove_if(instances.begin(), instances.end(), is_marked), instances.end());
+					changed = changed || instances.size() != size;
+					new_list->push(instances);
+				}
+				if (changed) {
+					make_writable(related_instance)->setArgument(i, new_list);
+				} }
+				break;
+			default: break;
+			}
+		}
+	}
+
+	// Compact the mappings by reference, by type, by GlobalId and by
+	// ENTITY_INSTANCE_NAME. Every list is traversed at most once.
+	for (std::set<unsigned>::const_iterator it = forward_references.begin(); it != forward_references.end(); ++it) {
+		if (marked[*it]) continue;
+		IfcEntityList::ptr refs = entitiesByReference(*it);
+		if (refs) refs->remove_if(is_marked);
+	}
+
+	std::set<IfcSchema::Type::Enum> types;
+	for (std::vector<IfcUtil::IfcBaseClass*>::const_iterator it = victims.begin(); it != victims.end(); ++it) {
+		IfcUtil::IfcBaseClass* entity = *it;
+		const unsigned id = entity->entity->id();
+
+		entities_by_ref_t::iterator jt = byref.find(id);
+		if (jt != byref.end()) {
+			byref.erase(jt);
+		}
+
+		if (entity->is(IfcSchema::Type::IfcRoot)) {
+			entity_by_guid_t::iterator kt = byguid.find(((IfcSchema::IfcRoot*) entity)->GlobalId());
+			if (kt != byguid.end() && kt->second == entity) {
+				byguid.erase(kt);
+			}
+		}
+
+		byid.erase(id);
+
+		IfcSchema::Type::Enum ty = entity->type();
+		do {
+			types.insert(ty);
+			ty = IfcSchema::Type::Parent(ty);
+		} while ( ty > -1 );
+	}
+
+	for (std::set<IfcSchema::Type::Enum>::const_iterator it = types.begin(); it != types.end(); ++it) {
+		IfcEntityList::ptr instances_of_type = entitiesByType(*it);
+		if (instances_of_type) instances_of_type->remove_if(is_marked);
+	}
+
+	for (std::vector<IfcUtil::IfcBaseClass*>::const_iterator it = victims.begin(); it != victims.end(); ++it) {
+		delete (*it)->entity;
+		delete *it;
+	}
+}
+
+typedef std::map<IfcUtil::IfcBaseClass*, IfcUtil::IfcBaseClass*> instance_mapping_t;
+
+// Returns the instance that is structurally identical to the instance
+// passed as an argument and that has been encountered first. Instances
+// referenced by attributes are mapped first, so that the structural key
+// of an instance is computed bottom-up from its canonical attributes.
+static IfcUtil::IfcBaseClass* canonical_instance(IfcUtil::IfcBaseClass* instance, const std::set<IfcSchema::Type::Enum>& types, instance_mapping_t& canonical, std::map<std::string, IfcUtil::IfcBaseClass*>& by_key) {
+	if (IfcSchema::Type::IsSimple(instance->type()) || types.find(instance->type()) == types.end()) {
+		return instance;
+	}
+	instance_mapping_t::const_iterator it = canonical.find(instance);
+	if (it != canonical.end()) {
+		return it->second;
+	}
+
+	std::stringstream key;
+	key << IfcSchema::Type::ToString(instance->type()) << "(";
+	for (unsigned i = 0; i < instance->getArgumentCount(); ++i) {
+		if (i) key << ",";
+		Argument* attr = instance->getArgument(i);
+		if (attr->isNull()) {
+			key << "$";
+			continue;
+		}
+		IfcUtil::ArgumentType attr_type = instance->getArgumentType(i);
+		if (attr_type == IfcUtil::Argument_ENTITY) {
+			IfcUtil::IfcBaseClass* entity_attribute = *attr;
+			if (IfcSchema::Type::IsSimple(entity_attribute->type())) {
+				key << entity_attribute->entity->toString();
+			} else {
+				key << "#" << canonical_instance(entity_attribute, types, canonical, by_key)->entity->id();
+			}
+		} else if (attr_type == IfcUtil::Argument_ENTITY_LIST) {
+			IfcEntityList::ptr entity_list_attribute = *attr;
+			key << "(";
+			for (IfcEntityList::it jt = entity_list_attribute->begin(); jt != entity_list_attribute->end(); ++jt) {
+				if (jt != entity_list_attribute->begin()) key << ",";
+				key << "#" << canonical_instance(*jt, types, canonical, by_key)->entity->id();
+			}
+			key << ")";
+		} else {
+			key << attr->toString();
+		}
+	}
+	key << ")";
+
+	std::map<std::string, IfcUtil::IfcBaseClass*>::const_iterator jt = by_key.find(key.str());
+	IfcUtil::IfcBaseClass* result = instance;
+	if (jt == by_key.end()) {
+		by_key.insert(std::make_pair(key.str(), instance));
+	} else {
+		result = jt->second;
+	}
+	canonical.insert(std::make_pair(instance, result));
+	return result;
+}
+
+unsigned int IfcFile::removeDuplicateEntities(const std::set<IfcSchema::Type::Enum>& types) {
+	instance_mapping_t canonical;
+	std::map<std::string, IfcUtil::IfcBaseClass*> by_key;
+	std::map<IfcSchema::Type::Enum, unsigned int> duplicates_by_type;
+
+	IfcEntityList::ptr duplicates(new IfcEntityList);
+	instance_mapping_t replacements;
+
+	for (std::set<IfcSchema::Type::Enum>::const_iterator it = types.begin(); it != types.end(); ++it) {
+		IfcEntityList::ptr instances = entitiesByType(*it);
+		if (!instances) continue;
+		for (IfcEntityList::it jt = instances->begin(); jt != instances->end(); ++jt) {
+			// Only instances of exactly this type are considered, subtypes
+			// are only merged when they are part of the set themselves.
+			if ((*jt)->type() != *it) continue;
+			IfcUtil::IfcBaseClass* instance = canonical_instance(*jt, types, canonical, by_key);
+			if (instance != *jt) {
+				duplicates->push(*jt);
+				replacements.insert(std::make_pair(*jt, instance));
+				duplicates_by_type[*it] ++;
+			}
+		}
+	}
+
+	if (duplicates->size() == 0) {
+		return 0;
+	}
+
+	// Collect the instances that refer to duplicates and are retained
+	std::set<IfcUtil::IfcBaseClass*> referrers;
+	for (IfcEntityList::it it = duplicates->begin(); it != duplicates->end(); ++it) {
+		const unsigned id = (*it)->entity->id();
+		IfcEntityList::ptr refs = entitiesByReference(id);
+		if (!refs) continue;
+		for (IfcEntityList::it jt = refs->begin(); jt != refs->end(); ++jt) {
+			if (replacements.find(*jt) == replacements.end()) {
+				referrers.insert(*jt);
+			}
+		}
+		// The duplicate will no longer be referenced by any instance
+		// other than other duplicates, which are removed as well.
+		byref.erase(id);
+	}
+
+	// Redirect the references in a single pass over every referring
+	// instance and update the mapping by reference accordingly.
+	for (std::set<IfcUtil::IfcBaseClass*>::const_iterator it = referrers.begin(); it != referrers.end(); ++it) {
+		IfcUtil::IfcBaseEntity* related_instance = (IfcUtil::IfcBaseEntity*) *it;
+		std::set<IfcUtil::IfcBaseClass*> redirected_to;
+		for (unsigned i = 0; i < related_instance->getArgumentCount(); ++i) {
+			Argument* attr = related_instance->getArgument(i);
+			if (attr->isNull()) continue;
+
+			IfcUtil::ArgumentType attr_type = related_instance->getArgumentType(i);
+			switch(attr_type) {
+			case IfcUtil::Argument_ENTITY: {
+				IfcUtil::IfcBaseClass* instance_attribute = *attr;
+				instance_mapping_t::const_iterator jt = replacements.find(instance_attribute);
+				if (jt != replacements.end()) {
+					make_writable(related_instance)->setArgument(i, jt->second);
+					redirected_to.insert(jt->second);
+				} }
+				break;
+			case IfcUtil::Argument_ENTITY_LIST: {
+				IfcEntityList::ptr instance_list = *attr;
+				IfcEntityList::ptr new_list(new IfcEntityList);
+				bool changed = false;
+				for (IfcEntityList::it jt = instance_list->begin(); jt != instance_list->end(); ++jt) {
+					instance_mapping_t::const_iterator kt = replacements.find(*jt);
+					if (kt != replacements.end()) {
+						new_list->push(kt->second);
+						redirected_to.insert(kt->second);
+						changed = true;
+					} else {
+						new_list->push(*jt);
+					}
+				}
+				if (changed) {
+					make_writable(related_instance)->setArgument(i, new_list);
+				} }
+				break;
+			case IfcUtil::Argument_ENTITY_LIST_LIST: {
+				IfcEntityListList::ptr instance_list_list = *attr;
+				IfcEntityListList::ptr new_list(new IfcEntityListList);
+				bool changed = false;
+				for (IfcEntityListList::outer_it jt = instance_list_list->begin(); jt != instance_list_list->end(); ++jt) {
+					std::vector<IfcUtil::IfcBaseClass*> instances = *jt;
+					for (std::vector<IfcUtil::IfcBaseClass*>::iterator kt = instances.begin(); kt != instances.end(); ++kt) {
+						instance_mapping_t::const_iterator lt = replacements.find(*kt);
+						if (lt != replacements.end()) {
+							*kt = lt->second;
+							redirected_to.insert(lt->second);
+							changed = true;
+						}
+					}
+					new_list->push(instances);
+				}
+				if (changed) {
+					make_writable(related_instance)->setArgument(i, new_list);
+				} }
+				break;
+			default: break;
+			}
+		}
+		for (std::set<IfcUtil::IfcBaseClass*>::const_iterator jt = redirected_to.begin(); jt != redirected_to.end(); ++jt) {
+			const unsigned id = (*jt)->entity->id();
+			IfcEntityList::ptr refs = entitiesByReference(id);
+			if (!refs) {
+				refs = IfcEntityList::ptr(new IfcEntityList);
+				byref[id] = refs;
+			}
+			if (!refs->contains(related_instance)) {
+				refs->push(related_instance);
+			}
+		}
+	}
+
+	const unsigned int num_removed = duplicates->size();
+	removeEntities(duplicates);
+
+	std::stringstream ss;
+	ss << "Merged " << num_removed << " duplicate instances:";
+	for (std::map<IfcSchema::Type::Enum, unsigned int>::const_iterator it = duplicates_by_type.begin(); it != duplicates_by_type.end(); ++it) {
+		ss << " " << it->second << " " << IfcSchema::Type::ToString(it->first);
+	}
+	Logger::Message(Logger::LOG_NOTICE, ss.str());
+
+	return num_removed;
+}
+
+unsigned int IfcFile::removeDuplicateEntities() {
+	std::set<IfcSchema::Type::Enum> types;
+	types.insert(IfcSchema::Type::IfcCartesianPoint);
+	types.insert(IfcSchema::Type::IfcDirection);
+	types.insert(IfcSchema::Type::IfcAxis2Placement3D);
+	types.insert(IfcSchema::Type::IfcColourRgb);
+	return removeDuplicateEntities(types);
+}
+
 IfcEntityList::ptr IfcFile::entitiesByType(IfcSchema::Type::Enum t) {
 	entities_by_type_t::const_iterator it = bytype.find(t);
 	return (it == bytype.end()) ? IfcEntityList::ptr() : it->second;
@@ -1311,6 +1758,21 @@ IfcFile::~IfcFile() {
 	}
 	delete stream;
 	delete tokens;
+	delete _string_pool;
+}
+
+void IfcFile::intern_strings(bool b) {
+	if (b && !_string_pool) {
+		_string_pool = new IfcStringPool;
+	}
+	_intern_strings = b;
+}
+
+void IfcFile::load_arguments() {
+	for ( entity_by_id_t::const_iterator it = byid.begin(); it != byid.end(); ++it ) {
+		it->second->entity->getArgumentCount();
+	}
+	_arguments_loaded = true;
 }
 
 IfcFile::entity_by_id_t::const_iterator IfcFile::begin() const {
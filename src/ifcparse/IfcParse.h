@@ -37,6 +37,10 @@
 #include <cstring>
 #include <map>
 
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/recursive_mutex.hpp>
+#include <boost/unordered_set.hpp>
+
 #include "../ifcparse/SharedPointer.h"
 #include "../ifcparse/IfcCharacterDecoder.h"
 #include "../ifcparse/IfcUtil.h"
@@ -54,6 +58,7 @@ namespace IfcParse {
 	class Entity;
 	class IfcFile;
 	class IfcSpfLexer;
+	class IfcStringRef;
 
 	typedef std::pair<IfcSpfLexer*, unsigned> Token;
 
@@ -89,10 +94,61 @@ namespace IfcParse {
 		static double asFloat(const Token& t);
 		/// Returns the token as a string (without the dot or apostrophe)
 		static std::string asString(const Token& t);
+		/// Returns a reference to the token as an interned string (without
+		/// the dot or apostrophe). Requires string interning to be enabled
+		/// on the file, see IfcFile::intern_strings(). Prefer
+		/// TokenArgument::asStringRef(), which does not decode the token.
+		static IfcStringRef asStringRef(const Token& t);
 		/// Returns a string representation of the token (including the dot or apostrophe)
 		static std::string toString(const Token& t);
 	};
 
+	/// A lightweight handle to a string that is owned by the string pool
+	/// of a file. Copying a handle does not allocate memory. Handles remain
+	/// valid as long as the file they have been obtained from exists.
+	class IfcStringRef {
+	private:
+		const std::string* value;
+	public:
+		IfcStringRef() : value(0) {}
+		explicit IfcStringRef(const std::string* v) : value(v) {}
+		const char* data() const { return value ? value->data() : ""; }
+		std::string::size_type size() const { return value ? value->size() : 0; }
+		bool empty() const { return size() == 0; }
+		const std::string& str() const;
+		operator const std::string&() const { return str(); }
+		bool operator==(const IfcStringRef& other) const {
+			return value == other.value || (size() == other.size() && memcmp(data(), other.data(), size()) == 0);
+		}
+		bool operator!=(const IfcStringRef& other) const { return !(*this == other); }
+		bool operator==(const std::string& other) const { return size() == other.size() && memcmp(data(), other.data(), size()) == 0; }
+		bool operator!=(const std::string& other) const { return !(*this == other); }
+	};
+
+	/// Stores the decoded strings and enumeration literals of a file. Every
+	/// distinct value is stored only once, so that repetitive values such
+	/// as names and enumeration literals share their memory. Values are
+	/// interned when the arguments of an instance are read, after which
+	/// they are referred to without accessing the pool.
+	class IfcStringPool {
+	private:
+		// Elements of unordered containers are not moved on rehashing
+		typedef boost::unordered_set<std::string> values_t;
+		values_t values;
+		// Guards the set above, so that instances can be read from
+		// multiple threads
+		mutable boost::mutex mutex;
+	public:
+		/// Returns the pooled copy of the value, which remains valid as
+		/// long as the pool exists
+		const std::string* intern(const std::string& value);
+		/// Returns the number of distinct values in the pool
+		unsigned int size() const {
+			boost::mutex::scoped_lock lock(mutex);
+			return (unsigned int) values.size();
+		}
+	};
+
 	//
 	// Functions for creating Tokens from an arbitary file offset
 	// The first 4 bits are reserved for Tokens of type ()=,;$*
@@ -110,6 +166,9 @@ namespace IfcParse {
 	public:
 		IfcSpfStream* stream;
 		IfcFile* file;
+		/// Guards the cursor of the stream and the state of the character
+		/// decoder, so that instances can be read from multiple threads
+		boost::recursive_mutex mutex;
 		IfcSpfLexer(IfcSpfStream* s, IfcFile* f);
 		Token Next();
 		~IfcSpfLexer();
@@ -154,7 +213,9 @@ namespace IfcParse {
 	///              == ===
 	class TokenArgument : public Argument {
 	private:
-		
+		// The pooled value of a string or enumeration, set when the
+		// argument is read from a file that interns strings
+		const std::string* interned;
 	public: 
 		Token token;
 		TokenArgument(const Token& t);
@@ -175,8 +236,20 @@ namespace IfcParse {
 		Argument* operator [] (unsigned int i) const;
 		std::string toString(bool upper=false) const;
 		bool isNull() const;
+
+		/// Returns the interned string value, see TokenFunc::asStringRef()
+		IfcStringRef asStringRef() const { return interned ? IfcStringRef(interned) : TokenFunc::asStringRef(token); }
+		/// Returns the pooled value of a string or enumeration, or null if
+		/// strings were not interned when the argument was read
+		const std::string* internedValue() const { return interned; }
 	};
 
+	/// Returns the value of a string or enumeration argument. A reference
+	/// to the pooled value is returned if the value is interned, otherwise
+	/// the value is stored in the copy provided, to which a reference is
+	/// returned.
+	const std::string& stringValue(const Argument* argument, std::string& copy);
+
 	/// Argument of an IFC simple type
 	/// #1=IfcTrimmedCurve(#2,(IFCPARAMETERVALUE(0.)),(IFCPARAMETERVALUE(1.)),.T.,.PARAMETER.);
 	///                        =====================   =====================
@@ -212,6 +285,7 @@ namespace IfcParse {
 	private:
 		mutable ArgumentList* args;
 		mutable IfcSchema::Type::Enum _type;
+		ArgumentList* arguments() const;
 	public:
 		/// The EXPRESS ENTITY_INSTANCE_NAME
 		unsigned int _id;
@@ -75,6 +75,9 @@ namespace IfcParse {
 		void Seek(unsigned int offset);
 		/// Returns the cursor position
 		unsigned int Tell();
+		/// Returns a pointer to the character at the cursor and the number
+		/// of characters that can be accessed contiguously from there
+		const char* Buffer(unsigned int& available);
 	};
 }
 
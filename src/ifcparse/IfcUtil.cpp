@@ -20,6 +20,8 @@
 #include <iostream>
 #include <algorithm>
 
+#include <boost/thread/mutex.hpp>
+
 #include "../ifcparse/IfcException.h"
 
 #include "IfcUtil.h"
@@ -69,6 +71,10 @@ unsigned int IfcUtil::IfcBaseType::getArgumentCount() const { return 1; }
 Argument* IfcUtil::IfcBaseType::getArgument(unsigned int i) const { return entity->getArgument(i); }
 const char* IfcUtil::IfcBaseType::getArgumentName(unsigned int i) const { if (i == 0) { return "wrappedValue"; } else { throw IfcParse::IfcException("argument out of range"); } }
 
+// Serializes writes to the log streams, as messages may be emitted by
+// several threads at once when geometry is created in parallel
+static boost::mutex logger_mutex;
+
 void Logger::SetOutput(std::ostream* l1, std::ostream* l2) { 
 	log1 = l1; 
 	log2 = l2; 
@@ -78,12 +84,17 @@ void Logger::SetOutput(std::ostream* l1, std::ostream* l2) {
 }
 void Logger::Message(Logger::Severity type, const std::string& message, IfcAbstractEntity* entity) {
 	if ( log2 && type >= verbosity ) {
+		// The instance is serialized before acquiring the lock, as reading
+		// its attributes may require a lock on the file that is being parsed
+		const std::string instance = entity ? entity->toString() : std::string();
+		boost::mutex::scoped_lock lock(logger_mutex);
 		(*log2) << "[" << severity_strings[type] << "] " << message << std::endl;
-		if ( entity ) (*log2) << entity->toString() << std::endl;
+		if ( entity ) (*log2) << instance << std::endl;
 	}
 }
 void Logger::Status(const std::string& message, bool new_line) {
 	if ( log1 ) {
+		boost::mutex::scoped_lock lock(logger_mutex);
 		(*log1) << message;
 		if ( new_line ) (*log1) << std::endl;
 		else (*log1) << std::flush;
@@ -95,6 +106,7 @@ void Logger::ProgressBar(int progress) {
 	}
 }
 std::string Logger::GetLog() {
+	boost::mutex::scoped_lock lock(logger_mutex);
 	return log_stream.str();
 }
 void Logger::Verbosity(Logger::Severity v) { verbosity = v; }
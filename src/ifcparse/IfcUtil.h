@@ -111,6 +111,11 @@ public:
 		return r;
 	}
 	void remove(IfcUtil::IfcBaseClass*);
+	/// Removes all instances for which the predicate holds in a single pass
+	template <class Pred>
+	void remove_if(Pred p) {
+		ls.erase(std::remove_if(ls.begin(), ls.end(), p), ls.end());
+	}
 	IfcEntityList::ptr filtered(const std::set<IfcSchema::Type::Enum>& entities);
 };
 
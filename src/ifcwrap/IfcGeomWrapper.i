@@ -35,8 +35,16 @@
 %typemap(out) bool& {
 	$result = PyBool_FromLong(static_cast<long>(*$1));
 }
+%typemap(out) int& {
+	$result = SWIG_From_int(*$1);
+}
 
 %include "../ifcgeom/IfcGeomIteratorSettings.h"
+
+// The reference counted geometry is accessed through geometry()
+%ignore IfcGeom::TriangulationElement::geometry_pointer;
+%ignore IfcGeom::SerializedElement::geometry_pointer;
+
 %include "../ifcgeom/IfcGeomElement.h"
 %include "../ifcgeom/IfcGeomMaterial.h"
 %include "../ifcgeom/IfcGeomRepresentation.h"
@@ -94,8 +102,20 @@
 %ignore IfcGeom::Iterator<double>::Iterator(const IfcGeom::IteratorSettings&, std::istream&, int);
 
 %extend IfcGeom::IteratorSettings {
+	void set_num_threads(int n) {
+		$self->num_threads() = n;
+	}
+	void set_shape_cache_budget(int megabytes) {
+		$self->shape_cache_budget() = megabytes;
+	}
+	void set_lod_deflection_tolerances(const std::vector<double>& tolerances) {
+		$self->lod_deflection_tolerances() = tolerances;
+	}
+	void set_validation_policy(int policy) {
+		$self->validation_policy() = policy;
+	}
 	%pythoncode %{
-		attrs = ("convert_back_units", "deflection_tolerance", "disable_opening_subtractions", "disable_triangulation", "faster_booleans", "force_ccw_face_orientation", "sew_shells", "use_brep_data", "use_world_coords", "weld_vertices")
+		attrs = ("convert_back_units", "deflection_tolerance", "direct_extrusion_meshes", "direct_face_set_meshes", "disable_opening_subtractions", "disable_triangulation", "faster_booleans", "force_ccw_face_orientation", "instance_mapped_items", "lod_deflection_tolerances", "num_threads", "parallel_triangulation", "preserve_order", "prismatic_openings", "sew_shells", "shape_cache_budget", "use_brep_data", "use_world_coords", "validation_policy", "volume_diagnostics", "weld_vertices")
 		def __repr__(self):
 			return "%s(%s)"%(self.__class__.__name__, ",".join(tuple("%s=%r"%(a, getattr(self, a)()) for a in self.attrs)))
 	%}
@@ -124,6 +144,8 @@
 			normals = property(normals)
 			material_ids = property(material_ids)
 			materials = property(materials)
+			deflection = property(deflection)
+			levels_of_detail = property(lambda self: [self.level_of_detail(i) for i in range(self.num_levels_of_detail())])
     %}
 };
 
@@ -146,6 +168,7 @@
 			type = property(type)
 			guid = property(guid)
 			transformation = property(transformation)
+			is_instance = property(is_instance)
     %}
 };
 
@@ -197,7 +220,55 @@
     %}
 };
 
+%{
+	// Caches of shapes, placements and styles for files processed with
+	// create_shape(). As the shapes depend on the values of the kernel, such
+	// as the precision and the units, and on the settings that the kernel
+	// reads while converting, a cache is kept for every combination of these.
+	typedef std::pair<IfcParse::IfcFile*, std::vector<double> > shape_cache_key_t;
+	static std::map<shape_cache_key_t, IfcGeom::SharedCache*> shape_caches;
+
+	IfcGeom::SharedCache* shape_cache_for(IfcParse::IfcFile* file, IfcGeom::Kernel& kernel, const IfcGeom::IteratorSettings& settings) {
+		shape_cache_key_t key;
+		key.first = file;
+		for (int v = IfcGeom::Kernel::GV_DEFLECTION_TOLERANCE; v <= IfcGeom::Kernel::GV_PRISMATIC_OPENINGS; ++v) {
+			key.second.push_back(kernel.getValue((IfcGeom::Kernel::GeomValue) v));
+		}
+		key.second.push_back(settings.faster_booleans());
+		key.second.push_back(settings.disable_opening_subtractions());
+		key.second.push_back(settings.direct_extrusion_meshes());
+		key.second.push_back(settings.direct_face_set_meshes());
+		std::map<shape_cache_key_t, IfcGeom::SharedCache*>::const_iterator it = shape_caches.find(key);
+		if (it != shape_caches.end()) {
+			return it->second;
+		}
+		IfcGeom::SharedCache* cache = shape_caches[key] = new IfcGeom::SharedCache;
+		if (settings.shape_cache_budget() > 0) {
+			cache->shape_budget((size_t) settings.shape_cache_budget() * 1024 * 1024);
+		}
+		return cache;
+	}
+
+	void free_shape_caches(IfcParse::IfcFile* file) {
+		std::map<shape_cache_key_t, IfcGeom::SharedCache*>::iterator it = shape_caches.begin();
+		while (it != shape_caches.end()) {
+			if (it->first.first == file) {
+				delete it->second;
+				shape_caches.erase(it++);
+			} else {
+				++it;
+			}
+		}
+	}
+%}
+
 %inline %{
+	// Frees the geometry that is cached for the file by create_shape(). This
+	// needs to be called when the geometry of the file has been modified.
+	void clear_shape_cache(IfcParse::IfcFile* file) {
+		free_shape_caches(file);
+	}
+
 	boost::variant<IfcGeom::Element<double>*, IfcGeom::Representation::Representation*> create_shape(IfcGeom::IteratorSettings& settings, IfcParse::IfcLateBoundEntity* instance) {
 		if (instance->is(IfcSchema::Type::IfcProduct)) {
 			IfcParse::IfcFile* file = instance->entity->file;
@@ -211,6 +282,9 @@
 			IfcGeom::Kernel kernel;
 			kernel.setValue(IfcGeom::Kernel::GV_MAX_FACES_TO_SEW, settings.sew_shells() ? 1000 : -1);
 			kernel.setValue(IfcGeom::Kernel::GV_FORCE_CCW_FACE_ORIENTATION, settings.force_ccw_face_orientation() ? 1 : -1);
+			kernel.setValue(IfcGeom::Kernel::GV_VALIDATION_POLICY, settings.validation_policy());
+			kernel.setValue(IfcGeom::Kernel::GV_VOLUME_DIAGNOSTICS, settings.volume_diagnostics() ? 1 : -1);
+			kernel.setValue(IfcGeom::Kernel::GV_PRISMATIC_OPENINGS, settings.prismatic_openings() ? 1 : -1);
 
 			IfcSchema::IfcProduct* product = (IfcSchema::IfcProduct*) instance;
 
@@ -280,6 +354,10 @@
 			precision *= 10.;
 
 			kernel.setValue(IfcGeom::Kernel::GV_PRECISION, precision);
+
+			// Reuse the shapes created by previous calls for the same file,
+			// once all values that affect the conversion have been set
+			kernel.set_shared_cache(shape_cache_for(file, kernel, settings));
 			
 			IfcGeom::BRepElement<double>* brep = kernel.create_brep_for_representation_and_product<double>(settings, representation, product);
 			if (!brep) {
@@ -40,6 +40,7 @@ namespace IfcUtil {
 %ignore IfcParse::IfcFile::entityByGuid;
 %ignore IfcParse::IfcFile::addEntity;
 %ignore IfcParse::IfcFile::removeEntity;
+%ignore IfcParse::IfcFile::removeDuplicateEntities(const std::set<IfcSchema::Type::Enum>&);
 %ignore IfcParse::IfcFile::traverse(IfcUtil::IfcBaseClass*, int);
 %ignore IfcParse::IfcFile::traverse(IfcUtil::IfcBaseClass*);
 %ignore operator<<;
@@ -48,6 +49,7 @@ namespace IfcUtil {
 %ignore IfcParse::FileName::FileName;
 %ignore IfcParse::FileSchema::FileSchema;
 %ignore IfcParse::IfcFile::tokens;
+%ignore IfcParse::IfcFile::string_pool;
 
 %ignore IfcParse::IfcSpfHeader::IfcSpfHeader(IfcSpfLexer*);
 %ignore IfcParse::IfcSpfHeader::lexer;
@@ -55,6 +57,8 @@ namespace IfcUtil {
 %ignore IfcParse::HeaderEntity::is;
 
 %rename("by_type") entitiesByType;
+%rename("remove_many") removeEntities;
+%rename("remove_duplicates") removeDuplicateEntities;
 %rename("__len__") getArgumentCount;
 %rename("get_argument_type") getArgumentType;
 %rename("get_argument_name") getArgumentName;
@@ -127,8 +131,10 @@ namespace IfcUtil {
 		break;
 		case IfcUtil::Argument_ENUMERATION:
 		case IfcUtil::Argument_STRING: {
-			const std::string s = arg;
-			$result = PyString_FromString(s.c_str());
+			// Interned values are converted without an intermediate copy
+			std::string copy;
+			const std::string& s = IfcParse::stringValue(&arg, copy);
+			$result = PyString_FromStringAndSize(s.data(), s.size());
 		break; }
 		case IfcUtil::Argument_VECTOR_INT: {
 			const std::vector<int> v = arg;
@@ -181,6 +187,10 @@ namespace IfcUtil {
 }
 
 %extend IfcParse::IfcFile {
+	~IfcFile() {
+		free_shape_caches($self);
+		delete $self;
+	}
 	IfcParse::IfcLateBoundEntity* by_id(unsigned id) {
 		return (IfcParse::IfcLateBoundEntity*) $self->entityById(id);
 	}
@@ -19,6 +19,7 @@
 
 %include "std_vector.i"
 %include "std_string.i"
+%include "std_pair.i"
 %include "exception.i"
 
 %exception {
@@ -50,4 +51,6 @@ namespace std {
 	%template(double_vector) vector<double>;
 	%template(string_vector) vector<std::string>;
 	%template(material_vector) vector<IfcGeom::Material>;
+	%template(int_double_pair) pair<int, double>;
+	%template(int_double_pair_vector) vector< pair<int, double> >;
 };
\ No newline at end of file
@@ -0,0 +1,537 @@
+/********************************************************************************
+ *                                                                              *
+ * This file is part of IfcOpenShell.                                           *
+ *                                                                              *
+ * IfcOpenShell is free software: you can redistribute it and/or modify         *
+ * it under the terms of the Lesser GNU General Public License as published by  *
+ * the Free Software Foundation, either version 3.0 of the License, or          *
+ * (at your option) any later version.                                          *
+ *                                                                              *
+ * IfcOpenShell is distributed in the hope that it will be useful,              *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of               *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                 *
+ * Lesser GNU General Public License for more details.                          *
+ *                                                                              *
+ * You should have received a copy of the Lesser GNU General Public License     *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.         *
+ *                                                                              *
+ ********************************************************************************/
+
+/********************************************************************************
+ *                                                                              *
+ * Regression tests for the geometry library. Shapes are created directly with  *
+ * Open Cascade or from small polygons, after which the triangulation and the   *
+ * data structures it depends on are checked. The process returns non-zero when *
+ * any of the checks fails.                                                     *
+ *                                                                              *
+ ********************************************************************************/
+
+#include <cmath>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+
+#include <BRep_Builder.hxx>
+#include <GProp_GProps.hxx>
+#include <BRepGProp.hxx>
+#include <TopExp_Explorer.hxx>
+#include <TopoDS_Compound.hxx>
+#include <BRepAlgoAPI_Cut.hxx>
+#include <BRepPrimAPI_MakeBox.hxx>
+
+#include "../ifcparse/IfcFile.h"
+
+#include "../ifcgeom/IfcGeom.h"
+#include "../ifcgeom/IfcGeomVertexIndexMap.h"
+#include "../ifcgeom/IfcGeomRepresentation.h"
+
+static int failures = 0;
+
+#define CHECK(expr) \
+	if (!(expr)) { \
+		std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #expr << std::endl; \
+		++ failures; \
+	}
+
+static const char* header =
+	"ISO-10303-21;\n"
+	"HEADER;\n"
+	"FILE_DESCRIPTION(('ViewDefinition [CoordinationView]'),'2;1');\n"
+	"FILE_NAME('test.ifc','2014-01-01T00:00:00',(''),(''),'','','');\n"
+	"FILE_SCHEMA(('IFC2X3'));\n"
+	"ENDSEC;\n"
+	"DATA;\n";
+
+static const char* footer =
+	"ENDSEC;\n"
+	"END-ISO-10303-21;\n";
+
+static bool load(IfcParse::IfcFile& file, const std::string& data) {
+	std::stringstream ss;
+	ss << header << data << footer;
+	const std::string s = ss.str();
+	std::istringstream is(s);
+	return file.Init(is, (int) s.size());
+}
+
+static IfcGeom::Representation::Triangulation<double>* triangulate(const IfcGeom::IfcRepresentationShapeItems& items, const IfcGeom::IteratorSettings& settings) {
+	const IfcGeom::ElementSettings element_settings(settings, 1., "IfcBuildingElementProxy");
+	IfcGeom::Representation::BRep brep(element_settings, 1, items);
+	return new IfcGeom::Representation::Triangulation<double>(brep);
+}
+
+// The area of the triangles about the normal, which is negative when any triangle is reversed
+static double triangulated_area(const std::vector< std::vector<gp_XYZ> >& loops, const gp_Dir& normal, const std::vector<int>& indices) {
+	std::vector<gp_XYZ> points;
+	for (std::vector< std::vector<gp_XYZ> >::const_iterator it = loops.begin(); it != loops.end(); ++it) {
+		points.insert(points.end(), it->begin(), it->end());
+	}
+	double area = 0.;
+	for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+		if (indices[i] < 0 || indices[i + 2] >= (int) points.size()) return -1.;
+		const gp_XYZ& a = points[indices[i]];
+		const gp_XYZ& b = points[indices[i + 1]];
+		const gp_XYZ& c = points[indices[i + 2]];
+		const double triangle = ((b - a) ^ (c - a)).Dot(normal.XYZ()) / 2.;
+		if (triangle < 0.) return -1.;
+		area += triangle;
+	}
+	return area;
+}
+
+// The volume enclosed by the triangles, which is only positive when they are oriented outwards
+static double triangulated_volume(const IfcGeom::Representation::Triangulation<double>& triangulation) {
+	const std::vector<double>& verts = triangulation.verts();
+	const std::vector<int>& faces = triangulation.faces();
+	double volume = 0.;
+	for (size_t i = 0; i + 2 < faces.size(); i += 3) {
+		const gp_XYZ a(verts[3 * faces[i]], verts[3 * faces[i] + 1], verts[3 * faces[i] + 2]);
+		const gp_XYZ b(verts[3 * faces[i + 1]], verts[3 * faces[i + 1] + 1], verts[3 * faces[i + 1] + 2]);
+		const gp_XYZ c(verts[3 * faces[i + 2]], verts[3 * faces[i + 2] + 1], verts[3 * faces[i + 2] + 2]);
+		volume += a.Dot(b ^ c) / 6.;
+	}
+	return volume;
+}
+
+static std::vector<gp_XYZ> square(double x, double y, double size, bool ccw) {
+	std::vector<gp_XYZ> loop;
+	loop.push_back(gp_XYZ(x, y, 0.));
+	loop.push_back(gp_XYZ(x + size, y, 0.));
+	loop.push_back(gp_XYZ(x + size, y + size, 0.));
+	loop.push_back(gp_XYZ(x, y + size, 0.));
+	if (!ccw) std::reverse(loop.begin(), loop.end());
+	return loop;
+}
+
+static void test_triangulate_polygon_with_holes() {
+	const gp_Dir normal(0., 0., 1.);
+	std::vector< std::vector<gp_XYZ> > loops;
+	std::vector<int> indices;
+
+	// The holes are accepted in either orientation
+	loops.push_back(square(0., 0., 10., true));
+	loops.push_back(square(2., 2., 2., true));
+	loops.push_back(square(6., 6., 2., false));
+	CHECK(IfcGeom::Representation::triangulate_polygon(loops, normal, indices));
+	// A polygon of n vertices with h holes yields n + 2h - 2 triangles
+	CHECK(indices.size() == (12 + 2 * 2 - 2) * 3);
+	CHECK(std::fabs(triangulated_area(loops, normal, indices) - 92.) < 1.e-9);
+
+	// As is the outer boundary, the triangles are oriented along the normal
+	indices.clear();
+	loops[0] = square(0., 0., 10., false);
+	CHECK(IfcGeom::Representation::triangulate_polygon(loops, normal, indices));
+	CHECK(std::fabs(triangulated_area(loops, normal, indices) - 92.) < 1.e-9);
+
+	// A non-convex outer boundary with a hole in its concave part
+	loops.clear();
+	indices.clear();
+	std::vector<gp_XYZ> l_shape;
+	l_shape.push_back(gp_XYZ(0., 0., 0.));
+	l_shape.push_back(gp_XYZ(10., 0., 0.));
+	l_shape.push_back(gp_XYZ(10., 4., 0.));
+	l_shape.push_back(gp_XYZ(4., 4., 0.));
+	l_shape.push_back(gp_XYZ(4., 10., 0.));
+	l_shape.push_back(gp_XYZ(0., 10., 0.));
+	loops.push_back(l_shape);
+	loops.push_back(square(1., 6., 2., false));
+	CHECK(IfcGeom::Representation::triangulate_polygon(loops, normal, indices));
+	CHECK(indices.size() == (10 + 2 - 2) * 3);
+	CHECK(std::fabs(triangulated_area(loops, normal, indices) - 60.) < 1.e-9);
+
+	// A hole that overlaps the outer boundary cannot be triangulated
+	loops.clear();
+	indices.clear();
+	loops.push_back(square(0., 0., 10., true));
+	loops.push_back(square(8., 4., 4., false));
+	CHECK(!IfcGeom::Representation::triangulate_polygon(loops, normal, indices));
+}
+
+static void test_vertex_index_map() {
+	IfcGeom::VertexIndexMap<double> map;
+	CHECK(map.insert(0, 1., 2., 3., 0) == 0);
+	// An equal vertex of the same material is welded
+	CHECK(map.insert(0, 1., 2., 3., 1) == 0);
+	// But not when it belongs to a different material
+	CHECK(map.insert(1, 1., 2., 3., 1) == 1);
+	CHECK(map.insert(0, 1., 2., 3.000001, 2) == 2);
+	// Negative zero is equal to positive zero
+	CHECK(map.insert(0, 0., -0., 0., 3) == 3);
+	CHECK(map.insert(0, -0., 0., -0., 4) == 3);
+	CHECK(map.size() == 4);
+
+	// Indices are retained when the table grows
+	IfcGeom::VertexIndexMap<float> grid;
+	for (int i = 0; i < 1000; ++i) {
+		CHECK(grid.insert(-1, (float) (i % 10), (float) (i / 10), 0.f, i) == i);
+	}
+	for (int i = 0; i < 1000; ++i) {
+		CHECK(grid.insert(-1, (float) (i % 10), (float) (i / 10), 0.f, 1000 + i) == i);
+	}
+	CHECK(grid.size() == 1000);
+
+	// The underlying table, as used for the edges when sewing faces
+	IfcGeom::KeyIndexMap<int, 2> edges;
+	const int edge[2] = {1, 2};
+	CHECK(edges.find(edge) == -1);
+	CHECK(edges.insert(edge, 5) == 5);
+	CHECK(edges.insert(edge, 6) == 5);
+	edges.set(edge, 7);
+	CHECK(edges.find(edge) == 7);
+	CHECK(edges.size() == 1);
+}
+
+static void test_triangulation_welding() {
+	IfcGeom::IfcRepresentationShapeItems items;
+	items.push_back(IfcGeom::IfcRepresentationShapeItem(BRepPrimAPI_MakeBox(1., 2., 3.).Shape()));
+
+	IfcGeom::IteratorSettings settings;
+	settings.weld_vertices() = true;
+	IfcGeom::Representation::Triangulation<double>* welded = triangulate(items, settings);
+	// The faces of the box share their corners
+	CHECK(welded->verts().size() == 8 * 3);
+	CHECK(welded->faces().size() == 12 * 3);
+	CHECK(welded->normals().empty());
+	for (std::vector<int>::const_iterator it = welded->faces().begin(); it != welded->faces().end(); ++it) {
+		CHECK(*it >= 0 && *it < 8);
+	}
+	delete welded;
+
+	settings.weld_vertices() = false;
+	IfcGeom::Representation::Triangulation<double>* unwelded = triangulate(items, settings);
+	// Every face has its own corners and normals
+	CHECK(unwelded->verts().size() == 6 * 4 * 3);
+	CHECK(unwelded->normals().size() == unwelded->verts().size());
+	CHECK(unwelded->faces().size() == 12 * 3);
+	delete unwelded;
+}
+
+static void test_direct_extrusion_triangulation() {
+	IfcParse::IfcFile file;
+	CHECK(load(file,
+		"#1=IFCCARTESIANPOINT((0.,0.,0.));\n"
+		"#2=IFCDIRECTION((0.,0.,1.));\n"
+		"#3=IFCDIRECTION((1.,0.,0.));\n"
+		"#4=IFCAXIS2PLACEMENT3D(#1,#2,#3);\n"
+		"#5=IFCCARTESIANPOINT((0.,0.));\n"
+		"#6=IFCAXIS2PLACEMENT2D(#5,$);\n"
+		"#7=IFCRECTANGLEPROFILEDEF(.AREA.,$,#6,2.,4.);\n"
+		"#8=IFCEXTRUDEDAREASOLID(#7,#4,#2,3.);\n"
+		"#10=IFCCARTESIANPOINT((0.,0.));\n"
+		"#11=IFCCARTESIANPOINT((10.,0.));\n"
+		"#12=IFCCARTESIANPOINT((10.,10.));\n"
+		"#13=IFCCARTESIANPOINT((0.,10.));\n"
+		"#14=IFCPOLYLINE((#10,#11,#12,#13,#10));\n"
+		"#15=IFCCARTESIANPOINT((4.,4.));\n"
+		"#16=IFCCARTESIANPOINT((6.,4.));\n"
+		"#17=IFCCARTESIANPOINT((6.,6.));\n"
+		"#18=IFCCARTESIANPOINT((4.,6.));\n"
+		"#19=IFCPOLYLINE((#15,#16,#17,#18,#15));\n"
+		"#20=IFCARBITRARYPROFILEDEFWITHVOIDS(.AREA.,$,#14,(#19));\n"
+		"#21=IFCEXTRUDEDAREASOLID(#20,#4,#2,1.);\n"
+		"#22=IFCRECTANGLEPROFILEDEF(.CURVE.,$,#6,2.,4.);\n"
+		"#23=IFCEXTRUDEDAREASOLID(#22,#4,#2,3.);\n"));
+
+	IfcGeom::Kernel kernel;
+	IfcGeom::IteratorSettings settings;
+	settings.weld_vertices() = true;
+
+	SHARED_PTR<IfcGeom::PolygonalExtrusion> box(new IfcGeom::PolygonalExtrusion);
+	CHECK(kernel.convert_polygonal_extrusion((IfcSchema::IfcExtrudedAreaSolid*) file.entityById(8), *box));
+	CHECK(box->loops.size() == 1 && box->triangles.size() == 2 * 3);
+
+	IfcGeom::IfcRepresentationShapeItems items;
+	items.push_back(IfcGeom::IfcRepresentationShapeItem(SHARED_PTR<const IfcGeom::PolygonalExtrusion>(box), 0));
+	IfcGeom::Representation::Triangulation<double>* triangulation = triangulate(items, settings);
+	// Two caps and four sides that share the corners of the box
+	CHECK(triangulation->verts().size() == 8 * 3);
+	CHECK(triangulation->faces().size() == 12 * 3);
+	CHECK(std::fabs(triangulated_volume(*triangulation) - 24.) < 1.e-9);
+	delete triangulation;
+
+	settings.weld_vertices() = false;
+	triangulation = triangulate(items, settings);
+	CHECK(triangulation->verts().size() == 6 * 4 * 3);
+	CHECK(triangulation->normals().size() == triangulation->verts().size());
+	CHECK(std::fabs(triangulated_volume(*triangulation) - 24.) < 1.e-9);
+	delete triangulation;
+
+	// The hole is oriented opposite to the outer boundary, even though it is defined in the same direction
+	SHARED_PTR<IfcGeom::PolygonalExtrusion> slab(new IfcGeom::PolygonalExtrusion);
+	CHECK(kernel.convert_polygonal_extrusion((IfcSchema::IfcExtrudedAreaSolid*) file.entityById(21), *slab));
+	CHECK(slab->loops.size() == 2 && slab->triangles.size() == (8 + 2 - 2) * 3);
+
+	settings.weld_vertices() = true;
+	items.clear();
+	items.push_back(IfcGeom::IfcRepresentationShapeItem(SHARED_PTR<const IfcGeom::PolygonalExtrusion>(slab), 0));
+	triangulation = triangulate(items, settings);
+	CHECK(triangulation->verts().size() == 16 * 3);
+	CHECK(triangulation->faces().size() == (2 * 8 + 8 * 2) * 3);
+	CHECK(std::fabs(triangulated_volume(*triangulation) - 96.) < 1.e-9);
+	delete triangulation;
+
+	// Profiles that do not define an area are left to the regular conversion
+	IfcGeom::PolygonalExtrusion curve;
+	CHECK(!kernel.convert_polygonal_extrusion((IfcSchema::IfcExtrudedAreaSolid*) file.entityById(23), curve));
+}
+
+static void test_polyloop_brep_triangulation() {
+	IfcParse::IfcFile file;
+	// A unit cube of which the top face is defined clockwise, with a bound of reversed orientation
+	CHECK(load(file,
+		"#1=IFCCARTESIANPOINT((0.,0.,0.));\n"
+		"#2=IFCCARTESIANPOINT((1.,0.,0.));\n"
+		"#3=IFCCARTESIANPOINT((1.,1.,0.));\n"
+		"#4=IFCCARTESIANPOINT((0.,1.,0.));\n"
+		"#5=IFCCARTESIANPOINT((0.,0.,1.));\n"
+		"#6=IFCCARTESIANPOINT((1.,0.,1.));\n"
+		"#7=IFCCARTESIANPOINT((1.,1.,1.));\n"
+		"#8=IFCCARTESIANPOINT((0.,1.,1.));\n"
+		"#11=IFCPOLYLOOP((#1,#4,#3,#2));\n"
+		"#12=IFCPOLYLOOP((#8,#7,#6,#5));\n"
+		"#13=IFCPOLYLOOP((#1,#2,#6,#5));\n"
+		"#14=IFCPOLYLOOP((#4,#8,#7,#3));\n"
+		"#15=IFCPOLYLOOP((#1,#5,#8,#4));\n"
+		"#16=IFCPOLYLOOP((#2,#3,#7,#6));\n"
+		"#21=IFCFACEOUTERBOUND(#11,.T.);\n"
+		"#22=IFCFACEOUTERBOUND(#12,.F.);\n"
+		"#23=IFCFACEOUTERBOUND(#13,.T.);\n"
+		"#24=IFCFACEOUTERBOUND(#14,.T.);\n"
+		"#25=IFCFACEOUTERBOUND(#15,.T.);\n"
+		"#26=IFCFACEOUTERBOUND(#16,.T.);\n"
+		"#31=IFCFACE((#21));\n"
+		"#32=IFCFACE((#22));\n"
+		"#33=IFCFACE((#23));\n"
+		"#34=IFCFACE((#24));\n"
+		"#35=IFCFACE((#25));\n"
+		"#36=IFCFACE((#26));\n"
+		"#40=IFCCLOSEDSHELL((#31,#32,#33,#34,#35,#36));\n"
+		"#41=IFCFACETEDBREP(#40);\n"
+		"#50=IFCCARTESIANPOINT((1.,1.,0.5));\n"
+		"#51=IFCPOLYLOOP((#1,#2,#50,#4));\n"
+		"#52=IFCFACEOUTERBOUND(#51,.T.);\n"
+		"#53=IFCFACE((#52));\n"
+		"#54=IFCCLOSEDSHELL((#53));\n"
+		"#55=IFCFACETEDBREP(#54);\n"));
+
+	IfcGeom::Kernel kernel;
+	IfcGeom::IteratorSettings settings;
+	settings.weld_vertices() = true;
+
+	IfcGeom::IfcRepresentationShapeItems items;
+	CHECK(kernel.convert_polygonal_face_sets((IfcSchema::IfcRepresentationItem*) file.entityById(41), items));
+	CHECK(items.size() == 1);
+	if (items.size() != 1) return;
+	CHECK(items[0].hasFaceSet() && items[0].FaceSet().size() == 6);
+
+	IfcGeom::Representation::Triangulation<double>* triangulation = triangulate(items, settings);
+	CHECK(triangulation->verts().size() == 8 * 3);
+	CHECK(triangulation->faces().size() == 12 * 3);
+	CHECK(std::fabs(triangulated_volume(*triangulation) - 1.) < 1.e-9);
+	delete triangulation;
+
+	settings.weld_vertices() = false;
+	triangulation = triangulate(items, settings);
+	CHECK(triangulation->verts().size() == 6 * 4 * 3);
+	CHECK(triangulation->normals().size() == triangulation->verts().size());
+	CHECK(std::fabs(triangulated_volume(*triangulation) - 1.) < 1.e-9);
+	delete triangulation;
+
+	// Non-planar faces are left to the regular conversion
+	IfcGeom::IfcRepresentationShapeItems non_planar;
+	CHECK(!kernel.convert_polygonal_face_sets((IfcSchema::IfcRepresentationItem*) file.entityById(55), non_planar));
+	CHECK(non_planar.empty());
+}
+
+static void test_shape_cache_budget() {
+	IfcGeom::ShapeCache cache;
+	cache.insert(1, BRepPrimAPI_MakeBox(1., 1., 1.).Shape(), true);
+	const size_t pinned = cache.pinned_size_in_bytes();
+	CHECK(pinned > 0);
+	CHECK(cache.size_in_bytes() == 0);
+
+	// Pinned shapes are kept outside of the budget, which leaves room for
+	// one other box of the same size
+	cache.budget(pinned + pinned / 2);
+	cache.insert(2, BRepPrimAPI_MakeBox(2., 1., 1.).Shape());
+	cache.insert(3, BRepPrimAPI_MakeBox(3., 1., 1.).Shape());
+	CHECK(cache.evictions() == 1);
+	CHECK(cache.size() == 2);
+	CHECK(cache.size_in_bytes() <= cache.budget());
+	TopoDS_Shape shape;
+	CHECK(cache.find(1, shape));
+	CHECK(!cache.find(2, shape));
+
+	// An item that is part of a cached compound is evicted after the compound
+	IfcGeom::ShapeCache compounds;
+	{
+		const TopoDS_Shape item = BRepPrimAPI_MakeBox(1., 1., 1.).Shape();
+		TopoDS_Compound compound;
+		BRep_Builder builder;
+		builder.MakeCompound(compound);
+		builder.Add(compound, item);
+		compounds.insert(4, item);
+		compounds.insert(5, compound);
+	}
+	compounds.budget(1);
+	CHECK(compounds.evictions() == 2);
+	CHECK(compounds.size() == 0);
+	CHECK(compounds.size_in_bytes() == 0);
+}
+
+static double volume(const TopoDS_Shape& shape) {
+	GProp_GProps properties;
+	BRepGProp::VolumeProperties(shape, properties);
+	return properties.Mass();
+}
+
+static int count_faces(const TopoDS_Shape& shape) {
+	int n = 0;
+	for (TopExp_Explorer exp(shape, TopAbs_FACE); exp.More(); exp.Next()) ++n;
+	return n;
+}
+
+static void test_prismatic_openings() {
+	IfcGeom::Kernel kernel;
+	// Disabled unless requested by IteratorSettings::PRISMATIC_OPENINGS
+	CHECK(kernel.getValue(IfcGeom::Kernel::GV_PRISMATIC_OPENINGS) < 0.);
+
+	// A wall of 4 x 0.2 x 3 with a window that cuts through it along its
+	// thickness, and a door that touches the bottom edge of the wall
+	const TopoDS_Shape wall = BRepPrimAPI_MakeBox(gp_Pnt(0., 0., 0.), 4., 0.2, 3.).Shape();
+	std::vector<TopoDS_Shape> openings;
+	openings.push_back(BRepPrimAPI_MakeBox(gp_Pnt(1., -0.1, 1.), 1., 0.4, 1.).Shape());
+	openings.push_back(BRepPrimAPI_MakeBox(gp_Pnt(2.5, -0.1, 0.), 1., 0.4, 2.).Shape());
+	std::vector<int> indices;
+	indices.push_back(0);
+	indices.push_back(1);
+
+	TopoDS_Shape prism;
+	CHECK(kernel.subtract_prismatic_openings(wall, openings, indices, prism));
+	if (prism.IsNull()) return;
+
+	// The door is not strictly inside the profile and is left to the
+	// boolean operation
+	CHECK(indices.size() == 1 && indices[0] == 1);
+
+	const TopoDS_Shape cut = BRepAlgoAPI_Cut(wall, openings[0]).Shape();
+	CHECK(std::fabs(volume(prism) - 2.2) < 1.e-6);
+	CHECK(std::fabs(volume(prism) - volume(cut)) < 1.e-6);
+	CHECK(count_faces(prism) == count_faces(cut));
+
+	const TopoDS_Shape with_door = BRepAlgoAPI_Cut(prism, openings[1]).Shape();
+	const TopoDS_Shape both = BRepAlgoAPI_Cut(cut, openings[1]).Shape();
+	CHECK(std::fabs(volume(with_door) - volume(both)) < 1.e-6);
+	CHECK(count_faces(with_door) == count_faces(both));
+}
+
+static void test_sew_polygonal_faces() {
+	IfcParse::IfcFile file;
+	// A unit cube of which the bound of the top face is reversed, so that the
+	// face points inwards, and a face that is not connected to the cube
+	CHECK(load(file,
+		"#1=IFCCARTESIANPOINT((0.,0.,0.));\n"
+		"#2=IFCCARTESIANPOINT((1.,0.,0.));\n"
+		"#3=IFCCARTESIANPOINT((1.,1.,0.));\n"
+		"#4=IFCCARTESIANPOINT((0.,1.,0.));\n"
+		"#5=IFCCARTESIANPOINT((0.,0.,1.));\n"
+		"#6=IFCCARTESIANPOINT((1.,0.,1.));\n"
+		"#7=IFCCARTESIANPOINT((1.,1.,1.));\n"
+		"#8=IFCCARTESIANPOINT((0.,1.,1.));\n"
+		"#11=IFCPOLYLOOP((#1,#4,#3,#2));\n"
+		"#12=IFCPOLYLOOP((#5,#6,#7,#8));\n"
+		"#13=IFCPOLYLOOP((#1,#2,#6,#5));\n"
+		"#14=IFCPOLYLOOP((#4,#8,#7,#3));\n"
+		"#15=IFCPOLYLOOP((#1,#5,#8,#4));\n"
+		"#16=IFCPOLYLOOP((#2,#3,#7,#6));\n"
+		"#21=IFCFACEOUTERBOUND(#11,.T.);\n"
+		"#22=IFCFACEOUTERBOUND(#12,.F.);\n"
+		"#23=IFCFACEOUTERBOUND(#13,.T.);\n"
+		"#24=IFCFACEOUTERBOUND(#14,.T.);\n"
+		"#25=IFCFACEOUTERBOUND(#15,.T.);\n"
+		"#26=IFCFACEOUTERBOUND(#16,.T.);\n"
+		"#31=IFCFACE((#21));\n"
+		"#32=IFCFACE((#22));\n"
+		"#33=IFCFACE((#23));\n"
+		"#34=IFCFACE((#24));\n"
+		"#35=IFCFACE((#25));\n"
+		"#36=IFCFACE((#26));\n"
+		"#40=IFCCLOSEDSHELL((#31,#32,#33,#34,#35,#36));\n"
+		"#41=IFCCARTESIANPOINT((3.,0.,0.));\n"
+		"#42=IFCCARTESIANPOINT((4.,0.,0.));\n"
+		"#43=IFCCARTESIANPOINT((4.,1.,0.));\n"
+		"#44=IFCCARTESIANPOINT((3.,1.,0.));\n"
+		"#45=IFCPOLYLOOP((#41,#42,#43,#44));\n"
+		"#46=IFCFACEOUTERBOUND(#45,.T.);\n"
+		"#47=IFCFACE((#46));\n"
+		"#50=IFCOPENSHELL((#31,#32,#33,#34,#35,#36,#47));\n"));
+
+	IfcGeom::Kernel kernel;
+	// Face sets with at least this number of faces are not sewn by
+	// BRepOffsetAPI_Sewing, but by sew_polygonal_faces()
+	kernel.setValue(IfcGeom::Kernel::GV_MAX_FACES_TO_SEW, 2);
+
+	// The cube is sewn into a single shell, which is promoted to a solid
+	TopoDS_Shape shape;
+	CHECK(kernel.convert((IfcSchema::IfcConnectedFaceSet*) file.entityById(40), shape));
+	CHECK(!shape.IsNull() && shape.ShapeType() == TopAbs_SOLID);
+	CHECK(count_faces(shape) == 6);
+	CHECK(std::fabs(volume(shape) - 1.) < 1.e-6);
+
+	// With the disconnected face a compound of two shells results, in which
+	// the reversed face of the cube is oriented like the first face
+	shape.Nullify();
+	CHECK(kernel.convert((IfcSchema::IfcConnectedFaceSet*) file.entityById(50), shape));
+	CHECK(!shape.IsNull() && shape.ShapeType() == TopAbs_COMPOUND);
+	int num_shells = 0;
+	for (TopExp_Explorer exp(shape, TopAbs_SHELL); exp.More(); exp.Next()) {
+		++ num_shells;
+		if (count_faces(exp.Current()) == 6) {
+			CHECK(std::fabs(volume(exp.Current()) - 1.) < 1.e-6);
+		} else {
+			CHECK(count_faces(exp.Current()) == 1);
+		}
+	}
+	CHECK(num_shells == 2);
+}
+
+int main(int argc, char** argv) {
+	std::stringstream log;
+	Logger::SetOutput(0, &log);
+
+	test_vertex_index_map();
+	test_triangulate_polygon_with_holes();
+	test_triangulation_welding();
+	test_direct_extrusion_triangulation();
+	test_polyloop_brep_triangulation();
+	test_shape_cache_budget();
+	test_prismatic_openings();
+	test_sew_polygonal_faces();
+
+	if (failures) {
+		std::cerr << failures << " check(s) failed" << std::endl;
+		std::cerr << log.str();
+		return 1;
+	}
+	return 0;
+}
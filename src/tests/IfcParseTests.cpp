@@ -0,0 +1,481 @@
+/********************************************************************************
+ *                                                                              *
+ * This file is part of IfcOpenShell.                                           *
+ *                                                                              *
+ * IfcOpenShell is free software: you can redistribute it and/or modify         *
+ * it under the terms of the Lesser GNU General Public License as published by  *
+ * the Free Software Foundation, either version 3.0 of the License, or          *
+ * (at your option) any later version.                                          *
+ *                                                                              *
+ * IfcOpenShell is distributed in the hope that it will be useful,              *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of               *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                 *
+ * Lesser GNU General Public License for more details.                          *
+ *                                                                              *
+ * You should have received a copy of the Lesser GNU General Public License     *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.         *
+ *                                                                              *
+ ********************************************************************************/
+
+/********************************************************************************
+ *                                                                              *
+ * Regression tests for the parser. Every test parses a small file from memory, *
+ * applies an operation and checks the resulting instances and mappings. The    *
+ * process returns non-zero when any of the checks fails.                       *
+ *                                                                              *
+ ********************************************************************************/
+
+#include <vector>
+#include <sstream>
+#include <iostream>
+
+#include <boost/thread/thread.hpp>
+#include <boost/bind.hpp>
+
+#include "../ifcparse/IfcFile.h"
+#include "../ifcparse/IfcCharacterDecoder.h"
+
+using namespace IfcSchema;
+
+static int failures = 0;
+
+#define CHECK(expr) \
+	if (!(expr)) { \
+		std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #expr << std::endl; \
+		++ failures; \
+	}
+
+static const char* header =
+	"ISO-10303-21;\n"
+	"HEADER;\n"
+	"FILE_DESCRIPTION(('ViewDefinition [CoordinationView]'),'2;1');\n"
+	"FILE_NAME('test.ifc','2014-01-01T00:00:00',(''),(''),'','','');\n"
+	"FILE_SCHEMA(('IFC2X3'));\n"
+	"ENDSEC;\n"
+	"DATA;\n";
+
+static const char* footer =
+	"ENDSEC;\n"
+	"END-ISO-10303-21;\n";
+
+static bool load(IfcParse::IfcFile& file, const std::string& data) {
+	std::stringstream ss;
+	ss << header << data << footer;
+	const std::string s = ss.str();
+	std::istringstream is(s);
+	return file.Init(is, (int) s.size());
+}
+
+static unsigned count(IfcParse::IfcFile& file, IfcSchema::Type::Enum type) {
+	IfcEntityList::ptr instances = file.entitiesByType(type);
+	return instances ? instances->size() : 0;
+}
+
+static bool exists(IfcParse::IfcFile& file, int id) {
+	try {
+		file.entityById(id);
+		return true;
+	} catch (const IfcParse::IfcException&) {
+		return false;
+	}
+}
+
+struct is_direction {
+	bool operator()(IfcUtil::IfcBaseClass* instance) const {
+		return instance->is(IfcSchema::Type::IfcDirection);
+	}
+};
+
+static void test_remove_if() {
+	IfcParse::IfcFile file;
+	CHECK(load(file,
+		"#1=IFCCARTESIANPOINT((0.,0.,0.));\n"
+		"#2=IFCDIRECTION((0.,0.,1.));\n"
+		"#3=IFCCARTESIANPOINT((1.,0.,0.));\n"
+		"#4=IFCDIRECTION((1.,0.,0.));\n"));
+
+	IfcEntityList::ptr instances(new IfcEntityList);
+	for (int i = 1; i <= 4; ++i) {
+		instances->push(file.entityById(i));
+	}
+	instances->remove_if(is_direction());
+	CHECK(instances->size() == 2);
+	CHECK(instances->contains(file.entityById(1)));
+	CHECK(instances->contains(file.entityById(3)));
+	CHECK(!instances->contains(file.entityById(2)));
+
+	// The relative order of the retained instances is preserved
+	CHECK((*instances)[0] == file.entityById(1));
+	CHECK((*instances)[1] == file.entityById(3));
+}
+
+static void test_remove_entities() {
+	IfcParse::IfcFile file;
+	CHECK(load(file,
+		"#1=IFCCARTESIANPOINT((0.,0.,0.));\n"
+		"#2=IFCDIRECTION((0.,0.,1.));\n"
+		"#3=IFCDIRECTION((1.,0.,0.));\n"
+		"#4=IFCAXIS2PLACEMENT3D(#1,#2,#3);\n"
+		"#5=IFCLOCALPLACEMENT($,#4);\n"
+		"#6=IFCAXIS2PLACEMENT3D(#1,$,$);\n"
+		"#7=IFCLOCALPLACEMENT($,#6);\n"
+		"#8=IFCCARTESIANPOINT((1.,0.,0.));\n"));
+
+	IfcEntityList::ptr victims(new IfcEntityList);
+	victims->push(file.entityById(5));
+	victims->push(file.entityById(8));
+	// Duplicate entries are ignored
+	victims->push(file.entityById(8));
+	file.removeEntities(victims);
+
+	// The placement that is no longer referenced is removed along with its
+	// attributes, but the point that is still used by #6 is retained.
+	CHECK(!exists(file, 5));
+	CHECK(!exists(file, 8));
+	CHECK(!exists(file, 4));
+	CHECK(!exists(file, 2));
+	CHECK(!exists(file, 3));
+	CHECK(exists(file, 1));
+	CHECK(exists(file, 6));
+	CHECK(exists(file, 7));
+
+	CHECK(count(file, IfcSchema::Type::IfcLocalPlacement) == 1);
+	CHECK(count(file, IfcSchema::Type::IfcAxis2Placement3D) == 1);
+	CHECK(count(file, IfcSchema::Type::IfcDirection) == 0);
+	CHECK(count(file, IfcSchema::Type::IfcCartesianPoint) == 1);
+
+	IfcEntityList::ptr refs = file.entitiesByReference(1);
+	CHECK(refs && refs->size() == 1 && refs->contains(file.entityById(6)));
+}
+
+static void test_remove_entities_referrers() {
+	IfcParse::IfcFile file;
+	CHECK(load(file,
+		"#1=IFCCARTESIANPOINT((0.,0.,0.));\n"
+		"#2=IFCDIRECTION((0.,0.,1.));\n"
+		"#3=IFCDIRECTION((1.,0.,0.));\n"
+		"#4=IFCAXIS2PLACEMENT3D(#1,#2,#3);\n"
+		"#5=IFCPOLYLINE((#1,#6,#7));\n"
+		"#6=IFCCARTESIANPOINT((1.,0.,0.));\n"
+		"#7=IFCCARTESIANPOINT((1.,1.,0.));\n"));
+
+	IfcEntityList::ptr victims(new IfcEntityList);
+	victims->push(file.entityById(3));
+	victims->push(file.entityById(6));
+	file.removeEntities(victims);
+
+	// Referring instances are retained, with the references to the removed
+	// instances unset or removed from their aggregates.
+	IfcAxis2Placement3D* placement = (IfcAxis2Placement3D*) file.entityById(4);
+	CHECK(placement != 0);
+	CHECK(placement && !placement->hasRefDirection());
+	CHECK(placement && placement->hasAxis());
+
+	IfcPolyline* polyline = (IfcPolyline*) file.entityById(5);
+	CHECK(polyline != 0);
+	if (polyline) {
+		IfcCartesianPoint::list::ptr points = polyline->Points();
+		CHECK(points->size() == 2);
+		CHECK(points->contains((IfcCartesianPoint*) file.entityById(1)));
+		CHECK(points->contains((IfcCartesianPoint*) file.entityById(7)));
+	}
+
+	CHECK(count(file, IfcSchema::Type::IfcCartesianPoint) == 2);
+	CHECK(count(file, IfcSchema::Type::IfcDirection) == 1);
+}
+
+static void test_remove_duplicate_entities() {
+	IfcParse::IfcFile file;
+	CHECK(load(file,
+		"#1=IFCCARTESIANPOINT((0.,0.,0.));\n"
+		"#2=IFCDIRECTION((0.,0.,1.));\n"
+		"#3=IFCDIRECTION((1.,0.,0.));\n"
+		"#4=IFCAXIS2PLACEMENT3D(#1,#2,#3);\n"
+		"#5=IFCLOCALPLACEMENT($,#4);\n"
+		"#6=IFCCARTESIANPOINT((0.,0.,0.));\n"
+		"#7=IFCDIRECTION((0.,0.,1.));\n"
+		"#8=IFCAXIS2PLACEMENT3D(#6,#7,#3);\n"
+		"#9=IFCLOCALPLACEMENT($,#8);\n"
+		"#10=IFCAXIS2PLACEMENT3D(#6,#7,$);\n"
+		"#11=IFCLOCALPLACEMENT($,#10);\n"
+		"#12=IFCPOLYLINE((#1,#6,#13));\n"
+		"#13=IFCCARTESIANPOINT((1.,0.,0.));\n"));
+
+	// #6 and #7 are duplicates of #1 and #2, which makes #8 a duplicate of
+	// #4 once its attributes have been mapped. #10 differs by RefDirection.
+	CHECK(file.removeDuplicateEntities() == 3);
+
+	CHECK(!exists(file, 6));
+	CHECK(!exists(file, 7));
+	CHECK(!exists(file, 8));
+	CHECK(exists(file, 10));
+
+	CHECK(count(file, IfcSchema::Type::IfcCartesianPoint) == 2);
+	CHECK(count(file, IfcSchema::Type::IfcDirection) == 2);
+	CHECK(count(file, IfcSchema::Type::IfcAxis2Placement3D) == 2);
+	// Types that are not part of the set are never merged
+	CHECK(count(file, IfcSchema::Type::IfcLocalPlacement) == 3);
+
+	IfcLocalPlacement* placement = (IfcLocalPlacement*) file.entityById(9);
+	CHECK(placement->RelativePlacement() == file.entityById(4));
+
+	IfcAxis2Placement3D* placement_without_ref = (IfcAxis2Placement3D*) file.entityById(10);
+	CHECK(placement_without_ref->Location() == file.entityById(1));
+	CHECK(placement_without_ref->Axis() == file.entityById(2));
+
+	// References in aggregates are redirected as well, which may yield
+	// repeated entries
+	IfcCartesianPoint::list::ptr points = ((IfcPolyline*) file.entityById(12))->Points();
+	CHECK(points->size() == 3);
+	CHECK(*points->begin() == file.entityById(1));
+	CHECK(*(points->begin() + 1) == file.entityById(1));
+
+	IfcEntityList::ptr refs = file.entitiesByReference(1);
+	CHECK(refs && refs->contains(file.entityById(4)));
+	CHECK(refs && refs->contains(file.entityById(10)));
+	CHECK(refs && refs->contains(file.entityById(12)));
+	refs = file.entitiesByReference(4);
+	CHECK(refs && refs->size() == 2);
+
+	// A second pass finds nothing to merge
+	CHECK(file.removeDuplicateEntities() == 0);
+}
+
+static void test_remove_duplicate_entities_by_type() {
+	IfcParse::IfcFile file;
+	CHECK(load(file,
+		"#1=IFCCARTESIANPOINT((0.,0.,0.));\n"
+		"#2=IFCDIRECTION((0.,0.,1.));\n"
+		"#3=IFCCARTESIANPOINT((0.,0.,0.));\n"
+		"#4=IFCDIRECTION((0.,0.,1.));\n"
+		"#5=IFCAXIS2PLACEMENT3D(#1,#2,$);\n"
+		"#6=IFCAXIS2PLACEMENT3D(#3,#4,$);\n"));
+
+	std::set<IfcSchema::Type::Enum> types;
+	types.insert(IfcSchema::Type::IfcDirection);
+	CHECK(file.removeDuplicateEntities(types) == 1);
+	CHECK(count(file, IfcSchema::Type::IfcCartesianPoint) == 2);
+	CHECK(count(file, IfcSchema::Type::IfcDirection) == 1);
+	// The placements refer to distinct points and are not considered
+	CHECK(count(file, IfcSchema::Type::IfcAxis2Placement3D) == 2);
+	CHECK(((IfcAxis2Placement3D*) file.entityById(6))->Axis() == file.entityById(2));
+}
+
+static void test_string_pool() {
+	IfcParse::IfcFile file;
+	file.intern_strings(true);
+	CHECK(load(file,
+		"#1=IFCORGANIZATION($,'Acme',$,$,$);\n"
+		"#2=IFCORGANIZATION($,'Acme',$,$,$);\n"
+		"#3=IFCORGANIZATION($,'Other',$,$,$);\n"));
+
+	const IfcParse::TokenArgument* a = dynamic_cast<const IfcParse::TokenArgument*>(file.entityById(1)->entity->getArgument(1));
+	const IfcParse::TokenArgument* b = dynamic_cast<const IfcParse::TokenArgument*>(file.entityById(2)->entity->getArgument(1));
+	const IfcParse::TokenArgument* c = dynamic_cast<const IfcParse::TokenArgument*>(file.entityById(3)->entity->getArgument(1));
+	CHECK(a && b && c);
+	if (!(a && b && c)) return;
+
+	const IfcParse::IfcStringRef ref_a = a->asStringRef();
+	const IfcParse::IfcStringRef ref_b = b->asStringRef();
+	const IfcParse::IfcStringRef ref_c = c->asStringRef();
+	CHECK(ref_a == std::string("Acme"));
+	CHECK(ref_a == ref_b);
+	CHECK(ref_a != ref_c);
+	// Equal values share their storage
+	CHECK(ref_a.data() == ref_b.data());
+	// The pooled value is referred to without a copy
+	std::string copy;
+	CHECK(&IfcParse::stringValue(a, copy) == &ref_a.str());
+	CHECK(copy.empty());
+	// Repeated reads do not add values to the pool
+	const unsigned pool_size = file.string_pool()->size();
+	CHECK(((IfcOrganization*) file.entityById(3))->Name() == "Other");
+	CHECK(((IfcOrganization*) file.entityById(2))->Name() == "Acme");
+	CHECK(file.string_pool()->size() == pool_size);
+
+	// Handles remain valid after interning has been disabled
+	file.intern_strings(false);
+	CHECK(!file.intern_strings());
+	CHECK(file.string_pool() == 0);
+	CHECK(ref_a.str() == "Acme");
+	CHECK(ref_c.str() == "Other");
+	CHECK(((IfcOrganization*) file.entityById(1))->Name() == "Acme");
+
+	// Enabling interning again reuses the existing pool
+	file.intern_strings(true);
+	CHECK(a->asStringRef().data() == ref_a.data());
+}
+
+// Decodes a string from memory in the way the lexer does, once it has read the
+// opening apostrophe, and returns the position of the stream afterwards
+static std::string decode(const std::string& data, unsigned int& position, bool dry_run = false) {
+	// The decoder reads up to a null character at the end of the buffer
+	std::vector<char> buffer(data.begin(), data.end());
+	buffer.push_back(0);
+	IfcParse::IfcSpfStream stream(&buffer[0], (int) data.size());
+	IfcParse::IfcCharacterDecoder decoder(&stream);
+	std::string value;
+	if (dry_run) {
+		decoder.dryRun();
+	} else {
+		value = decoder;
+	}
+	position = stream.Tell();
+	return value;
+}
+
+// Whether a string is decoded to the same value and up to the same position as
+// when the decoder is forced to process it character by character, which it
+// is when the string starts with the ignored directive \N\ that is prepended
+static bool matches_slow_path(const std::string& data) {
+	unsigned int position, slow_position, dry_position;
+	const std::string value = decode(data, position);
+	const std::string slow_value = decode("\\N\\" + data, slow_position);
+	decode(data, dry_position, true);
+	return value == slow_value && position + 3 == slow_position && dry_position == position;
+}
+
+static void test_plain_strings() {
+	unsigned int position;
+	CHECK(decode("abc',#2", position) == "'abc'");
+	CHECK(position == 4);
+	CHECK(matches_slow_path("abc',#2"));
+
+	CHECK(decode("',#2", position) == "''");
+	CHECK(position == 1);
+	CHECK(matches_slow_path("',#2"));
+
+	// Strings with escape sequences, escaped apostrophes or line breaks are not plain
+	CHECK(matches_slow_path("\\X\\E9t\\S\\)',#2"));
+	CHECK(matches_slow_path("it''s',#2"));
+	CHECK(decode("a\r\nb',#2", position) == "'ab'");
+	CHECK(position == 5);
+	CHECK(matches_slow_path("a\r\nb',#2"));
+
+	// Strings that end at the end of the buffer, with or without their closing apostrophe
+	CHECK(decode("abc'", position) == "'abc'");
+	CHECK(position == 4);
+	CHECK(matches_slow_path("abc'"));
+	CHECK(matches_slow_path("abc"));
+}
+
+static void test_decoder_state() {
+	// Two strings in a single stream, the first of which switches to ISO 8859-2.
+	// The character \S\# is 0xA3, which is U+0141 in ISO 8859-2 and U+00A3 in
+	// the default ISO 8859-1.
+	const std::string data = "\\PB\\\\S\\#','\\S\\#',";
+	std::vector<char> buffer(data.begin(), data.end());
+	buffer.push_back(0);
+	IfcParse::IfcSpfStream stream(&buffer[0], (int) data.size());
+	IfcParse::IfcCharacterDecoder decoder(&stream);
+
+	const std::string other_data = "\\S\\#',";
+	std::vector<char> other_buffer(other_data.begin(), other_data.end());
+	other_buffer.push_back(0);
+	IfcParse::IfcSpfStream other_stream(&other_buffer[0], (int) other_data.size());
+	IfcParse::IfcCharacterDecoder other_decoder(&other_stream);
+
+#ifdef HAVE_ICU
+	const std::string first = decoder;
+	CHECK(first == "'\\u0141'");
+	// The code page of one decoder does not affect another decoder
+	const std::string other = other_decoder;
+	CHECK(other == "'\\u00a3'");
+	// Nor does it carry over to the next string of the same decoder, of
+	// which the converter is reopened for the default code page
+	stream.Inc();
+	stream.Inc();
+	const std::string second = decoder;
+	CHECK(second == "'\\u00a3'");
+#else
+	// The substitution character is read when a decoder is constructed
+	const char substitution_character = IfcParse::IfcCharacterDecoder::substitution_character;
+	IfcParse::IfcCharacterDecoder::substitution_character = '?';
+	IfcParse::IfcSpfStream third_stream(&other_buffer[0], (int) other_data.size());
+	IfcParse::IfcCharacterDecoder third_decoder(&third_stream);
+	IfcParse::IfcCharacterDecoder::substitution_character = substitution_character;
+	const std::string first = decoder;
+	CHECK(first == "'_'");
+	const std::string third = third_decoder;
+	CHECK(third == "'?'");
+	const std::string other = other_decoder;
+	CHECK(other == "'_'");
+#endif
+}
+
+static void read_instances(IfcParse::IfcFile* file, std::vector<std::string>* strings) {
+	for (IfcParse::IfcFile::const_iterator it = file->begin(); it != file->end(); ++it) {
+		strings->push_back(it->second->entity->toString());
+		const unsigned int n = it->second->entity->getArgumentCount();
+		for (unsigned int i = 0; i < n; ++i) {
+			strings->push_back(it->second->entity->getArgument(i)->toString());
+		}
+	}
+}
+
+static bool read_concurrently(IfcParse::IfcFile& file) {
+	std::vector<std::string> results[4];
+	boost::thread_group threads;
+	for (int i = 0; i < 4; ++i) {
+		threads.create_thread(boost::bind(&read_instances, &file, &results[i]));
+	}
+	threads.join_all();
+
+	std::vector<std::string> expected;
+	read_instances(&file, &expected);
+	for (int i = 0; i < 4; ++i) {
+		if (results[i] != expected) return false;
+	}
+	return true;
+}
+
+static void test_concurrent_reads() {
+	std::stringstream ss;
+	for (int i = 1; i <= 200; ++i) {
+		ss << "#" << i << "=IFCCARTESIANPOINT((" << i << ".,0.,0.));\n";
+	}
+	ss << "#201=IFCPOLYLINE((";
+	for (int i = 1; i <= 200; ++i) {
+		ss << (i > 1 ? "," : "") << "#" << i;
+	}
+	ss << "));\n";
+	for (int i = 202; i <= 300; ++i) {
+		ss << "#" << i << "=IFCORGANIZATION($,'Name " << (i % 7) << "',$,$,$);\n";
+	}
+
+	// Arguments read lazily by the threads
+	IfcParse::IfcFile file;
+	file.intern_strings(true);
+	CHECK(load(file, ss.str()));
+	CHECK(read_concurrently(file));
+
+	// Arguments read up front, after which they are accessed without locking
+	IfcParse::IfcFile loaded_file;
+	loaded_file.intern_strings(true);
+	CHECK(load(loaded_file, ss.str()));
+	loaded_file.load_arguments();
+	CHECK(loaded_file.arguments_loaded());
+	CHECK(read_concurrently(loaded_file));
+}
+
+int main(int argc, char** argv) {
+	std::stringstream log;
+	Logger::SetOutput(0, &log);
+
+	test_remove_if();
+	test_remove_entities();
+	test_remove_entities_referrers();
+	test_remove_duplicate_entities();
+	test_remove_duplicate_entities_by_type();
+	test_string_pool();
+	test_plain_strings();
+	test_decoder_state();
+	test_concurrent_reads();
+
+	if (failures) {
+		std::cerr << failures << " check(s) failed" << std::endl;
+		std::cerr << log.str();
+		return 1;
+	}
+	return 0;
+}